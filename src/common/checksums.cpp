@@ -18,9 +18,15 @@
 #include "config.h"
 #include "filesystembase.h"
 #include "common/checksums.h"
+#include "common/syncjournaldb.h"
 #include "asserts.h"
 
+#include <QDateTime>
+#include <QFile>
 #include <QLoggingCategory>
+#include <QScopeGuard>
+#include <QThreadPool>
+#include <QTimer>
 #include <qtconcurrentrun.h>
 #include <QCryptographicHash>
 
@@ -88,6 +94,20 @@ Q_LOGGING_CATEGORY(lcChecksums, "sync.checksums", QtInfoMsg)
 
 #define BUFSIZE qint64(500 * 1024) // 500 KiB
 
+// Files whose times are this recent are not cached, the filesystem might not
+// record a second modification within its timestamp granularity
+static const qint64 RacyTimestampWindowMs = 2000;
+
+static ChecksumCacheKey checksumCacheKey(const FileSystem::FileStamp &stamp)
+{
+    ChecksumCacheKey key;
+    key.inode = stamp.inode;
+    key.size = stamp.size;
+    key.modtime = stamp.modtime;
+    key.ctime = stamp.ctime;
+    return key;
+}
+
 static QByteArray calcCryptoHash(QIODevice *device, QCryptographicHash::Algorithm algo)
 {
      QByteArray arr;
@@ -128,6 +148,30 @@ QByteArray calcAdler32(QIODevice *device)
     return QByteArray::number(adler, 16);
 }
 
+namespace {
+// Like ComputeChecksum::computeNow(), but drops what was read from the page cache
+QByteArray computeReleasingPageCache(QFile *file, const QByteArray &checksumType)
+{
+    StreamingChecksum checksum(checksumType);
+    if (!checksum.isValid()) {
+        // disabled or unknown, computeNow() reports it
+        return ComputeChecksum::computeNow(file, checksumType);
+    }
+    FileSystem::PageCacheReleaser releaser(file, FileSystem::PageCacheReleaser::Mode::Read, file->pos());
+    QByteArray buf(BUFSIZE, Qt::Uninitialized);
+    while (!file->atEnd()) {
+        const qint64 size = file->read(buf.data(), BUFSIZE);
+        if (size < 0) {
+            return QByteArray();
+        }
+        checksum.addData(buf.constData(), size);
+        releaser.advance(file->pos());
+    }
+    releaser.finish();
+    return checksum.result();
+}
+}
+
 QByteArray makeChecksumHeader(const QByteArray &checksumType, const QByteArray &checksum)
 {
     if (checksumType.isEmpty() || checksum.isEmpty())
@@ -223,8 +267,45 @@ QByteArray ComputeChecksum::checksumType() const
     return _checksumType;
 }
 
+void ComputeChecksum::setChecksumCache(SyncJournalDb *journal)
+{
+    _checksumCache = journal;
+}
+
+void ComputeChecksum::setBackgroundPriority(bool background)
+{
+    _backgroundPriority = background;
+}
+
+void ComputeChecksum::setReleasePageCache(bool release)
+{
+    _releasePageCache = release;
+}
+
+void ComputeChecksum::setWorkerObserver(const std::function<void(bool finished)> &observer)
+{
+    _workerObserver = observer;
+}
+
 void ComputeChecksum::start(const QString &filePath)
 {
+    if (_checksumCache && !checksumType().isEmpty() && checksumComputationEnabled()) {
+        if (!FileSystem::getFileStamp(filePath, &_cacheStamp)) {
+            _cacheStamp = {};
+        }
+        const auto checksum = _checksumCache->getCachedChecksum(checksumCacheKey(_cacheStamp), checksumType());
+        if (!checksum.isEmpty()) {
+            qCInfo(lcChecksums) << "Using cached" << checksumType() << "checksum of" << filePath;
+            // keep done() asynchronous like a computation
+            QTimer::singleShot(0, this, [this, checksum] { emit done(_checksumType, checksum); });
+            return;
+        }
+        // a file that was just written might change again without a visible change of its times
+        const auto racyLimit = QDateTime::currentMSecsSinceEpoch() - RacyTimestampWindowMs;
+        if (checksumCacheKey(_cacheStamp).isValid() && _cacheStamp.modtime < racyLimit && _cacheStamp.ctime < racyLimit) {
+            _cacheFilePath = filePath;
+        }
+    }
     qCInfo(lcChecksums) << "Computing" << checksumType() << "checksum of" << filePath << "in a thread";
     startImpl(std::make_unique<QFile>(filePath));
 }
@@ -250,7 +331,22 @@ void ComputeChecksum::startImpl(std::unique_ptr<QIODevice> device)
 
     // Bug: The thread will keep running even if ComputeChecksum is deleted.
     auto type = checksumType();
-    _watcher.setFuture(QtConcurrent::run([sharedDevice, type]() {
+    const bool background = _backgroundPriority;
+    const bool releasePageCache = _releasePageCache;
+    auto pool = background ? Utility::backgroundThreadPool() : QThreadPool::globalInstance();
+    const auto observer = _workerObserver;
+    _watcher.setFuture(QtConcurrent::run(pool, [sharedDevice, type, background, releasePageCache, observer]() {
+        if (background) {
+            Utility::lowerCurrentThreadPriority();
+        }
+        if (observer) {
+            observer(false);
+        }
+        const auto notifyFinished = qScopeGuard([&observer] {
+            if (observer) {
+                observer(true);
+            }
+        });
         if (!sharedDevice->open(QIODevice::ReadOnly)) {
             if (auto file = qobject_cast<QFile *>(sharedDevice.data())) {
                 qCWarning(lcChecksums) << "Could not open file" << file->fileName()
@@ -261,7 +357,8 @@ void ComputeChecksum::startImpl(std::unique_ptr<QIODevice> device)
             }
             return QByteArray();
         }
-        auto result = ComputeChecksum::computeNow(sharedDevice.data(), type);
+        auto file = qobject_cast<QFile *>(sharedDevice.data());
+        auto result = releasePageCache && file ? computeReleasingPageCache(file, type) : ComputeChecksum::computeNow(sharedDevice.data(), type);
         sharedDevice->close();
         return result;
     }));
@@ -307,6 +404,14 @@ QByteArray ComputeChecksum::computeNow(QIODevice *device, const QByteArray &chec
 void ComputeChecksum::slotCalculationDone()
 {
     QByteArray checksum = _watcher.future().result();
+    // only cache the result if the file did not change while it was read
+    if (!checksum.isEmpty() && !_cacheFilePath.isEmpty()) {
+        FileSystem::FileStamp current;
+        if (FileSystem::getFileStamp(_cacheFilePath, &current) && current.inode == _cacheStamp.inode && current.size == _cacheStamp.size
+            && current.modtime == _cacheStamp.modtime && current.ctime == _cacheStamp.ctime) {
+            _checksumCache->setCachedChecksum(checksumCacheKey(_cacheStamp), _checksumType, checksum);
+        }
+    }
     if (!checksum.isNull()) {
         emit done(_checksumType, checksum);
     } else {
@@ -315,30 +420,94 @@ void ComputeChecksum::slotCalculationDone()
 }
 
 
+StreamingChecksum::StreamingChecksum(const QByteArray &checksumType)
+    : _checksumType(checksumType)
+{
+    if (!checksumComputationEnabled()) {
+        return;
+    }
+    if (checksumType == checkSumMD5C) {
+        _hash = std::make_unique<QCryptographicHash>(QCryptographicHash::Md5);
+    } else if (checksumType == checkSumSHA1C) {
+        _hash = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha1);
+    } else if (checksumType == checkSumSHA2C) {
+        _hash = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha256);
+    } else if (checksumType == checkSumSHA3C) {
+        _hash = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha3_256);
+    } else if (checksumType == checkSumAdlerC) {
+        _isAdler32 = true;
+        _adler32 = adler32(0L, Z_NULL, 0);
+    }
+}
+
+StreamingChecksum::~StreamingChecksum()
+{
+}
+
+bool StreamingChecksum::isValid() const
+{
+    return _hash || _isAdler32;
+}
+
+QByteArray StreamingChecksum::checksumType() const
+{
+    return _checksumType;
+}
+
+void StreamingChecksum::addData(const char *data, qint64 length)
+{
+    if (_hash) {
+        _hash->addData(data, static_cast<int>(length));
+    } else if (_isAdler32) {
+        _adler32 = adler32(_adler32, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(length));
+    }
+    _size += length;
+}
+
+QByteArray StreamingChecksum::result() const
+{
+    if (_hash) {
+        return _hash->result().toHex();
+    } else if (_isAdler32 && _size > 0) {
+        // like calcAdler32(), which has no checksum for empty files
+        return QByteArray::number(static_cast<uint>(_adler32), 16);
+    }
+    return QByteArray();
+}
+
+
 ValidateChecksumHeader::ValidateChecksumHeader(QObject *parent)
     : QObject(parent)
 {
 }
 
 ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+{
+    if (!parseExpectedChecksum(checksumHeader)) {
+        return nullptr;
+    }
+
+    auto calculator = new ComputeChecksum(this);
+    calculator->setChecksumType(_expectedChecksumType);
+    connect(calculator, &ComputeChecksum::done,
+        this, &ValidateChecksumHeader::slotChecksumCalculated);
+    return calculator;
+}
+
+bool ValidateChecksumHeader::parseExpectedChecksum(const QByteArray &checksumHeader)
 {
     // If the incoming header is empty no validation can happen. Just continue.
     if (checksumHeader.isEmpty()) {
         emit validated(QByteArray(), QByteArray());
-        return nullptr;
+        return false;
     }
 
     if (!parseChecksumHeader(checksumHeader, &_expectedChecksumType, &_expectedChecksum)) {
         qCWarning(lcChecksums) << "Checksum header malformed:" << checksumHeader;
         emit validationFailed(tr("The checksum header is malformed."));
-        return nullptr;
+        return false;
     }
-
-    auto calculator = new ComputeChecksum(this);
-    calculator->setChecksumType(_expectedChecksumType);
-    connect(calculator, &ComputeChecksum::done,
-        this, &ValidateChecksumHeader::slotChecksumCalculated);
-    return calculator;
+    return true;
 }
 
 void ValidateChecksumHeader::start(const QString &filePath, const QByteArray &checksumHeader)
@@ -353,6 +522,13 @@ void ValidateChecksumHeader::start(std::unique_ptr<QIODevice> device, const QByt
         calculator->start(std::move(device));
 }
 
+void ValidateChecksumHeader::validate(const QByteArray &checksumHeader, const QByteArray &checksumType, const QByteArray &checksum)
+{
+    if (parseExpectedChecksum(checksumHeader)) {
+        slotChecksumCalculated(checksumType, checksum);
+    }
+}
+
 void ValidateChecksumHeader::slotChecksumCalculated(const QByteArray &checksumType,
     const QByteArray &checksum)
 {
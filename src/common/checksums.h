@@ -20,13 +20,16 @@
 
 #include "ocsynclib.h"
 #include "config.h"
+#include "filesystembase.h"
 
 #include <QObject>
 #include <QByteArray>
 #include <QFutureWatcher>
 
+#include <functional>
 #include <memory>
 
+class QCryptographicHash;
 class QFile;
 
 namespace OCC {
@@ -88,10 +91,38 @@ public:
 
     QByteArray checksumType() const;
 
+    /**
+     * Look up and store the checksums of files passed to start(const QString &) in @a journal.
+     *
+     * The entries are keyed by inode, size, modification and status change time, so
+     * unchanged files are not read again when an upload is retried.
+     */
+    void setChecksumCache(SyncJournalDb *journal);
+
+    /**
+     * Compute the checksum on Utility::backgroundThreadPool() with low I/O and CPU priority.
+     */
+    void setBackgroundPriority(bool background);
+
+    /**
+     * Read the files passed to start(const QString &) without keeping them in the page cache.
+     *
+     * For files that are not read again soon, see FileSystem::PageCacheReleaser.
+     */
+    void setReleasePageCache(bool release);
+
+    /**
+     * Called in the worker thread with false before and with true after the checksum is computed.
+     *
+     * Used to trace the computation on the thread that does it.
+     */
+    void setWorkerObserver(const std::function<void(bool finished)> &observer);
+
     /**
      * Computes the checksum for the given file path.
      *
-     * done() is emitted when the calculation finishes.
+     * done() is emitted when the calculation finishes, also if the checksum came
+     * from the cache.
      */
     void start(const QString &filePath);
 
@@ -126,10 +157,48 @@ private:
 
     QByteArray _checksumType;
 
+    bool _backgroundPriority = false;
+    bool _releasePageCache = false;
+    std::function<void(bool finished)> _workerObserver;
+
+    SyncJournalDb *_checksumCache = nullptr;
+    // the file the checksum is computed for, if it may be stored in the cache
+    QString _cacheFilePath;
+    // the file when the computation started, the checksum is only cached if it did not change
+    FileSystem::FileStamp _cacheStamp;
+
     // watcher for the checksum calculation thread
     QFutureWatcher<QByteArray> _watcher;
 };
 
+/**
+ * Computes a checksum from data that arrives in parts, like the body of a download.
+ * \ingroup libsync
+ */
+class OCSYNC_EXPORT StreamingChecksum
+{
+public:
+    explicit StreamingChecksum(const QByteArray &checksumType);
+    ~StreamingChecksum();
+
+    /// False if the type is unknown or checksum computations are disabled, addData() does nothing then
+    bool isValid() const;
+
+    QByteArray checksumType() const;
+
+    void addData(const char *data, qint64 length);
+
+    /// The checksum of all data added so far, like ComputeChecksum::computeNow() would compute it
+    QByteArray result() const;
+
+private:
+    QByteArray _checksumType;
+    std::unique_ptr<QCryptographicHash> _hash;
+    bool _isAdler32 = false;
+    unsigned long _adler32 = 0;
+    qint64 _size = 0;
+};
+
 /**
  * Checks whether a file's checksum matches the expected value.
  * @ingroup libsync
@@ -159,6 +228,14 @@ public:
      */
     void start(std::unique_ptr<QIODevice> device, const QByteArray &checksumHeader);
 
+    /**
+     * Check a checksum that was already computed, e.g. with a StreamingChecksum,
+     * against the provided checksumHeader
+     *
+     * The signals are emitted before this returns.
+     */
+    void validate(const QByteArray &checksumHeader, const QByteArray &checksumType, const QByteArray &checksum);
+
 signals:
     void validated(const QByteArray &checksumType, const QByteArray &checksum);
     void validationFailed(const QString &errMsg);
@@ -168,6 +245,7 @@ private slots:
 
 private:
     ComputeChecksum *prepareStart(const QByteArray &checksumHeader);
+    bool parseExpectedChecksum(const QByteArray &checksumHeader);
 
     QByteArray _expectedChecksumType;
     QByteArray _expectedChecksum;
@@ -29,6 +29,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
 #ifdef Q_OS_WIN
 #include <windows.h>
 #include <windef.h>
@@ -550,6 +554,109 @@ bool FileSystem::isChildPathOf(const QString &child, const QString &parent)
         // clear trailing slashes etc
         || QString::compare(QDir::cleanPath(parent), QDir::cleanPath(child), sensitivity) == 0);
 }
+
+bool FileSystem::getFileStamp(const QString &filename, FileStamp *stamp)
+{
+#ifdef Q_OS_WIN
+    // the file index needs its own handle
+    const HANDLE h = CreateFileW(reinterpret_cast<const wchar_t *>(longWinPath(filename).utf16()), 0, FILE_SHARE_WRITE | FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    const bool ok = GetFileInformationByHandle(h, &fileInfo);
+    CloseHandle(h);
+    if (!ok) {
+        return false;
+    }
+    // the same file id csync uses as inode
+    ULARGE_INTEGER fileIndex;
+    fileIndex.HighPart = fileInfo.nFileIndexHigh;
+    fileIndex.LowPart = fileInfo.nFileIndexLow;
+    stamp->inode = fileIndex.QuadPart & 0x0000FFFFFFFFFFFF;
+    stamp->size = ULARGE_INTEGER { { fileInfo.nFileSizeLow, fileInfo.nFileSizeHigh } }.QuadPart;
+    const QFileInfo info(filename);
+    stamp->modtime = info.lastModified().toMSecsSinceEpoch();
+    stamp->ctime = info.metadataChangeTime().toMSecsSinceEpoch();
+#else
+    struct stat sb;
+    if (stat(QFile::encodeName(filename).constData(), &sb) != 0) {
+        return false;
+    }
+#ifdef Q_OS_MACOS
+    const auto &mtime = sb.st_mtimespec;
+    const auto &ctime = sb.st_ctimespec;
+#else
+    const auto &mtime = sb.st_mtim;
+    const auto &ctime = sb.st_ctim;
+#endif
+    stamp->inode = sb.st_ino;
+    stamp->size = sb.st_size;
+    stamp->modtime = qint64(mtime.tv_sec) * 1000 + mtime.tv_nsec / 1000000;
+    stamp->ctime = qint64(ctime.tv_sec) * 1000 + ctime.tv_nsec / 1000000;
+#endif
+    return true;
+}
+
+namespace {
+// Large enough to keep the number of system calls low, small enough to not matter for the cache
+constexpr qint64 pageCacheWindow = 8 * 1024 * 1024;
+}
+
+FileSystem::PageCacheReleaser::PageCacheReleaser(QFile *file, Mode mode, qint64 start)
+    : _file(file)
+    , _mode(mode)
+    , _released(start)
+    , _writtenBack(start)
+{
+#if defined Q_OS_UNIX && !defined Q_OS_MAC
+    if (_mode == Mode::Read) {
+        // doubles the readahead on Linux
+        posix_fadvise(_file->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+}
+
+void FileSystem::PageCacheReleaser::advance(qint64 position)
+{
+    if (_mode == Mode::Read) {
+        if (position - _released >= pageCacheWindow) {
+            drop(_released, position);
+        }
+        return;
+    }
+    if (position - _writtenBack < pageCacheWindow) {
+        return;
+    }
+    // the previous window had a window's time to be written back
+    drop(_released, _writtenBack);
+#ifdef Q_OS_LINUX
+    _file->flush();
+    sync_file_range(_file->handle(), _writtenBack, position - _writtenBack, SYNC_FILE_RANGE_WRITE);
+#endif
+    _writtenBack = position;
+}
+
+void FileSystem::PageCacheReleaser::finish()
+{
+    if (_mode == Mode::Read) {
+        drop(_released, _file->pos());
+    } else {
+        drop(_released, _writtenBack);
+    }
+}
+
+void FileSystem::PageCacheReleaser::drop(qint64 from, qint64 to)
+{
+    if (to <= from) {
+        return;
+    }
+#if defined Q_OS_UNIX && !defined Q_OS_MAC
+    posix_fadvise(_file->handle(), from, to - from, POSIX_FADV_DONTNEED);
+#endif
+    _released = to;
+}
 } // namespace OCC
 
 #include "moc_filesystembase.cpp"
@@ -175,6 +175,65 @@ namespace FileSystem {
      * Returns whether a Path is a child of another
      */
     bool OCSYNC_EXPORT isChildPathOf(const QString &child, const QString &parent);
+
+    /**
+     * @brief Inode, size and times of a file, enough to notice any change without reading it
+     *
+     * The times are in milliseconds, ctime is the status change time.
+     * On Windows the inode is the file index.
+     */
+    struct FileStamp
+    {
+        quint64 inode = 0;
+        qint64 size = -1;
+        qint64 modtime = 0;
+        qint64 ctime = 0;
+    };
+
+    /**
+     * @return false if the file does not exist or can't be accessed
+     */
+    bool OCSYNC_EXPORT getFileStamp(const QString &filename, FileStamp *stamp);
+
+    /**
+     * @brief Keeps a file that is read or written once out of the page cache
+     *
+     * Used for the bulk reads and writes of the sync, so syncing large files
+     * does not push the rest of the system out of the cache. The file is
+     * read with a larger readahead and the pages behind the current position
+     * are dropped in windows of a few MB. Written pages are dirty until they
+     * are written back, their writeback is started when a window is complete
+     * and they are dropped one window later.
+     *
+     * Only does something on Linux and other systems with posix_fadvise().
+     */
+    class OCSYNC_EXPORT PageCacheReleaser
+    {
+    public:
+        enum class Mode {
+            Read,
+            Write
+        };
+
+        /// @a file has to be open, @a start is the position the reads or writes start at
+        PageCacheReleaser(QFile *file, Mode mode, qint64 start);
+
+        /// To be called with the position in the file after each read or write
+        void advance(qint64 position);
+
+        /// Drops what was read up to the last position, written pages only if they were written back
+        void finish();
+
+    private:
+        void drop(qint64 from, qint64 to);
+
+        QFile *_file;
+        Mode _mode;
+        /// Everything before it was dropped
+        qint64 _released;
+        /// The writeback was started for everything before it
+        qint64 _writtenBack;
+    };
 }
 
 /** @} */
@@ -75,6 +75,9 @@ public:
         DeleteUploadInfoQuery,
         DeleteFileRecordPhash,
         DeleteFileRecordRecursively,
+        MoveFileRecordsQuery,
+        MoveFlagsQuery,
+        DeleteMovedFlagsQuery,
         GetErrorBlacklistQuery,
         SetErrorBlacklistQuery,
         GetSelectiveSyncListQuery,
@@ -90,9 +93,12 @@ public:
         GetRawPinStateQuery,
         GetEffectivePinStateQuery,
         GetSubPinsQuery,
-        CountDehydratedFilesQuery,
+        GetFileRecordTypeQuery,
         SetPinStateQuery,
         WipePinStateQuery,
+        GetChecksumCacheQuery,
+        SetChecksumCacheQuery,
+        TouchChecksumCacheQuery,
 
         PreparedQueryCount
     };
@@ -17,6 +17,7 @@
  */
 
 #include <QCryptographicHash>
+#include <QDateTime>
 #include <QFile>
 #include <QLoggingCategory>
 #include <QStringList>
@@ -25,6 +26,7 @@
 #include <QDir>
 #include <sqlite3.h>
 #include <cstring>
+#include <utility>
 
 #include "common/asserts.h"
 #include "common/checksums.h"
@@ -67,6 +69,16 @@ static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &que
     rec._checksumHeader = query.baValue(9);
 }
 
+static bool isHydratedType(int type)
+{
+    return type == ItemTypeFile || type == ItemTypeVirtualFileDehydration;
+}
+
+static bool isDehydratedType(int type)
+{
+    return type == ItemTypeVirtualFile || type == ItemTypeVirtualFileDownload;
+}
+
 static QByteArray defaultJournalMode(const QString &dbPath)
 {
 #if defined(Q_OS_WIN)
@@ -363,6 +375,11 @@ bool SyncJournalDb::checkConnect()
                                     sqlite3_result_int64(ctx, c_jhash64(reinterpret_cast<const uint8_t*>(text),
                                                                         end - text, 0));
                                 }, nullptr, nullptr);
+    sqlite3_create_function(_db.sqliteDb(), "path_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                                [] (sqlite3_context *ctx,int, sqlite3_value **argv) {
+                                    auto text = sqlite3_value_text(argv[0]);
+                                    sqlite3_result_int64(ctx, c_jhash64(text, sqlite3_value_bytes(argv[0]), 0));
+                                }, nullptr, nullptr);
 
     /* Because insert is so slow, we do everything in a transaction, and only need one call to commit */
     startTransaction();
@@ -488,6 +505,21 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table flags"), createQuery);
     }
 
+    // create the checksumcache table.
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS checksumcache("
+                        "inode INTEGER,"
+                        "checksumTypeId INTEGER,"
+                        "size INTEGER(8),"
+                        "modtime INTEGER(8),"
+                        "ctime INTEGER(8),"
+                        "checksum TEXT,"
+                        "lastused INTEGER(8),"
+                        "PRIMARY KEY(inode, checksumTypeId)"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table checksumcache"), createQuery);
+    }
+
     // create the conflicts table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS conflicts("
                         "path TEXT PRIMARY KEY,"
@@ -607,6 +639,7 @@ bool SyncJournalDb::checkConnect()
     // This avoid reading from the DB if we already know it is empty
     // thereby speeding up the initial discovery significantly.
     _metadataTableIsEmpty = (getFileRecordCount() == 0);
+    loadErrorBlacklistPaths();
 
     // Hide 'em all!
     FileSystem::setFileHidden(databaseFilePath(), true);
@@ -626,6 +659,8 @@ void SyncJournalDb::close()
     _db.close();
     clearEtagStorageFilter();
     _metadataTableIsEmpty = false;
+    _errorBlacklistPaths.clear();
+    clearHydrationCounts();
 }
 
 
@@ -919,6 +954,11 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
         query->bindValue(15, checksum);
         query->bindValue(16, contentChecksumTypeId);
 
+        int oldType = -1;
+        if (_hydrationCountsLoaded && !getFileRecordType(record._path, &oldType)) {
+            clearHydrationCounts();
+        }
+
         if (!query->exec()) {
             return query->error();
         }
@@ -926,6 +966,12 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
         // Can't be true anymore.
         _metadataTableIsEmpty = false;
 
+        if (_hydrationCountsLoaded) {
+            updateHydrationCounts(record._path,
+                int(isHydratedType(record._type)) - int(isHydratedType(oldType)),
+                int(isDehydratedType(record._type)) - int(isDehydratedType(oldType)));
+        }
+
         return {};
     } else {
         qCWarning(lcDb) << "Failed to connect database.";
@@ -942,18 +988,28 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
         // if (!recursively) {
         // always delete the actual file.
 
+        const QByteArray path = filename.toUtf8();
         {
+            int oldType = -1;
+            if (_hydrationCountsLoaded && !getFileRecordType(path, &oldType)) {
+                clearHydrationCounts();
+            }
+
             const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileRecordPhash, QByteArrayLiteral("DELETE FROM metadata WHERE phash=?1"), _db);
             if (!query) {
                 return false;
             }
 
-            const qint64 phash = getPHash(filename.toUtf8());
+            const qint64 phash = getPHash(path);
             query->bindValue(1, phash);
 
             if (!query->exec()) {
                 return false;
             }
+
+            if (_hydrationCountsLoaded) {
+                updateHydrationCounts(path, -int(isHydratedType(oldType)), -int(isDehydratedType(oldType)));
+            }
         }
 
         if (recursively) {
@@ -964,6 +1020,20 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
             if (!query->exec()) {
                 return false;
             }
+
+            if (_hydrationCountsLoaded) {
+                // Everything below the path is gone, remove it from the parents and drop the sub directories
+                const auto counts = _hydrationCounts.value(path);
+                updateHydrationCounts(path, -counts.hydrated, -counts.dehydrated);
+                const QByteArray prefix = path + '/';
+                for (auto it = _hydrationCounts.begin(); it != _hydrationCounts.end();) {
+                    if (it.key() == path || it.key().startsWith(prefix)) {
+                        it = _hydrationCounts.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
         }
         return true;
     } else {
@@ -972,6 +1042,62 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
     }
 }
 
+bool SyncJournalDb::moveFileRecordsBelow(const QString &from, const QString &to)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        qCWarning(lcDb) << "Failed to connect database.";
+        return false;
+    }
+
+    const QByteArray fromPath = from.toUtf8();
+    const QByteArray toPath = to.toUtf8();
+    auto exec = [&](PreparedSqlQueryManager::Key key, const QByteArray &sql, bool bindTarget) {
+        const auto query = _queryManager.get(key, sql, _db);
+        if (!query) {
+            return -1;
+        }
+        query->bindValue(1, fromPath);
+        if (bindTarget) {
+            query->bindValue(2, toPath);
+            query->bindValue(3, fromPath.size() + 1);
+        }
+        if (!query->exec()) {
+            return -1;
+        }
+        return query->numRowsAffected();
+    };
+
+    // ?1 is the old prefix, ?2 the new one and ?3 the position after the old prefix.
+    // substr() works on the utf8 bytes, like the path length and hash.
+    // The records the sync already wrote at the new path are newer, the old ones are
+    // left behind and deleted with the rest of the old path.
+#define MOVED_PATH "(?2 || substr(CAST(path AS BLOB), ?3))"
+    const int moved = exec(PreparedSqlQueryManager::MoveFileRecordsQuery,
+        QByteArrayLiteral("UPDATE OR IGNORE metadata SET path = " MOVED_PATH ", phash = path_hash(" MOVED_PATH "),"
+                          " pathlen = length(CAST(" MOVED_PATH " AS BLOB))"
+                          " WHERE " IS_PREFIX_PATH_OF("?1", "path")),
+        true);
+    if (moved < 0
+        || exec(PreparedSqlQueryManager::MoveFlagsQuery,
+               QByteArrayLiteral("UPDATE OR IGNORE flags SET path = " MOVED_PATH " WHERE " IS_PREFIX_PATH_OF("?1", "path")), true)
+            < 0) {
+        return false;
+    }
+#undef MOVED_PATH
+    qCInfo(lcDb) << "Moved" << moved << "file records from" << from << "to" << to;
+
+    if (exec(PreparedSqlQueryManager::DeleteFileRecordRecursively, QByteArrayLiteral("DELETE FROM metadata WHERE " IS_PREFIX_PATH_OF("?1", "path")), false) < 0
+        || exec(PreparedSqlQueryManager::DeleteMovedFlagsQuery, QByteArrayLiteral("DELETE FROM flags WHERE " IS_PREFIX_PATH_OF("?1", "path")), false) < 0) {
+        return false;
+    }
+
+    // the counts of the old and new parents are recomputed when they are needed again
+    clearHydrationCounts();
+    return true;
+}
+
 
 bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec)
 {
@@ -1233,35 +1359,99 @@ Optional<SyncJournalDb::HasHydratedDehydrated> SyncJournalDb::hasHydratedOrDehyd
     QMutexLocker locker(&_mutex);
     if (!checkConnect())
         return {};
-
-    const auto query = _queryManager.get(PreparedSqlQueryManager::CountDehydratedFilesQuery, QByteArrayLiteral("SELECT DISTINCT type FROM metadata"
-                                                                                                               " WHERE (" IS_PREFIX_PATH_OR_EQUAL("?1", "path") " OR ?1 == '');"),
-        _db);
-    if (!query) {
-        return {};
-    }
-
-    query->bindValue(1, filename);
-    if (!query->exec())
+    if (!_hydrationCountsLoaded && !loadHydrationCounts())
         return {};
 
     HasHydratedDehydrated result;
-    forever {
-        auto next = query->next();
-        if (!next.ok)
+    const auto counts = _hydrationCounts.constFind(filename);
+    if (counts != _hydrationCounts.cend()) {
+        result.hasHydrated = counts->hydrated > 0;
+        result.hasDehydrated = counts->dehydrated > 0;
+    }
+
+    // The counts only cover the files below, add the item itself
+    if (!filename.isEmpty()) {
+        int type = -1;
+        if (!getFileRecordType(filename, &type))
             return {};
-        if (!next.hasData)
-            break;
-        auto type = static_cast<ItemType>(query->intValue(0));
-        if (type == ItemTypeFile || type == ItemTypeVirtualFileDehydration)
+        if (isHydratedType(type))
             result.hasHydrated = true;
-        if (type == ItemTypeVirtualFile || type == ItemTypeVirtualFileDownload)
+        if (isDehydratedType(type))
             result.hasDehydrated = true;
     }
 
     return result;
 }
 
+bool SyncJournalDb::getFileRecordType(const QByteArray &path, int *type)
+{
+    *type = -1;
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordTypeQuery, QByteArrayLiteral("SELECT type FROM metadata WHERE phash=?1"), _db);
+    if (!query) {
+        return false;
+    }
+    query->bindValue(1, getPHash(path));
+    if (!query->exec()) {
+        return false;
+    }
+    auto next = query->next();
+    if (!next.ok) {
+        return false;
+    }
+    if (next.hasData) {
+        *type = query->intValue(0);
+    }
+    return true;
+}
+
+bool SyncJournalDb::loadHydrationCounts()
+{
+    clearHydrationCounts();
+    SqlQuery query(_db);
+    static_assert(ItemTypeFile == 0 && ItemTypeVirtualFile == 4 && ItemTypeVirtualFileDownload == 5 && ItemTypeVirtualFileDehydration == 6, "");
+    query.prepare("SELECT path, type FROM metadata WHERE type IN (0, 4, 5, 6)");
+    if (!query.exec()) {
+        sqlFail(QStringLiteral("loadHydrationCounts"), query);
+        return false;
+    }
+    forever {
+        auto next = query.next();
+        if (!next.ok) {
+            clearHydrationCounts();
+            return false;
+        }
+        if (!next.hasData)
+            break;
+        const int type = query.intValue(1);
+        updateHydrationCounts(query.baValue(0), isHydratedType(type) ? 1 : 0, isDehydratedType(type) ? 1 : 0);
+    }
+    _hydrationCountsLoaded = true;
+    qCInfo(lcDb) << "Loaded the hydration counts of" << _hydrationCounts.size() << "directories";
+    return true;
+}
+
+void SyncJournalDb::clearHydrationCounts()
+{
+    _hydrationCounts.clear();
+    _hydrationCountsLoaded = false;
+}
+
+void SyncJournalDb::updateHydrationCounts(const QByteArray &path, qint64 hydratedDelta, qint64 dehydratedDelta)
+{
+    if (hydratedDelta == 0 && dehydratedDelta == 0)
+        return;
+    QByteArray parent = path;
+    while (!parent.isEmpty()) {
+        parent.truncate(qMax(parent.lastIndexOf('/'), 0));
+        auto &counts = _hydrationCounts[parent];
+        counts.hydrated += hydratedDelta;
+        counts.dehydrated += dehydratedDelta;
+        if (counts.hydrated <= 0 && counts.dehydrated <= 0) {
+            _hydrationCounts.remove(parent);
+        }
+    }
+}
+
 static void toDownloadInfo(SqlQuery &query, SyncJournalDb::DownloadInfo *res)
 {
     bool ok = true;
@@ -1503,6 +1693,26 @@ QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
     return ids;
 }
 
+QString SyncJournalDb::errorBlacklistKey(const QString &file)
+{
+    // the lookup is case insensitive on case preserving file systems
+    return Utility::fsCasePreserving() ? file.toCaseFolded() : file;
+}
+
+void SyncJournalDb::loadErrorBlacklistPaths()
+{
+    _errorBlacklistPaths.clear();
+    SqlQuery query(_db);
+    query.prepare("SELECT path FROM blacklist");
+    if (!query.exec()) {
+        sqlFail(QStringLiteral("loadErrorBlacklistPaths"), query);
+        return;
+    }
+    while (query.next().hasData) {
+        _errorBlacklistPaths.insert(errorBlacklistKey(query.stringValue(0)));
+    }
+}
+
 SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString &file)
 {
     QMutexLocker locker(&_mutex);
@@ -1511,7 +1721,7 @@ SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString
     if (file.isEmpty())
         return entry;
 
-    if (checkConnect()) {
+    if (checkConnect() && _errorBlacklistPaths.contains(errorBlacklistKey(file))) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::GetErrorBlacklistQuery);
         query->bindValue(1, file);
         if (query->exec()) {
@@ -1560,7 +1770,9 @@ bool SyncJournalDb::deleteStaleErrorBlacklistEntries(const QSet<QString> &keep)
 
     SqlQuery delQuery(_db);
     delQuery.prepare("DELETE FROM blacklist WHERE path = ?");
-    return deleteBatch(delQuery, superfluousPaths, QStringLiteral("blacklist"));
+    const bool ok = deleteBatch(delQuery, superfluousPaths, QStringLiteral("blacklist"));
+    loadErrorBlacklistPaths();
+    return ok;
 }
 
 void SyncJournalDb::deleteStaleFlagsEntries()
@@ -1573,6 +1785,84 @@ void SyncJournalDb::deleteStaleFlagsEntries()
     delQuery.exec();
 }
 
+QByteArray SyncJournalDb::getCachedChecksum(const ChecksumCacheKey &key, const QByteArray &checksumType)
+{
+    QMutexLocker locker(&_mutex);
+    if (!key.isValid() || !checkConnect())
+        return {};
+
+    const int checksumTypeId = mapChecksumType(checksumType);
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetChecksumCacheQuery, QByteArrayLiteral("SELECT size, modtime, ctime, checksum FROM checksumcache "
+                                                                                                            "WHERE inode=?1 AND checksumTypeId=?2;"),
+        _db);
+    if (!query) {
+        return {};
+    }
+    query->bindValue(1, key.inode);
+    query->bindValue(2, checksumTypeId);
+    if (!query->exec()) {
+        return {};
+    }
+    // the inode might have been reused by another file, or the file was modified
+    if (!query->next().hasData || query->int64Value(0) != key.size || query->int64Value(1) != key.modtime || query->int64Value(2) != key.ctime) {
+        ++_checksumCacheStatistics.misses;
+        return {};
+    }
+    const auto checksum = query->baValue(3);
+    ++_checksumCacheStatistics.hits;
+
+    const auto touchQuery = _queryManager.get(PreparedSqlQueryManager::TouchChecksumCacheQuery, QByteArrayLiteral("UPDATE checksumcache SET lastused=?3 "
+                                                                                                                  "WHERE inode=?1 AND checksumTypeId=?2;"),
+        _db);
+    if (touchQuery) {
+        touchQuery->bindValue(1, key.inode);
+        touchQuery->bindValue(2, checksumTypeId);
+        touchQuery->bindValue(3, QDateTime::currentSecsSinceEpoch());
+        touchQuery->exec();
+    }
+    return checksum;
+}
+
+void SyncJournalDb::setCachedChecksum(const ChecksumCacheKey &key, const QByteArray &checksumType, const QByteArray &checksum)
+{
+    QMutexLocker locker(&_mutex);
+    if (!key.isValid() || checksum.isEmpty() || !checkConnect())
+        return;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::SetChecksumCacheQuery, QByteArrayLiteral("INSERT OR REPLACE INTO checksumcache "
+                                                                                                            "(inode, checksumTypeId, size, modtime, ctime, checksum, lastused) "
+                                                                                                            "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7);"),
+        _db);
+    if (!query) {
+        return;
+    }
+    query->bindValue(1, key.inode);
+    query->bindValue(2, mapChecksumType(checksumType));
+    query->bindValue(3, key.size);
+    query->bindValue(4, key.modtime);
+    query->bindValue(5, key.ctime);
+    query->bindValue(6, checksum);
+    query->bindValue(7, QDateTime::currentSecsSinceEpoch());
+    query->exec();
+}
+
+void SyncJournalDb::deleteStaleChecksumCacheEntries()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    SqlQuery delQuery("DELETE FROM checksumcache WHERE lastused < ?1;", _db);
+    delQuery.bindValue(1, QDateTime::currentSecsSinceEpoch() - 7 * 24 * 60 * 60);
+    delQuery.exec();
+}
+
+SyncJournalDb::ChecksumCacheStatistics SyncJournalDb::takeChecksumCacheStatistics()
+{
+    QMutexLocker locker(&_mutex);
+    return std::exchange(_checksumCacheStatistics, {});
+}
+
 int SyncJournalDb::errorBlackListEntryCount()
 {
     int re = 0;
@@ -1603,6 +1893,7 @@ int SyncJournalDb::wipeErrorBlacklist()
             sqlFail(QStringLiteral("Deletion of whole blacklist failed"), query);
             return -1;
         }
+        _errorBlacklistPaths.clear();
         return query.numRowsAffected();
     }
     return -1;
@@ -1623,6 +1914,9 @@ void SyncJournalDb::wipeErrorBlacklistEntry(const QString &relativeFile)
         query.bindValue(1, relativeFile);
         if (!query.exec()) {
             sqlFail(QStringLiteral("Deletion of blacklist item failed."), query);
+        } else if (!Utility::fsCasePreserving()) {
+            // with case folded keys another spelling might still be in the table
+            _errorBlacklistPaths.remove(relativeFile);
         }
     }
 }
@@ -1658,6 +1952,7 @@ void SyncJournalDb::wipeErrorBlacklistCategory(SyncJournalErrorBlacklistRecord::
         if (!query.exec()) {
             sqlFail(QStringLiteral("Deletion of blacklist category failed."), query);
         }
+        loadErrorBlacklistPaths();
     }
 }
 
@@ -1692,7 +1987,9 @@ void SyncJournalDb::setErrorBlacklistEntry(const SyncJournalErrorBlacklistRecord
     query->bindValue(8, item._renameTarget);
     query->bindValue(9, item._errorCategory);
     query->bindValue(10, item._requestId);
-    query->exec();
+    if (query->exec()) {
+        _errorBlacklistPaths.insert(errorBlacklistKey(item._file));
+    }
 }
 
 QStringList SyncJournalDb::getSelectiveSyncList(SyncJournalDb::SelectiveSyncListType type, bool *ok)
@@ -2036,6 +2333,7 @@ void SyncJournalDb::clearFileTable()
     SqlQuery query(_db);
     query.prepare("DELETE FROM metadata;");
     query.exec();
+    clearHydrationCounts();
 }
 
 void SyncJournalDb::markVirtualFileForDownloadRecursively(const QByteArray &path)
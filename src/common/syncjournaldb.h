@@ -23,6 +23,7 @@
 #include <qmutex.h>
 #include <QDateTime>
 #include <QHash>
+#include <QSet>
 #include <functional>
 
 #include "common/utility.h"
@@ -35,6 +36,22 @@
 namespace OCC {
 class SyncJournalFileRecord;
 
+/**
+ * Identifies the content of a local file for the checksum cache
+ *
+ * A cached checksum is only used while all fields still match the file,
+ * the times are in milliseconds.
+ */
+struct ChecksumCacheKey
+{
+    quint64 inode = 0;
+    qint64 size = -1;
+    qint64 modtime = 0;
+    qint64 ctime = 0;
+
+    bool isValid() const { return inode != 0 && size >= 0; }
+};
+
 /**
  * @brief Class that handles the sync database
  *
@@ -65,6 +82,16 @@ public:
     Result<void, QString> setFileRecord(const SyncJournalFileRecord &record);
 
     bool deleteFileRecord(const QString &filename, bool recursively = false);
+
+    /**
+     * Moves the records and pin states below the directory @a from to the directory @a to.
+     *
+     * Used when a directory was renamed: the records of its unchanged contents
+     * are moved with one statement instead of being rewritten one by one. The
+     * record of the directory itself is not touched. Records that already exist
+     * at the destination are kept, whatever is left below @a from is deleted.
+     */
+    bool moveFileRecordsBelow(const QString &from, const QString &to);
     bool updateFileRecordChecksum(const QString &filename,
         const QByteArray &contentChecksum,
         const QByteArray &contentChecksumType);
@@ -146,6 +173,20 @@ public:
     /// Delete flags table entries that have no metadata correspondent
     void deleteStaleFlagsEntries();
 
+    struct ChecksumCacheStatistics
+    {
+        qint64 hits = 0;
+        qint64 misses = 0;
+    };
+
+    /// Returns the cached checksum of the file identified by @a key, or a null QByteArray
+    QByteArray getCachedChecksum(const ChecksumCacheKey &key, const QByteArray &checksumType);
+    void setCachedChecksum(const ChecksumCacheKey &key, const QByteArray &checksumType, const QByteArray &checksum);
+    /// Delete checksum cache entries that were not used for a week
+    void deleteStaleChecksumCacheEntries();
+    /// Returns the lookups since the last call
+    ChecksumCacheStatistics takeChecksumCacheStatistics();
+
     void avoidRenamesOnNextSync(const QString &path) { avoidRenamesOnNextSync(path.toUtf8()); }
     void avoidRenamesOnNextSync(const QByteArray &path);
 
@@ -383,13 +424,52 @@ private:
     // Returns 0 on failure and for empty checksum types.
     int mapChecksumType(const QByteArray &checksumType);
 
+    // Fills _errorBlacklistPaths from the blacklist table
+    void loadErrorBlacklistPaths();
+    // The key of a path in _errorBlacklistPaths
+    static QString errorBlacklistKey(const QString &file);
+
+    // Fills _hydrationCounts from the metadata table
+    bool loadHydrationCounts();
+    void clearHydrationCounts();
+    // Adds the deltas to the counts of all parent directories of path
+    void updateHydrationCounts(const QByteArray &path, qint64 hydratedDelta, qint64 dehydratedDelta);
+    // Sets type to the type of the record, or to -1 if there is none. Returns false on db errors.
+    bool getFileRecordType(const QByteArray &path, int *type);
+
     SqlDatabase _db;
     QString _dbFile;
     QMutex _mutex; // Public functions are protected with the mutex.
     QMap<QByteArray, int> _checksymTypeCache;
+    ChecksumCacheStatistics _checksumCacheStatistics;
     int _transaction;
     bool _metadataTableIsEmpty;
 
+    /* The paths in the blacklist table, loaded when the db is opened.
+     *
+     * The blacklist is usually tiny compared to the number of items a sync
+     * checks against it, errorBlacklistEntry() only queries the db for paths
+     * contained here. It may contain paths that were removed from the table
+     * but never misses one that is in it.
+     */
+    QSet<QString> _errorBlacklistPaths;
+
+    struct HydrationCounts
+    {
+        qint64 hydrated = 0;
+        qint64 dehydrated = 0;
+    };
+
+    /* The number of hydrated and dehydrated files below each directory.
+     *
+     * Loaded by the first hasHydratedOrDehydratedFiles() call and kept up to
+     * date by setFileRecord() and deleteFileRecord() afterwards, so the
+     * availability of a folder doesn't need a query over all its files.
+     * Directories without any such files have no entry.
+     */
+    QHash<QByteArray, HydrationCounts> _hydrationCounts;
+    bool _hydrationCountsLoaded = false;
+
     /* Storing etags to these folders, or their parent folders, is filtered out.
      *
      * When schedulePathForRemoteDiscovery() is called some etags to _invalid_ in the
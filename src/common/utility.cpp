@@ -37,6 +37,7 @@
 #include <QSysInfo>
 #include <QTextStream>
 #include <QThread>
+#include <QThreadPool>
 #include <QUrl>
 
 #ifdef Q_OS_UNIX
@@ -45,6 +46,13 @@
 #include <unistd.h>
 #endif
 
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
 #include <cstring>
 #include <math.h>
 #include <stdarg.h>
@@ -176,6 +184,38 @@ qint64 Utility::freeDiskSpace(const QString &path)
     return -1;
 }
 
+QThreadPool *Utility::backgroundThreadPool()
+{
+    static QThreadPool pool;
+    return &pool;
+}
+
+void Utility::lowerCurrentThreadPriority()
+{
+#ifdef Q_OS_LINUX
+    thread_local bool lowered = false;
+    if (lowered) {
+        return;
+    }
+    lowered = true;
+
+    // ioprio_set has no glibc wrapper, the constants are from linux/ioprio.h
+    constexpr int ioprioWhoProcess = 1;
+    constexpr int ioprioClassIdle = 3;
+    constexpr int ioprioClassShift = 13;
+    const auto tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (syscall(SYS_ioprio_set, ioprioWhoProcess, tid, ioprioClassIdle << ioprioClassShift) != 0) {
+        qCWarning(lcUtility) << "Failed to set the idle I/O priority:" << strerror(errno);
+    }
+
+    sched_param param = {};
+    if (sched_setscheduler(tid, SCHED_IDLE, &param) != 0) {
+        qCWarning(lcUtility) << "Failed to set the idle scheduling policy:" << strerror(errno);
+        setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 19);
+    }
+#endif
+}
+
 QString Utility::compactFormatDouble(double value, int prec, const QString &unit)
 {
     QLocale locale = QLocale::system();
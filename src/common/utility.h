@@ -38,6 +38,7 @@
 #endif
 
 class QSettings;
+class QThreadPool;
 
 namespace OCC {
 
@@ -75,6 +76,22 @@ OCSYNC_EXPORT Q_DECLARE_LOGGING_CATEGORY(lcUtility)
      */
     OCSYNC_EXPORT qint64 freeDiskSpace(const QString &path);
 
+    /**
+     * A thread pool for background work like local discovery and checksums
+     * that should not compete with the applications of the user.
+     *
+     * The work run on it calls lowerCurrentThreadPriority() first.
+     */
+    OCSYNC_EXPORT QThreadPool *backgroundThreadPool();
+
+    /**
+     * Moves the calling thread to the idle I/O and CPU scheduling classes.
+     *
+     * Only implemented on Linux. An unprivileged process can't raise the
+     * priority again, only call this on threads of backgroundThreadPool().
+     */
+    OCSYNC_EXPORT void lowerCurrentThreadPriority();
+
     /**
      * @brief compactFormatDouble - formats a double value human readable.
      *
@@ -98,6 +98,9 @@ private:
  *
  * An instance is usually created through a plugin via the createVfsFromPlugin()
  * function.
+ *
+ * All functions are called from the thread the instance lives in, unless
+ * stated otherwise.
  */
 class OCSYNC_EXPORT Vfs : public QObject
 {
@@ -181,6 +184,15 @@ public:
     /// Create a new dehydrated placeholder. Called from PropagateDownload.
     virtual OC_REQUIRED_RESULT Result<void, QString> createPlaceholder(const SyncFileItem &item) = 0;
 
+    /** Whether createPlaceholder() may be called from a worker thread
+     *
+     * The calls for different items may then run concurrently with each other
+     * and with calls of other functions on the instance's thread. Plugins that
+     * return true must not touch shared state in createPlaceholder(), apart from
+     * the file of the item.
+     */
+    virtual bool canCreatePlaceholdersInThread() const { return false; }
+
     /** Discovery hook: even unchanged files may need UPDATE_METADATA.
      *
      * For instance cfapi vfs wants local hydrated non-placeholder files to
@@ -29,6 +29,7 @@
 class QDialog;
 class QMessageBox;
 class QSettings;
+class TestFolderMan;
 
 namespace OCC {
 
@@ -143,6 +144,8 @@ public slots:
     void checkConnectivity(bool verifyServerState = false);
 
 private:
+    friend class ::TestFolderMan;
+
     /// Use the account as parent
     explicit AccountState(AccountPtr account);
 
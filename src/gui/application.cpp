@@ -35,6 +35,7 @@
 #include "folderman.h"
 #include "logbrowser.h"
 #include "logger.h"
+#include "memorybudget.h"
 #include "settingsdialog.h"
 #include "sharedialog.h"
 #include "socketapi/socketapi.h"
@@ -287,6 +288,10 @@ Application::Application(int &argc, char **argv)
     if (AbstractNetworkJob::httpTimeout == AbstractNetworkJob::DefaultHttpTimeout) {
         AbstractNetworkJob::httpTimeout = cfg.timeout();
     }
+    // Same for the memory budget
+    if (MemoryBudget::instance()->budget() == 0) {
+        MemoryBudget::instance()->setBudget(cfg.memoryBudget());
+    }
 
     // Check vfs plugins
     if (Theme::instance()->showVirtualFilesOption() && bestAvailableVfsMode() == Vfs::Off) {
@@ -340,7 +340,7 @@ bool Folder::dueToSync() const
     // the default poll time of 30 seconds as it had been in the client forever.
     // Now with https://github.com/owncloud/client/pull/8777 also the server capabilities are considered.
     const auto pta = accountState()->account()->capabilities().remotePollInterval();
-    const auto polltime = cfg.remotePollInterval(pta);
+    const auto polltime = cfg.remotePollInterval(pta) * _etagPollBackoff;
 
     const auto timeSinceLastSync = std::chrono::milliseconds(_timeSinceLastEtagCheckDone.elapsed());
     if (timeSinceLastSync >= polltime) {
@@ -410,11 +410,29 @@ void Folder::slotRunEtagJob()
     _requestEtagJob->setTimeout(60s);
     // check if the etag is different when retrieved
     QObject::connect(_requestEtagJob.data(), &RequestEtagJob::etagRetreived, this, &Folder::etagRetreived);
+    if (!_pendingDrivesEtag.isEmpty()) {
+        // only remember the drives etag once the PROPFIND succeeded, a failed check must not hide the change
+        QObject::connect(_requestEtagJob.data(), &RequestEtagJob::etagRetreived, this, [this, drivesEtag = std::exchange(_pendingDrivesEtag, QByteArray())] {
+            _lastDrivesEtag = drivesEtag;
+        });
+    }
     QObject::connect(_requestEtagJob.data(), &RequestEtagJob::finishedWithResult, this, [=](const HttpResult<QByteArray>) { _timeSinceLastEtagCheckDone.start(); });
     FolderMan::instance()->slotScheduleETagJob(alias(), _requestEtagJob);
     // The _requestEtagJob is auto deleting itself on finish. Our guard pointer _requestEtagJob will then be null.
 }
 
+void Folder::etagRetrievedFromDrives(const QByteArray &etag)
+{
+    if (etag.isEmpty() || etag != _lastDrivesEtag) {
+        // the drives etag is not necessarily the one of the PROPFIND, let the regular job compare it
+        _pendingDrivesEtag = etag;
+        slotRunEtagJob();
+        return;
+    }
+    _timeSinceLastEtagCheckDone.start();
+    etagRetreived(_lastEtag, QDateTime::currentDateTimeUtc());
+}
+
 void Folder::etagRetreived(const QByteArray &etag, const QDateTime &tp)
 {
     // re-enable sync if it was disabled because network was down
@@ -423,7 +441,11 @@ void Folder::etagRetreived(const QByteArray &etag, const QDateTime &tp)
     if (_lastEtag != etag) {
         qCInfo(lcFolder) << "Compare etag with previous etag: last:" << _lastEtag << ", received:" << etag << "-> CHANGED";
         _lastEtag = etag;
+        _etagPollBackoff = 1;
         slotScheduleThisFolder();
+    } else if (ConfigFile().remotePollBackoff()) {
+        // nothing changed, poll less often until something happens
+        _etagPollBackoff = qMin(_etagPollBackoff * 2, MaxEtagPollBackoff);
     }
 
     _accountState->tagLastSuccessfullETagRequest(tp);
@@ -434,6 +456,8 @@ void Folder::etagRetrievedFromSyncEngine(const QByteArray &etag, const QDateTime
     qCInfo(lcFolder) << "Root etag from during sync:" << etag;
     accountState()->tagLastSuccessfullETagRequest(time);
     _lastEtag = etag;
+    // a sync ran, poll at the regular interval again
+    _etagPollBackoff = 1;
 }
 
 
@@ -964,6 +988,8 @@ void Folder::setSyncOptions()
     opt._moveFilesToTrash = cfgFile.moveToTrash();
     opt._vfs = _vfs;
     opt._parallelNetworkJobs = _accountState->account()->isHttp2Supported() ? 20 : 6;
+    opt._backgroundPriority = _definition.backgroundPriority;
+    opt._releasePageCache = _definition.releasePageCache;
 
     opt._initialChunkSize = cfgFile.chunkSize();
     opt._minChunkSize = cfgFile.minChunkSize();
@@ -1350,6 +1376,8 @@ void FolderDefinition::save(QSettings &settings, const FolderDefinition &folder)
     settings.setValue(davUrlC(), folder.webDavUrl());
     settings.setValue(QLatin1String("paused"), folder.paused);
     settings.setValue(QLatin1String("ignoreHiddenFiles"), folder.ignoreHiddenFiles);
+    settings.setValue(QStringLiteral("backgroundPriority"), folder.backgroundPriority);
+    settings.setValue(QStringLiteral("releasePageCache"), folder.releasePageCache);
 
     settings.setValue(QStringLiteral("virtualFilesMode"), Vfs::modeToString(folder.virtualFilesMode));
 
@@ -1374,6 +1402,8 @@ FolderDefinition FolderDefinition::load(QSettings &settings, const QString &alia
     folder.setTargetPath(settings.value(QLatin1String("targetPath")).toString());
     folder.paused = settings.value(QLatin1String("paused")).toBool();
     folder.ignoreHiddenFiles = settings.value(QLatin1String("ignoreHiddenFiles"), QVariant(true)).toBool();
+    folder.backgroundPriority = settings.value(QStringLiteral("backgroundPriority"), true).toBool();
+    folder.releasePageCache = settings.value(QStringLiteral("releasePageCache"), true).toBool();
     folder.navigationPaneClsid = settings.value(QLatin1String("navigationPaneClsid")).toUuid();
 
     folder.virtualFilesMode = Vfs::Off;
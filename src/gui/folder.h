@@ -35,6 +35,7 @@
 
 class QThread;
 class QSettings;
+class TestFolderMan;
 
 namespace OCC {
 
@@ -63,6 +64,10 @@ public:
     bool paused = false;
     /// whether the folder syncs hidden files
     bool ignoreHiddenFiles = true;
+    /// whether discovery and checksums run with low I/O and CPU priority
+    bool backgroundPriority = true;
+    /// whether large files are read and written without keeping them in the page cache
+    bool releasePageCache = true;
     /// Which virtual files setting the folder uses
     Vfs::Mode virtualFilesMode = Vfs::Off;
     /// The CLSID where this folder appears in registry for the Explorer navigation pane entry.
@@ -346,6 +351,14 @@ public slots:
 
     void slotRunEtagJob();
 
+    /**
+     * The etag of the space from a GraphApi::Drives listing of all spaces of the account.
+     *
+     * Only runs the etag job if it differs from the one of the previous listing,
+     * an empty etag always runs it.
+     */
+    void etagRetrievedFromDrives(const QByteArray &etag);
+
     /**
        * terminate the current sync run
        */
@@ -453,6 +466,8 @@ private slots:
     void slotHydrationDone();
 
 private:
+    friend class ::TestFolderMan;
+
     void connectSyncRoot();
 
     void showSyncResultPopup();
@@ -484,7 +499,14 @@ private:
     QScopedPointer<SyncEngine> _engine;
     QPointer<RequestEtagJob> _requestEtagJob;
     QByteArray _lastEtag;
+    /// The etag of the space root in the previous drives listing, see etagRetrievedFromDrives()
+    QByteArray _lastDrivesEtag;
+    /// A changed drives etag, it becomes _lastDrivesEtag once a PROPFIND succeeded
+    QByteArray _pendingDrivesEtag;
     QElapsedTimer _timeSinceLastEtagCheckDone;
+    /// The remote poll interval is multiplied by this while the etag does not change
+    int _etagPollBackoff = 1;
+    static constexpr int MaxEtagPollBackoff = 8;
     QElapsedTimer _timeSinceLastSyncDone;
     QElapsedTimer _timeSinceLastSyncStart;
     QElapsedTimer _timeSinceLastFullLocalDiscovery;
@@ -18,9 +18,12 @@
 #include "accountstate.h"
 #include "common/asserts.h"
 #include "configfile.h"
+#include "configstore.h"
 #include "filesystem.h"
 #include "folder.h"
+#include "graphapi/drives.h"
 #include "lockwatcher.h"
+#include "metrics.h"
 #include "ocwizard_deprecated.h"
 #include "socketapi/socketapi.h"
 #include "syncresult.h"
@@ -36,6 +39,9 @@
 #include <QMutableSetIterator>
 #include <QSet>
 #include <QNetworkProxy>
+#include <QNetworkReply>
+
+#include <algorithm>
 
 using namespace std::chrono;
 using namespace std::chrono_literals;
@@ -156,7 +162,6 @@ FolderMan::FolderMan(QObject *parent)
     // rounded up to the next 10 seconds in practice. 10-second granularity is acceptable.
     _etagPollTimer.setInterval(10s);
     QObject::connect(&_etagPollTimer, &QTimer::timeout, this, &FolderMan::slotEtagPollTimerTimeout);
-    _etagPollTimer.start();
 
     _startScheduledSyncTimer.setSingleShot(true);
     connect(&_startScheduledSyncTimer, &QTimer::timeout,
@@ -166,13 +171,20 @@ FolderMan::FolderMan(QObject *parent)
     _timeScheduler.setSingleShot(false);
     connect(&_timeScheduler, &QTimer::timeout,
         this, &FolderMan::slotScheduleFolderByTime);
-    _timeScheduler.start();
+    // the timers are started once there is a folder that can sync
 
     connect(AccountManager::instance(), &AccountManager::accountRemoved,
         this, &FolderMan::slotRemoveFoldersForAccount);
 
     connect(_lockWatcher.data(), &LockWatcher::fileUnlocked,
         this, &FolderMan::slotWatchedFileUnlocked);
+
+    // running syncs pick up changed bandwidth limits, the others read them when they start
+    connect(ConfigStore::instance(), &ConfigStore::changed, this, [this](const QString &key) {
+        if (key.startsWith(QLatin1String("BWLimit/"))) {
+            setDirtyNetworkLimits();
+        }
+    });
 }
 
 FolderMan *FolderMan::instance()
@@ -639,6 +651,7 @@ void FolderMan::slotFolderCanSyncChanged()
     } else {
         _socketApi->slotUnregisterPath(f->alias());
     }
+    updatePollTimers();
 }
 
 Folder *FolderMan::folder(const QString &alias)
@@ -681,6 +694,7 @@ void FolderMan::scheduleFolder(Folder *f)
     auto alias = f->alias();
 
     qCInfo(lcFolderMan) << "Schedule folder " << alias << " to sync!";
+    updatePollTimers();
 
     if (!_scheduledFolders.contains(f)) {
         if (!f->canSync()) {
@@ -766,6 +780,7 @@ void FolderMan::slotAccountStateChanged()
         return;
     }
     QString accountName = accountState->account()->displayName();
+    updatePollTimers();
 
     if (accountState->isConnected()) {
         qCInfo(lcFolderMan) << "Account" << accountName << "connected, scheduling its folders";
@@ -900,6 +915,9 @@ void FolderMan::slotStartScheduledFolderSync()
 
 void FolderMan::slotEtagPollTimerTimeout()
 {
+    Metrics::instance()->incrementCounter(QStringLiteral("sync_timer_wakeups_total"), 1, { { QStringLiteral("timer"), QStringLiteral("etag_poll") } });
+    // the spaces of an account are checked with one request instead of one per folder
+    QMap<AccountState *, QVector<QPointer<Folder>>> drivesFolders;
     for (auto *f : qAsConst(_folderMap)) {
         if (!f) {
             continue;
@@ -911,13 +929,85 @@ void FolderMan::slotEtagPollTimerTimeout()
             continue;
         }
         if (f->dueToSync()) {
-            QMetaObject::invokeMethod(f, &Folder::slotRunEtagJob, Qt::QueuedConnection);
+            if (canCheckEtagWithDrives(f)) {
+                drivesFolders[f->accountState().data()].append(f);
+            } else {
+                QMetaObject::invokeMethod(f, &Folder::slotRunEtagJob, Qt::QueuedConnection);
+            }
+        }
+    }
+    for (auto it = drivesFolders.cbegin(); it != drivesFolders.cend(); ++it) {
+        checkEtagsWithDrives(it.key(), it.value());
+    }
+    updatePollTimers();
+}
+
+bool FolderMan::canCheckEtagWithDrives(Folder *f)
+{
+    // the drives listing only contains the etags of the space roots
+    return f->accountState()->account()->capabilities().spacesSupport().enabled && f->remotePath() == QLatin1String("/");
+}
+
+void FolderMan::checkEtagsWithDrives(AccountState *accountState, const QVector<QPointer<Folder>> &folders)
+{
+    const auto uuid = accountState->account()->uuid();
+    auto &job = _drivesEtagJobs[uuid];
+    if (job) {
+        // the folders are still due on the next poll
+        return;
+    }
+    auto drives = new GraphApi::Drives(accountState->account(), this);
+    job = drives;
+    connect(drives, &GraphApi::Drives::finishedSignal, this, [this, uuid, drives, folders] {
+        _drivesEtagJobs.remove(uuid);
+        QHash<QUrl, QByteArray> etags;
+        if (drives->reply()->error() == QNetworkReply::NoError && drives->parseError().error == QJsonParseError::NoError) {
+            for (const auto &drive : drives->drives()) {
+                const auto root = drive.getRoot();
+                etags.insert(QUrl::fromEncoded(root.getWebDavUrl().toUtf8()).adjusted(QUrl::StripTrailingSlash), Utility::normalizeEtag(root.getETag().toUtf8()));
+            }
+        } else {
+            qCWarning(lcFolderMan) << "Listing the drives failed, checking the etags of" << folders.size() << "folders one by one";
+        }
+        for (const auto &f : folders) {
+            if (f) {
+                // folders without an etag run the regular etag job
+                f->etagRetrievedFromDrives(etags.value(f->webDavUrl().adjusted(QUrl::StripTrailingSlash)));
+            }
+        }
+    });
+    drives->start();
+}
+
+void FolderMan::updatePollTimers()
+{
+    // not Folder::canSync(), there is no notification when the vfs becomes ready
+    const bool anyFolderCanSync = std::any_of(_folderMap.cbegin(), _folderMap.cend(), [](Folder *f) {
+        return f && !f->syncPaused() && f->accountState()->isConnected();
+    });
+    if (!anyFolderCanSync) {
+        if (_etagPollTimer.isActive()) {
+            qCInfo(lcFolderMan) << "No folder can sync, stopping the poll timers";
         }
+        _etagPollTimer.stop();
+        _timeScheduler.stop();
+        return;
+    }
+    if (!_etagPollTimer.isActive()) {
+        _etagPollTimer.start();
+    }
+    if (!_timeScheduler.isActive()) {
+        _timeScheduler.start();
     }
 }
 
 void FolderMan::slotRemoveFoldersForAccount(AccountStatePtr accountState)
 {
+    if (auto drives = _drivesEtagJobs.take(accountState->account()->uuid())) {
+        // the folders of the account are gone, don't run their etag jobs
+        disconnect(drives.data(), nullptr, this, nullptr);
+        drives->abort();
+    }
     QList<Folder *> foldersToRemove;
     // reserve a magic number
     foldersToRemove.reserve(16);
@@ -963,6 +1053,7 @@ void FolderMan::slotWatchedFileUnlocked(const QString &path)
 
 void FolderMan::slotScheduleFolderByTime()
 {
+    Metrics::instance()->incrementCounter(QStringLiteral("sync_timer_wakeups_total"), 1, { { QStringLiteral("timer"), QStringLiteral("schedule_by_time") } });
     for (const auto &f : qAsConst(_folderMap)) {
         // Never schedule if syncing is disabled or when we're currently
         // querying the server for etags
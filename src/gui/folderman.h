@@ -25,6 +25,7 @@
 #include "navigationpanehelper.h"
 #include "syncfileitem.h"
 
+class TestFolderMan;
 class TestFolderMigration;
 
 namespace OCC {
@@ -33,6 +34,10 @@ namespace TestUtils {
     FolderMan *folderMan();
 }
 
+namespace GraphApi {
+    class Drives;
+}
+
 class Application;
 class SyncResult;
 class SocketApi;
@@ -77,6 +82,8 @@ private:
  * - There was a sync error or a follow-up sync is requested
  *   (_timeScheduler and slotScheduleFolderByTime()
  *    and Folder::slotSyncFinished())
+ *
+ * While no folder can sync the timers are stopped, see updatePollTimers().
  */
 class FolderMan : public QObject
 {
@@ -344,6 +351,15 @@ private:
     /** Will start a sync after a bit of delay. */
     void startScheduledSyncSoon();
 
+    /** Runs _etagPollTimer and _timeScheduler only while a folder can sync */
+    void updatePollTimers();
+
+    /** Whether the etag of @a f can be checked with the drives listing of its account */
+    static bool canCheckEtagWithDrives(Folder *f);
+
+    /** Checks the etags of all @a folders of a spaces account with a single drives listing */
+    void checkEtagsWithDrives(AccountState *accountState, const QVector<QPointer<Folder>> &folders);
+
     // finds all folder configuration files
     // and create the folders
     QString getBackupName(QString fullPathName) const;
@@ -370,6 +386,8 @@ private:
     QTimer _etagPollTimer;
     /// The currently running etag query
     QPointer<RequestEtagJob> _currentEtagJob;
+    /// The running drives listings for the etag checks, by account uuid
+    QMap<QUuid, QPointer<GraphApi::Drives>> _drivesEtagJobs;
 
     /// Watches files that couldn't be synced due to locks
     QScopedPointer<LockWatcher> _lockWatcher;
@@ -396,6 +414,7 @@ private:
     explicit FolderMan(QObject *parent = nullptr);
     friend class OCC::Application;
     friend OCC::FolderMan *OCC::TestUtils::folderMan();
+    friend class ::TestFolderMan;
     friend class ::TestFolderMigration;
 };
 
@@ -31,6 +31,7 @@
 
 #include "configfile.h"
 #include "logger.h"
+#include "synctracer.h"
 #include "guiutility.h"
 #include "ui_logbrowser.h"
 
@@ -58,6 +59,15 @@ LogBrowser::LogBrowser(QWidget *parent)
         ConfigFile().setLogHttp(b);
     });
 
+    ui->syncTraceButton->setChecked(SyncTracer::instance()->isEnabled());
+    connect(ui->syncTraceButton, &QCheckBox::toggled, this, [](bool b) {
+        auto tracer = SyncTracer::instance();
+        if (b && tracer->outputDirectory().isEmpty()) {
+            tracer->setOutputDirectory(Logger::instance()->temporaryFolderLogDirPath());
+        }
+        tracer->setEnabled(b);
+    });
+
     ui->deleteLogsButton->setText(tr("Delete logs older than %1 hours").arg(QString::number(defaultExpireDuration.count())));
     ui->deleteLogsButton->setChecked(bool(ConfigFile().automaticDeleteOldLogsAge()));
     connect(ui->deleteLogsButton, &QCheckBox::toggled, this, &LogBrowser::toggleLogDeletion);
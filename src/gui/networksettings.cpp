@@ -206,8 +206,7 @@ void NetworkSettings::saveBWLimitSettings()
         cfgFile.setUseUploadLimit(-1);
     }
     cfgFile.setUploadLimit(_ui->uploadSpinBox->value());
-
-    FolderMan::instance()->setDirtyNetworkLimits();
+    // FolderMan is notified of the changes by the ConfigStore
 }
 
 void NetworkSettings::checkEmptyProxyHost()
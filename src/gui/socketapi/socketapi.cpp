@@ -32,6 +32,7 @@
 #include "folder.h"
 #include "folderman.h"
 #include "guiutility.h"
+#include "metrics.h"
 #include "sharemanager.h"
 #include "syncengine.h"
 #include "syncfileitem.h"
@@ -839,6 +840,12 @@ void SocketApi::command_V2_UPLOAD_FILES_FROM(const QSharedPointer<SocketApiJobV2
     uploadJob->start();
 }
 
+void SocketApi::command_V2_GET_METRICS(const QSharedPointer<SocketApiJobV2> &job) const
+{
+    job->success({ { QStringLiteral("format"), QStringLiteral("prometheus") },
+        { QStringLiteral("metrics"), QString::fromUtf8(Metrics::instance()->toPrometheusText()) } });
+}
+
 void SocketApi::command_V2_GET_CLIENT_ICON(const QSharedPointer<SocketApiJobV2> &job) const
 {
     OC_ASSERT(job);
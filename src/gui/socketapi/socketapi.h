@@ -125,6 +125,10 @@ private:
     Q_INVOKABLE void command_V2_LIST_ACCOUNTS(const QSharedPointer<SocketApiJobV2> &job) const;
     Q_INVOKABLE void command_V2_UPLOAD_FILES_FROM(const QSharedPointer<SocketApiJobV2> &job) const;
 
+    // Sends the sync metrics in the Prometheus text format in Json key "metrics"
+    // e.g. { "id" : "1", "arguments" : { "format" : "prometheus", "metrics" : "# HELP sync_runs_total ..." } }
+    Q_INVOKABLE void command_V2_GET_METRICS(const QSharedPointer<SocketApiJobV2> &job) const;
+
     // Sends the id and the client icon as PNG image (base64 encoded) in Json key "png"
     // e.g. { "id" : "1", "arguments" : { "png" : "hswehs343dj8..." } } or an error message in key "error"
     //
@@ -154,6 +154,8 @@ void SocketUploadJob::start()
 
     auto opt = engine->syncOptions();
     opt.setFilePattern(pattern);
+    // the remote folder is created below and therefore empty
+    opt._uploadOnly = true;
     if (!opt.fileRegex().isValid()) {
         fail(opt.fileRegex().errorString());
         return;
@@ -26,6 +26,7 @@
 #include "cookiejar.h"
 #include "accessmanager.h"
 #include "common/utility.h"
+#include "connectionbroker.h"
 #include "httplogger.h"
 
 namespace OCC {
@@ -78,7 +79,8 @@ QNetworkReply *AccessManager::createRequest(QNetworkAccessManager::Operation op,
         newRequest.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2EnabledEnv);
     }
 
-    const auto reply = QNetworkAccessManager::createRequest(op, newRequest, outgoingData);
+    const auto reply = _shareConnections ? ConnectionBroker::instance()->createRequest(this, op, newRequest, outgoingData)
+                                         : QNetworkAccessManager::createRequest(op, newRequest, outgoingData);
     HttpLogger::logRequest(reply, op, outgoingData);
     return reply;
 }
@@ -36,8 +36,19 @@ public:
 
     AccessManager(QObject *parent = nullptr);
 
+    /**
+     * Send the requests with the connections shared by the accounts on the same server.
+     *
+     * See ConnectionBroker. Default: false.
+     */
+    void setShareConnections(bool share) { _shareConnections = share; }
+    bool shareConnections() const { return _shareConnections; }
+
 protected:
     QNetworkReply *createRequest(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData = nullptr) override;
+
+private:
+    bool _shareConnections = false;
 };
 
 } // namespace OCC
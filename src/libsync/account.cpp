@@ -19,6 +19,8 @@
 #include "creds/abstractcredentials.h"
 #include "creds/credentialmanager.h"
 #include "capabilities.h"
+#include "configfile.h"
+#include "connectionbroker.h"
 #include "theme.h"
 #include "common/asserts.h"
 
@@ -169,6 +171,9 @@ void Account::setCredentials(AbstractCredentials *cred)
     if (jar) {
         _am->setCookieJar(jar);
     }
+    if (auto accessManager = qobject_cast<AccessManager *>(_am.data())) {
+        accessManager->setShareConnections(ConfigFile().shareConnections());
+    }
     connect(_am.data(), &QNetworkAccessManager::sslErrors,
         this, &Account::slotHandleSslErrors);
     connect(_am.data(), &QNetworkAccessManager::proxyAuthenticationRequired,
@@ -232,6 +237,9 @@ void Account::resetNetworkAccessManager()
     _am = QSharedPointer<QNetworkAccessManager>(_credentials->createQNAM(), &QObject::deleteLater);
 
     _am->setCookieJar(jar); // takes ownership of the old cookie jar
+    if (auto accessManager = qobject_cast<AccessManager *>(_am.data())) {
+        accessManager->setShareConnections(ConfigFile().shareConnections());
+    }
     connect(_am.data(), &QNetworkAccessManager::sslErrors, this,
         &Account::slotHandleSslErrors);
     connect(_am.data(), &QNetworkAccessManager::proxyAuthenticationRequired,
@@ -457,6 +465,7 @@ JobQueue *Account::jobQueue()
 void Account::clearQNAMCache()
 {
     _am->clearAccessCache();
+    ConnectionBroker::instance()->clearAccessCache(_am.data());
 }
 
 const Capabilities &Account::capabilities() const
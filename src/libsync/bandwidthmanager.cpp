@@ -17,6 +17,7 @@
 #include "propagateupload.h"
 #include "propagatorjobs.h"
 #include "common/utility.h"
+#include "metrics.h"
 
 #ifdef Q_OS_WIN
 #include <windef.h>
@@ -44,6 +45,13 @@ static qint64 relativeLimitMeasuringTimerIntervalMsec = 1000 * 2;
 //  * For relative limiting, do less measuring and more delaying+giving quota
 //  * For relative limiting, smoothen measurements
 
+namespace {
+void countWakeup(const QString &timer)
+{
+    Metrics::instance()->incrementCounter(QStringLiteral("sync_timer_wakeups_total"), 1, { { QStringLiteral("timer"), timer } });
+}
+}
+
 BandwidthManager::BandwidthManager(OwncloudPropagator *p)
     : QObject()
     , _propagator(p)
@@ -56,21 +64,18 @@ BandwidthManager::BandwidthManager(OwncloudPropagator *p)
     _currentUploadLimit = _propagator->_uploadLimit;
     _currentDownloadLimit = _propagator->_downloadLimit;
 
+    // The timers only run while transfers are registered, see updateTimers()
     QObject::connect(&_switchingTimer, &QTimer::timeout, this, &BandwidthManager::switchingTimerExpired);
     _switchingTimer.setInterval(10 * 1000);
-    _switchingTimer.start();
-    QMetaObject::invokeMethod(this, "switchingTimerExpired", Qt::QueuedConnection);
 
     // absolute uploads/downloads
     QObject::connect(&_absoluteLimitTimer, &QTimer::timeout, this, &BandwidthManager::absoluteLimitTimerExpired);
     _absoluteLimitTimer.setInterval(1000);
-    _absoluteLimitTimer.start();
 
     // Relative uploads
     QObject::connect(&_relativeUploadMeasuringTimer, &QTimer::timeout,
         this, &BandwidthManager::relativeUploadMeasuringTimerExpired);
     _relativeUploadMeasuringTimer.setInterval(relativeLimitMeasuringTimerIntervalMsec);
-    _relativeUploadMeasuringTimer.start();
     _relativeUploadMeasuringTimer.setSingleShot(true); // will be restarted from the delay timer
     QObject::connect(&_relativeUploadDelayTimer, &QTimer::timeout,
         this, &BandwidthManager::relativeUploadDelayTimerExpired);
@@ -80,7 +85,6 @@ BandwidthManager::BandwidthManager(OwncloudPropagator *p)
     QObject::connect(&_relativeDownloadMeasuringTimer, &QTimer::timeout,
         this, &BandwidthManager::relativeDownloadMeasuringTimerExpired);
     _relativeDownloadMeasuringTimer.setInterval(relativeLimitMeasuringTimerIntervalMsec);
-    _relativeDownloadMeasuringTimer.start();
     _relativeDownloadMeasuringTimer.setSingleShot(true); // will be restarted from the delay timer
     QObject::connect(&_relativeDownloadDelayTimer, &QTimer::timeout,
         this, &BandwidthManager::relativeDownloadDelayTimerExpired);
@@ -91,12 +95,65 @@ BandwidthManager::~BandwidthManager()
 {
 }
 
+bool BandwidthManager::hasTransfers() const
+{
+    return !_absoluteUploadDeviceList.empty() || !_downloadJobList.empty();
+}
+
+bool BandwidthManager::hasActiveTimers() const
+{
+    return _switchingTimer.isActive() || _absoluteLimitTimer.isActive()
+        || _relativeUploadMeasuringTimer.isActive() || _relativeUploadDelayTimer.isActive()
+        || _relativeDownloadMeasuringTimer.isActive() || _relativeDownloadDelayTimer.isActive();
+}
+
+void BandwidthManager::updateTimers()
+{
+    if (!hasTransfers()) {
+        // idle, nothing to limit
+        _switchingTimer.stop();
+        _absoluteLimitTimer.stop();
+        _relativeUploadMeasuringTimer.stop();
+        _relativeUploadDelayTimer.stop();
+        _relativeDownloadMeasuringTimer.stop();
+        _relativeDownloadDelayTimer.stop();
+        return;
+    }
+
+    if (!_switchingTimer.isActive()) {
+        _switchingTimer.start();
+    }
+
+    const bool needsAbsoluteTimer = (usingAbsoluteUploadLimit() && !_absoluteUploadDeviceList.empty())
+        || (usingAbsoluteDownloadLimit() && !_downloadJobList.empty());
+    if (!needsAbsoluteTimer) {
+        _absoluteLimitTimer.stop();
+    } else if (!_absoluteLimitTimer.isActive()) {
+        _absoluteLimitTimer.start();
+    }
+
+    // the relative cycles stop themselves when they are not needed anymore
+    if (usingRelativeUploadLimit() && !_relativeUploadDeviceList.empty()
+        && !_relativeUploadMeasuringTimer.isActive() && !_relativeUploadDelayTimer.isActive()) {
+        _relativeUploadMeasuringTimer.start();
+    }
+    if (usingRelativeDownloadLimit() && !_downloadJobList.empty()
+        && !_relativeDownloadMeasuringTimer.isActive() && !_relativeDownloadDelayTimer.isActive()) {
+        _relativeDownloadMeasuringTimer.start();
+    }
+}
+
 void BandwidthManager::registerUploadDevice(UploadDevice *p)
 {
     _absoluteUploadDeviceList.push_back(p);
     _relativeUploadDeviceList.push_back(p);
     QObject::connect(p, &QObject::destroyed, this, &BandwidthManager::unregisterUploadDevice);
 
+    // the limits are not polled while idle
+    if (!_switchingTimer.isActive()) {
+        updateLimits();
+    }
+
     if (usingAbsoluteUploadLimit()) {
         p->setBandwidthLimited(true);
         p->setChoked(false);
@@ -107,6 +164,7 @@ void BandwidthManager::registerUploadDevice(UploadDevice *p)
         p->setBandwidthLimited(false);
         p->setChoked(false);
     }
+    updateTimers();
 }
 
 void BandwidthManager::unregisterUploadDevice(QObject *o)
@@ -118,6 +176,7 @@ void BandwidthManager::unregisterUploadDevice(QObject *o)
         _relativeLimitCurrentMeasuredDevice = nullptr;
         _relativeUploadLimitProgressAtMeasuringRestart = 0;
     }
+    updateTimers();
 }
 
 void BandwidthManager::registerDownloadJob(GETJob *j)
@@ -125,6 +184,10 @@ void BandwidthManager::registerDownloadJob(GETJob *j)
     _downloadJobList.push_back(j);
     QObject::connect(j, &QObject::destroyed, this, &BandwidthManager::unregisterDownloadJob);
 
+    if (!_switchingTimer.isActive()) {
+        updateLimits();
+    }
+
     if (usingAbsoluteDownloadLimit()) {
         j->setBandwidthLimited(true);
         j->setChoked(false);
@@ -135,6 +198,7 @@ void BandwidthManager::registerDownloadJob(GETJob *j)
         j->setBandwidthLimited(false);
         j->setChoked(false);
     }
+    updateTimers();
 }
 
 void BandwidthManager::unregisterDownloadJob(QObject *o)
@@ -145,14 +209,14 @@ void BandwidthManager::unregisterDownloadJob(QObject *o)
         _relativeLimitCurrentMeasuredJob = nullptr;
         _relativeDownloadLimitProgressAtMeasuringRestart = 0;
     }
+    updateTimers();
 }
 
 void BandwidthManager::relativeUploadMeasuringTimerExpired()
 {
+    countWakeup(QStringLiteral("bandwidth_relative_upload"));
     if (!usingRelativeUploadLimit() || _relativeUploadDeviceList.empty()) {
-        // Not in this limiting mode, just wait 1 sec to continue the cycle
-        _relativeUploadDelayTimer.setInterval(1000);
-        _relativeUploadDelayTimer.start();
+        // Not in this limiting mode, stop the cycle, updateTimers() restarts it
         return;
     }
     if (_relativeLimitCurrentMeasuredDevice == nullptr) {
@@ -206,16 +270,13 @@ void BandwidthManager::relativeUploadMeasuringTimerExpired()
 
 void BandwidthManager::relativeUploadDelayTimerExpired()
 {
-    // Switch to measuring state
-    _relativeUploadMeasuringTimer.start(); // always start to continue the cycle
-
-    if (!usingRelativeUploadLimit()) {
-        return; // oh, not actually needed
+    countWakeup(QStringLiteral("bandwidth_relative_upload"));
+    if (!usingRelativeUploadLimit() || _relativeUploadDeviceList.empty()) {
+        return; // oh, not actually needed, updateTimers() restarts the cycle
     }
 
-    if (_relativeUploadDeviceList.empty()) {
-        return;
-    }
+    // Switch to measuring state
+    _relativeUploadMeasuringTimer.start();
 
     qCDebug(lcBandwidthManager) << _relativeUploadDeviceList.size() << "Starting measuring";
 
@@ -244,10 +305,9 @@ void BandwidthManager::relativeUploadDelayTimerExpired()
 // for downloads:
 void BandwidthManager::relativeDownloadMeasuringTimerExpired()
 {
+    countWakeup(QStringLiteral("bandwidth_relative_download"));
     if (!usingRelativeDownloadLimit() || _downloadJobList.empty()) {
-        // Not in this limiting mode, just wait 1 sec to continue the cycle
-        _relativeDownloadDelayTimer.setInterval(1000);
-        _relativeDownloadDelayTimer.start();
+        // Not in this limiting mode, stop the cycle, updateTimers() restarts it
         return;
     }
     if (_relativeLimitCurrentMeasuredJob == nullptr) {
@@ -301,17 +361,13 @@ void BandwidthManager::relativeDownloadMeasuringTimerExpired()
 
 void BandwidthManager::relativeDownloadDelayTimerExpired()
 {
-    // Switch to measuring state
-    _relativeDownloadMeasuringTimer.start(); // always start to continue the cycle
-
-    if (!usingRelativeDownloadLimit()) {
-        return; // oh, not actually needed
+    countWakeup(QStringLiteral("bandwidth_relative_download"));
+    if (!usingRelativeDownloadLimit() || _downloadJobList.empty()) {
+        return; // oh, not actually needed, updateTimers() restarts the cycle
     }
 
-    if (_downloadJobList.empty()) {
-        qCDebug(lcBandwidthManager) << _downloadJobList.size() << "No jobs?";
-        return;
-    }
+    // Switch to measuring state
+    _relativeDownloadMeasuringTimer.start();
 
     qCDebug(lcBandwidthManager) << _downloadJobList.size() << "Starting measuring";
 
@@ -338,6 +394,13 @@ void BandwidthManager::relativeDownloadDelayTimerExpired()
 // end downloads
 
 void BandwidthManager::switchingTimerExpired()
+{
+    countWakeup(QStringLiteral("bandwidth_switching"));
+    updateLimits();
+    updateTimers();
+}
+
+void BandwidthManager::updateLimits()
 {
     qint64 newUploadLimit = _propagator->_uploadLimit;
     if (newUploadLimit != _currentUploadLimit) {
@@ -377,6 +440,7 @@ void BandwidthManager::switchingTimerExpired()
 
 void BandwidthManager::absoluteLimitTimerExpired()
 {
+    countWakeup(QStringLiteral("bandwidth_absolute"));
     if (usingAbsoluteUploadLimit() && !_absoluteUploadDeviceList.empty()) {
         qint64 quotaPerDevice = _currentUploadLimit / _absoluteUploadDeviceList.size();
         qCDebug(lcBandwidthManager) << quotaPerDevice << _absoluteUploadDeviceList.size() << _currentUploadLimit;
@@ -43,6 +43,11 @@ public:
     bool usingAbsoluteDownloadLimit() { return _currentDownloadLimit > 0; }
     bool usingRelativeDownloadLimit() { return _currentDownloadLimit < 0; }
 
+    /// Whether any upload device or download job is registered, the timers only run while this is true
+    bool hasTransfers() const;
+    /// Whether any of the limiting timers runs
+    bool hasActiveTimers() const;
+
 
 public slots:
     void registerUploadDevice(UploadDevice *);
@@ -61,6 +66,11 @@ public slots:
     void relativeDownloadDelayTimerExpired();
 
 private:
+    /// Re-reads the limits of the propagator
+    void updateLimits();
+    /// Starts the timers needed for the registered transfers and the current limits, stops the others
+    void updateTimers();
+
     // for switching between absolute and relative bw limiting
     QTimer _switchingTimer;
 
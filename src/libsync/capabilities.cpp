@@ -28,6 +28,7 @@ Capabilities::Capabilities(const QVariantMap &capabilities)
     , _fileSharingPublicCapabilities(_fileSharingCapabilities.value(QStringLiteral("public"), {}).toMap())
     , _tusSupport(_capabilities.value(QStringLiteral("files")).toMap().value(QStringLiteral("tus_support")).toMap())
     , _spaces(_capabilities.value(QStringLiteral("spaces")).toMap())
+    , _archivers(_capabilities.value(QStringLiteral("files")).toMap().value(QStringLiteral("archivers")).toList())
 {
 }
 
@@ -191,6 +192,11 @@ const SpaceSupport &Capabilities::spacesSupport() const
     return _spaces;
 }
 
+const ArchiverSupport &Capabilities::archiverSupport() const
+{
+    return _archivers;
+}
+
 bool Capabilities::chunkingParallelUploadDisabled() const
 {
     return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("chunkingParallelUploadDisabled")).toBool();
@@ -280,5 +286,29 @@ bool SpaceSupport::isValid() const
     return !version.isNull();
 }
 
+ArchiverSupport::ArchiverSupport(const QVariantList &archivers)
+{
+    if (qEnvironmentVariableIsSet("OWNCLOUD_NO_ARCHIVER")) {
+        return;
+    }
+    for (const auto &a : archivers) {
+        const auto archiver = a.toMap();
+        if (!archiver.value(QStringLiteral("enabled")).toBool()
+            || !archiver.value(QStringLiteral("formats")).toStringList().contains(QLatin1String("tar"))) {
+            continue;
+        }
+        archiverUrl = archiver.value(QStringLiteral("archiver_url")).toString();
+        // the limits are sent as strings
+        maxNumFiles = archiver.value(QStringLiteral("max_num_files")).toInt();
+        maxSize = archiver.value(QStringLiteral("max_size")).toLongLong();
+        return;
+    }
+}
+
+bool ArchiverSupport::isValid() const
+{
+    return !archiverUrl.isEmpty();
+}
+
 
 } // namespace OCC
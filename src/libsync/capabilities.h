@@ -61,6 +61,30 @@ struct SpaceSupport
     bool isValid() const;
 };
 
+struct ArchiverSupport
+{
+    /**
+        "archivers": [
+          {
+            "enabled": true,
+            "version": "2.0.0",
+            "formats": ["tar", "zip"],
+            "archiver_url": "/archiver",
+            "max_num_files": "10000",
+            "max_size": "1073741824"
+          }
+        ]
+    */
+    ArchiverSupport(const QVariantList &archivers);
+    /// Relative to the server url, without a query
+    QString archiverUrl;
+    int maxNumFiles = 0;
+    qint64 maxSize = 0;
+
+    /// Whether there is an archiver that creates tar archives
+    bool isValid() const;
+};
+
 /**
  * @brief The Capabilities class represents the capabilities of an ownCloud
  * server
@@ -107,6 +131,7 @@ public:
 
     const TusSupport &tusSupport() const;
     const SpaceSupport &spacesSupport() const;
+    const ArchiverSupport &archiverSupport() const;
 
     /// disable parallel upload in chunking
     bool chunkingParallelUploadDisabled() const;
@@ -208,6 +233,7 @@ private:
     QVariantMap _fileSharingPublicCapabilities;
     TusSupport _tusSupport;
     SpaceSupport _spaces;
+    ArchiverSupport _archivers;
 };
 }
 
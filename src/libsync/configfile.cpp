@@ -18,6 +18,7 @@
 #include "common/utility.h"
 #include "common/version.h"
 #include "configfile.h"
+#include "configstore.h"
 #include "logger.h"
 #include "theme.h"
 
@@ -52,6 +53,8 @@ namespace  {
 const QString logHttpC() { return QStringLiteral("logHttp"); }
 const QString remotePollIntervalC() { return QStringLiteral("remotePollInterval"); }
 //const QString caCertsKeyC() { return QStringLiteral("CaCertificates"); } only used from account.cpp
+const QString remotePollBackoffC() { return QStringLiteral("remotePollBackoff"); }
+const QString shareConnectionsC() { return QStringLiteral("shareConnections"); }
 const QString forceSyncIntervalC() { return QStringLiteral("forceSyncInterval"); }
 const QString fullLocalDiscoveryIntervalC() { return QStringLiteral("fullLocalDiscoveryInterval"); }
 const QString notificationRefreshIntervalC() { return QStringLiteral("notificationRefreshInterval"); }
@@ -67,6 +70,7 @@ const QString uiLanguageC() { return QStringLiteral("uiLanguage"); }
 const QString geometryC() { return QStringLiteral("geometry"); }
 const QString timeoutC() { return QStringLiteral("timeout"); }
 const QString chunkSizeC() { return QStringLiteral("chunkSize"); }
+const QString memoryBudgetC() { return QStringLiteral("memoryBudget"); }
 const QString minChunkSizeC() { return QStringLiteral("minChunkSize"); }
 const QString maxChunkSizeC() { return QStringLiteral("maxChunkSize"); }
 const QString targetChunkUploadDurationC() { return QStringLiteral("targetChunkUploadDuration"); }
@@ -106,11 +110,6 @@ ConfigFile::ConfigFile()
 {
     QSettings::setDefaultFormat(QSettings::IniFormat);
 
-    const QString config = configFile();
-
-    QSettings settings(config, QSettings::IniFormat);
-    settings.beginGroup(defaultConnection());
-
     // run init only once
     static bool init = [this]() {
         setLogHttp(logHttp());
@@ -134,6 +133,7 @@ bool ConfigFile::setConfDir(const QString &value)
         dirPath = fi.absoluteFilePath();
         qCInfo(lcConfigFile) << "Using custom config dir " << dirPath;
         _confDir = dirPath;
+        ConfigStore::instance()->reset();
         return true;
     }
     return false;
@@ -158,35 +158,37 @@ void ConfigFile::setShowInExplorerNavigationPane(bool show)
     settings.sync();
 }
 
+// The values read for every sync run come from the ConfigStore
+
 std::chrono::seconds ConfigFile::timeout() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    const auto val = settings.value(timeoutC()).toInt(); // default to 5 min
+    const auto val = ConfigStore::instance()->value<int>(timeoutC(), 0); // default to 5 min
     return val ? std::chrono::seconds(val) : 5min;
 }
 
 qint64 ConfigFile::chunkSize() const
 {
-    auto settings = makeQSettings();
-    return settings.value(chunkSizeC(), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
+    return ConfigStore::instance()->value<qint64>(chunkSizeC(), 10 * 1000 * 1000); // default to 10 MB
 }
 
 qint64 ConfigFile::maxChunkSize() const
 {
-    auto settings = makeQSettings();
-    return settings.value(maxChunkSizeC(), 100 * 1000 * 1000).toLongLong(); // default to 100 MB
+    return ConfigStore::instance()->value<qint64>(maxChunkSizeC(), 100 * 1000 * 1000); // default to 100 MB
 }
 
 qint64 ConfigFile::minChunkSize() const
 {
-    auto settings = makeQSettings();
-    return settings.value(minChunkSizeC(), 1000 * 1000).toLongLong(); // default to 1 MB
+    return ConfigStore::instance()->value<qint64>(minChunkSizeC(), 1000 * 1000); // default to 1 MB
+}
+
+qint64 ConfigFile::memoryBudget() const
+{
+    return ConfigStore::instance()->value<qint64>(memoryBudgetC(), 0) * 1024 * 1024; // in MB, default to unlimited
 }
 
 chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
 {
-    auto settings = makeQSettings();
-    return millisecondsValue(settings, targetChunkUploadDurationC(), chrono::minutes(1));
+    return chrono::milliseconds(ConfigStore::instance()->value<qint64>(targetChunkUploadDurationC(), chrono::milliseconds(1min).count()));
 }
 
 void ConfigFile::setOptionalDesktopNotifications(bool show)
@@ -200,10 +202,8 @@ void ConfigFile::saveGeometry(QWidget *w)
 {
 #ifndef TOKEN_AUTH_ONLY
     OC_ASSERT(!w->objectName().isNull());
-    auto settings = makeQSettings();
-    settings.beginGroup(w->objectName());
-    settings.setValue(geometryC(), w->saveGeometry());
-    settings.sync();
+    // read with getValue(), so it goes through the ConfigStore
+    ConfigStore::instance()->setValue(w->objectName() + QLatin1Char('/') + geometryC(), w->saveGeometry());
 #endif
 }
 
@@ -360,6 +360,7 @@ QString ConfigFile::backup() const
     // already done. (two backup calls directly after each other, potentially
     // even with source alterations in between!)
     if (!QFile::exists(backupFile)) {
+        ConfigStore::instance()->sync();
         QFile f(baseFile);
         f.copy(backupFile);
     }
@@ -373,6 +374,8 @@ QString ConfigFile::configFile()
 
 QSettings ConfigFile::makeQSettings()
 {
+    // the settings have to see what was written through the store
+    ConfigStore::instance()->sync();
     return { configFile(), QSettings::IniFormat };
 }
 
@@ -389,29 +392,19 @@ QString ConfigFile::defaultConnection() const
 void ConfigFile::storeData(const QString &group, const QString &key, const QVariant &value)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    auto settings = makeQSettings();
-
-    settings.beginGroup(con);
-    settings.setValue(key, value);
-    settings.sync();
+    ConfigStore::instance()->setValue(con + QLatin1Char('/') + key, value);
 }
 
 void ConfigFile::removeData(const QString &group, const QString &key)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    auto settings = makeQSettings();
-
-    settings.beginGroup(con);
-    settings.remove(key);
+    ConfigStore::instance()->remove(con + QLatin1Char('/') + key);
 }
 
 bool ConfigFile::dataExists(const QString &group, const QString &key) const
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    auto settings = makeQSettings();
-
-    settings.beginGroup(con);
-    return settings.contains(key);
+    return ConfigStore::instance()->contains(con + QLatin1Char('/') + key);
 }
 
 chrono::milliseconds ConfigFile::remotePollInterval(std::chrono::seconds defaultVal, const QString &connection) const
@@ -457,6 +450,18 @@ void ConfigFile::setRemotePollInterval(chrono::milliseconds interval, const QStr
     settings.sync();
 }
 
+bool ConfigFile::remotePollBackoff() const
+{
+    // read after every etag poll
+    return ConfigStore::instance()->value<bool>(remotePollBackoffC(), true);
+}
+
+bool ConfigFile::shareConnections() const
+{
+    auto settings = makeQSettings();
+    return settings.value(shareConnectionsC(), false).toBool();
+}
+
 chrono::milliseconds ConfigFile::forceSyncInterval(std::chrono::seconds remoteFromCapabilities, const QString &connection) const
 {
     auto pollInterval = remotePollInterval(remoteFromCapabilities, connection);
@@ -538,11 +543,7 @@ void ConfigFile::setSkipUpdateCheck(bool skip, const QString &connection)
     if (connection.isEmpty())
         con = defaultConnection();
 
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
-
-    settings.setValue(skipUpdateCheckC(), QVariant(skip));
-    settings.sync();
+    ConfigStore::instance()->setValue(con + QLatin1Char('/') + skipUpdateCheckC(), QVariant(skip));
 }
 
 QString ConfigFile::updateChannel() const
@@ -585,58 +586,28 @@ void ConfigFile::setProxyType(int proxyType,
     const QString &user,
     const QString &pass)
 {
-    auto settings = makeQSettings();
-
-    settings.setValue(proxyTypeC(), proxyType);
+    setValue(proxyTypeC(), proxyType);
 
     if (proxyType == QNetworkProxy::HttpProxy || proxyType == QNetworkProxy::Socks5Proxy) {
-        settings.setValue(proxyHostC(), host);
-        settings.setValue(proxyPortC(), port);
-        settings.setValue(proxyNeedsAuthC(), needsAuth);
-        settings.setValue(proxyUserC(), user);
-        settings.setValue(proxyPassC(), pass.toUtf8().toBase64());
+        setValue(proxyHostC(), host);
+        setValue(proxyPortC(), port);
+        setValue(proxyNeedsAuthC(), needsAuth);
+        setValue(proxyUserC(), user);
+        setValue(proxyPassC(), pass.toUtf8().toBase64());
     }
-    settings.sync();
 }
 
 QVariant ConfigFile::getValue(const QString &param, const QString &group,
     const QVariant &defaultValue) const
 {
-    QVariant systemSetting;
-    if (Utility::isMac()) {
-        QSettings systemSettings(QStringLiteral("/Library/Preferences/" APPLICATION_REV_DOMAIN ".plist"), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else if (Utility::isUnix()) {
-        QSettings systemSettings(QStringLiteral(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->appName()), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else { // Windows
-        QSettings systemSettings(QStringLiteral("HKEY_LOCAL_MACHINE\\Software\\" APPLICATION_VENDOR "\\%1")
-                                     .arg(Theme::instance()->appNameGUI()),
-            QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    }
-
-    auto settings = makeQSettings();
-    if (!group.isEmpty())
-        settings.beginGroup(group);
-
-    return settings.value(param, systemSetting);
+    const QString key = group.isEmpty() ? param : group + QLatin1Char('/') + param;
+    auto store = ConfigStore::instance();
+    return store->value(key, store->systemValue(key, defaultValue));
 }
 
 void ConfigFile::setValue(const QString &key, const QVariant &value)
 {
-    auto settings = makeQSettings();
-
-    settings.setValue(key, value);
+    ConfigStore::instance()->setValue(key, value);
 }
 
 int ConfigFile::proxyType() const
@@ -860,6 +831,7 @@ void ConfigFile::setClientVersionString(const QString &version)
 
 std::unique_ptr<QSettings> ConfigFile::settingsWithGroup(const QString &group)
 {
+    ConfigStore::instance()->sync();
     auto settings = std::make_unique<QSettings>(ConfigFile::configFile(), QSettings::IniFormat);
     settings->beginGroup(group);
     return settings;
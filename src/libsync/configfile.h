@@ -68,6 +68,11 @@ public:
     std::chrono::milliseconds remotePollInterval(std::chrono::seconds defaultVal, const QString &connection = QString()) const;
     /* Set poll interval. Value in milliseconds has to be larger than 5000 */
     void setRemotePollInterval(std::chrono::milliseconds interval, const QString &connection = QString());
+    /* Whether the poll interval grows while the server reports no changes */
+    bool remotePollBackoff() const;
+
+    /* Whether the accounts on the same server share their connections, off by default */
+    bool shareConnections() const;
 
     /* Interval to check for new notifications */
     std::chrono::milliseconds notificationRefreshInterval(const QString &connection = QString()) const;
@@ -157,6 +162,9 @@ public:
     qint64 minChunkSize() const;
     std::chrono::milliseconds targetChunkUploadDuration() const;
 
+    /** Estimated memory the sync engine should stay below, in bytes. 0 means unlimited. */
+    qint64 memoryBudget() const;
+
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
 
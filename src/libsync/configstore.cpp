@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "config.h"
+
+#include "configstore.h"
+
+#include "common/utility.h"
+#include "configfile.h"
+#include "theme.h"
+
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QThread>
+
+#include <memory>
+
+using namespace std::chrono_literals;
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcConfigStore, "sync.configstore", QtInfoMsg)
+
+namespace {
+// Changes that come in together, like the ones of a settings dialog, are written at once
+constexpr auto syncDelay = 500ms;
+
+std::unique_ptr<QSettings> makeSystemSettings()
+{
+    if (Utility::isMac()) {
+        return std::make_unique<QSettings>(QStringLiteral("/Library/Preferences/" APPLICATION_REV_DOMAIN ".plist"), QSettings::NativeFormat);
+    } else if (Utility::isUnix()) {
+        return std::make_unique<QSettings>(QStringLiteral(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->appName()), QSettings::NativeFormat);
+    } else { // Windows
+        return std::make_unique<QSettings>(QStringLiteral("HKEY_LOCAL_MACHINE\\Software\\" APPLICATION_VENDOR "\\%1")
+                                               .arg(Theme::instance()->appNameGUI()),
+            QSettings::NativeFormat);
+    }
+}
+
+QHash<QString, QVariant> readAll(const QSettings &settings)
+{
+    QHash<QString, QVariant> values;
+    const auto keys = settings.allKeys();
+    values.reserve(keys.size());
+    for (const auto &key : keys) {
+        values.insert(key, settings.value(key));
+    }
+    return values;
+}
+}
+
+ConfigStore *ConfigStore::instance()
+{
+    static ConfigStore store;
+    return &store;
+}
+
+ConfigStore::ConfigStore()
+{
+    if (auto app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+    }
+    _syncTimer.setSingleShot(true);
+    _syncTimer.setInterval(syncDelay);
+    connect(&_syncTimer, &QTimer::timeout, this, &ConfigStore::sync);
+    // write the last changes while QSettings is still usable, not when the static store is destroyed
+    qAddPostRoutine([] { ConfigStore::instance()->sync(); });
+}
+
+void ConfigStore::load()
+{
+    if (_loaded) {
+        return;
+    }
+    _path = ConfigFile::configFile();
+    _values = readAll(QSettings(_path, QSettings::IniFormat));
+    _systemValues = readAll(*makeSystemSettings());
+    _loaded = true;
+    qCDebug(lcConfigStore) << "Loaded" << _values.size() << "values from" << _path << "and" << _systemValues.size() << "system values";
+}
+
+QVariant ConfigStore::value(const QString &key, const QVariant &defaultValue)
+{
+    QMutexLocker locker(&_mutex);
+    load();
+    return _values.value(key, defaultValue);
+}
+
+QVariant ConfigStore::systemValue(const QString &key, const QVariant &defaultValue)
+{
+    QMutexLocker locker(&_mutex);
+    load();
+    return _systemValues.value(key, defaultValue);
+}
+
+bool ConfigStore::contains(const QString &key)
+{
+    QMutexLocker locker(&_mutex);
+    load();
+    return _values.contains(key);
+}
+
+void ConfigStore::setValue(const QString &key, const QVariant &value)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        load();
+        auto it = _values.find(key);
+        if (it != _values.end() && *it == value) {
+            return;
+        }
+        _values.insert(key, value);
+        _removedKeys.remove(key);
+        _dirtyKeys.insert(key);
+        scheduleSync();
+    }
+    emit changed(key);
+}
+
+void ConfigStore::remove(const QString &key)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        load();
+        // like QSettings::remove(), this removes the group below the key as well
+        const QString prefix = key + QLatin1Char('/');
+        bool removed = false;
+        for (auto it = _values.begin(); it != _values.end();) {
+            if (it.key() == key || it.key().startsWith(prefix)) {
+                _dirtyKeys.remove(it.key());
+                it = _values.erase(it);
+                removed = true;
+            } else {
+                ++it;
+            }
+        }
+        _removedKeys.insert(key);
+        scheduleSync();
+        if (!removed) {
+            return;
+        }
+    }
+    emit changed(key);
+}
+
+void ConfigStore::scheduleSync()
+{
+    if (QThread::currentThread() == thread()) {
+        _syncTimer.start();
+    } else {
+        // the timer belongs to the main thread, write right away
+        syncLocked();
+    }
+}
+
+void ConfigStore::sync()
+{
+    QMutexLocker locker(&_mutex);
+    syncLocked();
+}
+
+void ConfigStore::syncLocked()
+{
+    if (_dirtyKeys.isEmpty() && _removedKeys.isEmpty()) {
+        return;
+    }
+    if (QThread::currentThread() == thread()) {
+        _syncTimer.stop();
+    }
+
+    QSettings settings(_path, QSettings::IniFormat);
+    for (const auto &key : qAsConst(_removedKeys)) {
+        settings.remove(key);
+    }
+    for (const auto &key : qAsConst(_dirtyKeys)) {
+        settings.setValue(key, _values.value(key));
+    }
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qCWarning(lcConfigStore) << "Failed to write" << _path << settings.status();
+    }
+    _removedKeys.clear();
+    _dirtyKeys.clear();
+}
+
+void ConfigStore::reset()
+{
+    QMutexLocker locker(&_mutex);
+    syncLocked();
+    _loaded = false;
+    _values.clear();
+    _systemValues.clear();
+}
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QVariant>
+
+namespace OCC {
+
+/**
+ * @brief Process wide cache of the values in the config file
+ *
+ * Every QSettings on the config file stats and, if needed, parses the file
+ * again. The store reads the user config file and the system settings once
+ * and answers from memory, ConfigFile reads its values through it.
+ *
+ * Writes update the cache right away and are written back to the file in
+ * batches, shortly after the last change. ConfigFile::makeQSettings() writes
+ * the pending values first, so code that still uses its own QSettings sees
+ * them. Values written with such a QSettings are not seen by the store: keys
+ * read through the store have to be written through it as well.
+ *
+ * Keys are full paths, like "BWLimit/uploadLimit".
+ *
+ * All methods are thread safe.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT ConfigStore : public QObject
+{
+    Q_OBJECT
+public:
+    static ConfigStore *instance();
+
+    /// The value in the user config file
+    QVariant value(const QString &key, const QVariant &defaultValue = {});
+    template <typename T>
+    T value(const QString &key, const T &defaultValue)
+    {
+        return value(key, QVariant::fromValue(defaultValue)).template value<T>();
+    }
+
+    /// The value set by the system administrator
+    QVariant systemValue(const QString &key, const QVariant &defaultValue = {});
+
+    bool contains(const QString &key);
+
+    void setValue(const QString &key, const QVariant &value);
+    void remove(const QString &key);
+
+    /// Writes the pending changes to the config file
+    void sync();
+
+    /// Writes the pending changes and reads the files again on the next access, used when the config dir changes
+    void reset();
+
+Q_SIGNALS:
+    /// Emitted in the thread of the change, after the cache was updated
+    void changed(const QString &key);
+
+private:
+    ConfigStore();
+
+    // all of them expect _mutex to be locked
+    void load();
+    void scheduleSync();
+    void syncLocked();
+
+    QMutex _mutex;
+    bool _loaded = false;
+    QString _path;
+    QHash<QString, QVariant> _values;
+    QHash<QString, QVariant> _systemValues;
+
+    QSet<QString> _dirtyKeys;
+    QSet<QString> _removedKeys;
+    QTimer _syncTimer;
+};
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "connectionbroker.h"
+
+#include "metrics.h"
+
+#include <QAuthenticator>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QLoggingCategory>
+#include <QNetworkConfiguration>
+#include <QNetworkCookie>
+#include <QNetworkCookieJar>
+#include <QNetworkProxy>
+#include <QNetworkReply>
+#include <QSslCertificate>
+#include <QSslConfiguration>
+
+#include <algorithm>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcConnectionBroker, "sync.connectionbroker", QtInfoMsg)
+
+namespace {
+QString originOf(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemoveUserInfo | QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment).toString();
+}
+}
+
+ConnectionBroker *ConnectionBroker::instance()
+{
+    // parented to the application, the shared managers must not outlive it
+    static QPointer<ConnectionBroker> broker;
+    if (!broker) {
+        broker = new ConnectionBroker(QCoreApplication::instance());
+    }
+    return broker;
+}
+
+ConnectionBroker::ConnectionBroker(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QString ConnectionBroker::poolKey(const QNetworkRequest &request, const QNetworkProxy &proxy)
+{
+    QString key = originOf(request.url());
+    if (proxy.type() != QNetworkProxy::DefaultProxy && proxy.type() != QNetworkProxy::NoProxy) {
+        key += QStringLiteral(" proxy:%1:%2@%3:%4").arg(QString::number(proxy.type()), proxy.user(), proxy.hostName(), QString::number(proxy.port()));
+    } else if (proxy.type() == QNetworkProxy::NoProxy) {
+        key += QStringLiteral(" noproxy");
+    }
+    const auto certificate = request.sslConfiguration().localCertificate();
+    if (!certificate.isNull()) {
+        key += QStringLiteral(" cert:") + QString::fromLatin1(certificate.digest(QCryptographicHash::Sha256).toHex());
+    }
+    return key;
+}
+
+ConnectionBroker::Pool &ConnectionBroker::pool(const QString &key, const QString &origin, QNetworkAccessManager *owner)
+{
+    auto it = _pools.find(key);
+    if (it == _pools.end()) {
+        qCInfo(lcConnectionBroker) << "New connection pool for" << origin;
+        it = _pools.insert(key, Pool());
+        it->origin = origin;
+        it->manager = new QNetworkAccessManager(this);
+#ifndef Q_OS_LINUX
+        // Same workaround as in AccessManager
+        it->manager->setConfiguration(QNetworkConfiguration());
+#endif
+        it->manager->setProxy(owner->proxy());
+
+        auto manager = it->manager;
+        connect(manager, &QNetworkAccessManager::authenticationRequired, this, [this](QNetworkReply *reply, QAuthenticator *authenticator) {
+            if (auto owner = _owners.value(reply)) {
+                emit owner->authenticationRequired(reply, authenticator);
+            }
+        });
+        connect(manager, &QNetworkAccessManager::proxyAuthenticationRequired, this, [this, key](const QNetworkProxy &proxy, QAuthenticator *authenticator) {
+            // all owners of the pool use the same proxy, one of them answers
+            const auto pool = _pools.constFind(key);
+            if (pool == _pools.cend()) {
+                return;
+            }
+            for (const auto &owner : pool->owners) {
+                if (owner) {
+                    emit owner->proxyAuthenticationRequired(proxy, authenticator);
+                    return;
+                }
+            }
+        });
+    }
+    if (!it->owners.contains(owner)) {
+        it->owners.append(owner);
+        connect(owner, &QObject::destroyed, this, [this, key] { removeDestroyedOwners(key); });
+        Metrics::instance()->setGauge(QStringLiteral("network_shared_pool_managers"), it->owners.size(), { { QStringLiteral("origin"), it->origin } });
+    }
+    return *it;
+}
+
+void ConnectionBroker::abortOrphanedReplies()
+{
+    // A manager that goes away takes its replies with it, the shared one must do the same
+    QList<QNetworkReply *> orphaned;
+    for (auto it = _owners.begin(); it != _owners.end();) {
+        if (it.value().isNull()) {
+            orphaned.append(it.key());
+            it = _owners.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto reply : qAsConst(orphaned)) {
+        qCInfo(lcConnectionBroker) << "Aborting the request of a removed access manager" << reply->url();
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+void ConnectionBroker::removeDestroyedOwners(const QString &key)
+{
+    abortOrphanedReplies();
+
+    auto it = _pools.find(key);
+    if (it == _pools.end()) {
+        return;
+    }
+    auto &owners = it->owners;
+    owners.erase(std::remove_if(owners.begin(), owners.end(), [](const QPointer<QNetworkAccessManager> &owner) { return owner.isNull(); }), owners.end());
+    Metrics::instance()->setGauge(QStringLiteral("network_shared_pool_managers"), owners.size(), { { QStringLiteral("origin"), it->origin } });
+    if (owners.isEmpty()) {
+        qCInfo(lcConnectionBroker) << "Removing the connection pool for" << it->origin;
+        it->manager->deleteLater();
+        _pools.erase(it);
+    }
+}
+
+QNetworkReply *ConnectionBroker::createRequest(QNetworkAccessManager *owner, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
+{
+    const QString key = poolKey(request, owner->proxy());
+    auto &pool = this->pool(key, originOf(request.url()), owner);
+
+    // The cookies belong to the account, not to the shared manager
+    QNetworkRequest req(request);
+    req.setAttribute(QNetworkRequest::CookieLoadControlAttribute, QNetworkRequest::Manual);
+    req.setAttribute(QNetworkRequest::CookieSaveControlAttribute, QNetworkRequest::Manual);
+    if (auto jar = owner->cookieJar()) {
+        const auto cookies = jar->cookiesForUrl(req.url());
+        if (!cookies.isEmpty()) {
+            req.setHeader(QNetworkRequest::CookieHeader, QVariant::fromValue(cookies));
+        }
+    }
+
+    QNetworkReply *reply = nullptr;
+    switch (op) {
+    case QNetworkAccessManager::HeadOperation:
+        reply = pool.manager->head(req);
+        break;
+    case QNetworkAccessManager::GetOperation:
+        reply = pool.manager->get(req);
+        break;
+    case QNetworkAccessManager::PutOperation:
+        reply = pool.manager->put(req, outgoingData);
+        break;
+    case QNetworkAccessManager::PostOperation:
+        reply = pool.manager->post(req, outgoingData);
+        break;
+    case QNetworkAccessManager::DeleteOperation:
+        reply = pool.manager->deleteResource(req);
+        break;
+    case QNetworkAccessManager::CustomOperation:
+    case QNetworkAccessManager::UnknownOperation:
+        reply = pool.manager->sendCustomRequest(req, req.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray(), outgoingData);
+        break;
+    }
+
+    ++pool.requests;
+    ++pool.activeRequests;
+    Metrics::instance()->incrementCounter(QStringLiteral("network_shared_pool_requests_total"), 1, { { QStringLiteral("origin"), pool.origin } });
+
+    _owners.insert(reply, owner);
+    connect(reply, &QNetworkReply::sslErrors, owner, [owner, reply](const QList<QSslError> &errors) {
+        emit owner->sslErrors(reply, errors);
+    });
+    connect(reply, &QNetworkReply::metaDataChanged, owner, [owner, reply] {
+        const auto cookies = reply->header(QNetworkRequest::SetCookieHeader).value<QList<QNetworkCookie>>();
+        if (!cookies.isEmpty() && owner->cookieJar()) {
+            owner->cookieJar()->setCookiesFromUrl(cookies, reply->url());
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, key] {
+        auto it = _pools.find(key);
+        if (it != _pools.end()) {
+            --it->activeRequests;
+        }
+    });
+    connect(reply, &QObject::destroyed, this, [this, reply] {
+        _owners.remove(reply);
+    });
+    return reply;
+}
+
+void ConnectionBroker::clearAccessCache(QNetworkAccessManager *owner)
+{
+    for (auto &pool : _pools) {
+        if (pool.owners.contains(owner)) {
+            pool.manager->clearAccessCache();
+        }
+    }
+}
+
+QVector<ConnectionBroker::PoolStatistics> ConnectionBroker::statistics() const
+{
+    QVector<PoolStatistics> result;
+    for (const auto &pool : _pools) {
+        PoolStatistics statistics;
+        statistics.origin = pool.origin;
+        statistics.managers = static_cast<int>(std::count_if(pool.owners.cbegin(), pool.owners.cend(), [](const auto &owner) { return !owner.isNull(); }));
+        statistics.requests = pool.requests;
+        statistics.activeRequests = pool.activeRequests;
+        result.append(statistics);
+    }
+    return result;
+}
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QMap>
+#include <QNetworkAccessManager>
+#include <QPointer>
+#include <QVector>
+
+namespace OCC {
+
+/**
+ * @brief Shares the connections of the accounts on the same server
+ *
+ * Qt keeps the connection cache in the QNetworkAccessManager, every account
+ * has its own TCP connections and TLS sessions. An AccessManager that shares
+ * its connections hands its requests to a manager owned by the broker, one
+ * per origin.
+ *
+ * What belongs to an account stays with its AccessManager: the credentials
+ * are added before the request gets here, the cookies are loaded from and
+ * stored to its cookie jar and the ssl errors and authentication requests
+ * are forwarded to it. The pools are separated by proxy and client
+ * certificate as well, a connection is never reused with another identity.
+ * The running replies of an AccessManager are aborted when it is destroyed,
+ * like those of an unshared one.
+ *
+ * The broker is owned by the application, the shared managers are destroyed
+ * before it.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT ConnectionBroker : public QObject
+{
+    Q_OBJECT
+public:
+    struct PoolStatistics
+    {
+        QString origin;
+        /// The access managers that sent requests with the pool
+        int managers = 0;
+        qint64 requests = 0;
+        int activeRequests = 0;
+    };
+
+    static ConnectionBroker *instance();
+
+    /// Requests with the same key are sent with the same pool
+    static QString poolKey(const QNetworkRequest &request, const QNetworkProxy &proxy);
+
+    /// Sends @a request for @a owner with the shared manager of its pool
+    QNetworkReply *createRequest(QNetworkAccessManager *owner, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData);
+
+    /// Closes the idle connections of the pools @a owner used
+    void clearAccessCache(QNetworkAccessManager *owner);
+
+    QVector<PoolStatistics> statistics() const;
+
+private:
+    struct Pool
+    {
+        QNetworkAccessManager *manager = nullptr;
+        QString origin;
+        QVector<QPointer<QNetworkAccessManager>> owners;
+        qint64 requests = 0;
+        int activeRequests = 0;
+    };
+
+    explicit ConnectionBroker(QObject *parent);
+
+    Pool &pool(const QString &key, const QString &origin, QNetworkAccessManager *owner);
+    void abortOrphanedReplies();
+    void removeDestroyedOwners(const QString &key);
+
+    QMap<QString, Pool> _pools;
+    /// The access manager each running reply was sent for
+    QHash<QNetworkReply *, QPointer<QNetworkAccessManager>> _owners;
+};
+}
@@ -13,19 +13,23 @@
  */
 
 #include "discovery.h"
+#include "account.h"
 #include "common/checksums.h"
 #include "common/syncjournaldb.h"
 #include "csync.h"
 #include "csync_exclude.h"
+#include "metrics.h"
 #include "owncloudpropagator.h"
 #include "syncengine.h"
 #include "syncfileitem.h"
+#include "syncrecorder.h"
 #include "vio/csync_vio_local.h"
 
 #include <algorithm>
 #include <set>
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QTextCodec>
@@ -35,9 +39,18 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcDisco, "sync.discovery", QtInfoMsg)
 
+namespace {
+    void countListing(const QString &source, bool success)
+    {
+        Metrics::instance()->incrementCounter(QStringLiteral("sync_discovery_listings_total"), 1,
+            { { QStringLiteral("source"), source }, { QStringLiteral("result"), success ? QStringLiteral("success") : QStringLiteral("error") } });
+    }
+}
+
 void ProcessDirectoryJob::start()
 {
     qCInfo(lcDisco) << "STARTING" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
+    _traceSpan = SyncTracer::instance()->begin("discovery", QStringLiteral("ProcessDirectoryJob"), _discoveryData->_localDir, _currentFolder._original);
 
     if (_queryServer == NormalQuery) {
         _serverJob = startAsyncServerQuery();
@@ -80,6 +93,10 @@ void ProcessDirectoryJob::process()
         RemoteInfo serverEntry;
         LocalInfo localEntry;
     };
+    // the listings are dropped at the end of this function
+    const auto serverEntriesMemory = std::move(_serverEntriesMemory);
+    const auto localEntriesMemory = std::move(_localEntriesMemory);
+
     std::map<QString, Entries> entries;
     for (auto &e : _serverNormalQueryEntries) {
         entries[e.name].serverEntry = std::move(e);
@@ -335,6 +352,12 @@ void ProcessDirectoryJob::processFile(PathTuple path,
         return; // Ignore this.
     }
 
+    if (isUnchangedFile(path, localEntry, serverEntry, dbEntry)) {
+        // Would end up as CSYNC_INSTRUCTION_NONE, which the engine only counts
+        ++_discoveryData->_unchangedFiles;
+        return;
+    }
+
     auto item = SyncFileItem::fromSyncJournalFileRecord(dbEntry);
     item->_file = path._target;
     item->_originalFile = path._original;
@@ -374,6 +397,44 @@ void ProcessDirectoryJob::processFile(PathTuple path,
     processFileAnalyzeLocalInfo(item, path, localEntry, serverEntry, dbEntry, _queryServer);
 }
 
+bool ProcessDirectoryJob::isUnchangedFile(const PathTuple &path, const LocalInfo &localEntry,
+    const RemoteInfo &serverEntry, const SyncJournalFileRecord &dbEntry) const
+{
+    // The special cases are left to the full analysis: directories, placeholders and
+    // pending (de)hydrations, files below renamed directories and conflict files.
+    if (!dbEntry.isValid() || dbEntry._type != ItemTypeFile
+        || path._original != path._target
+        || _discoveryData->_syncOptions._vfs->mode() == Vfs::WindowsCfApi
+        || Utility::isConflictFile(path._original)) {
+        return false;
+    }
+
+    if (serverEntry.isValid()) {
+        if (serverEntry.isDirectory
+            || serverEntry.size == -1
+            || serverEntry.remotePerm.isNull()
+            || serverEntry.etag.isEmpty()
+            || serverEntry.fileId.isEmpty()
+            || serverEntry.etag != dbEntry._etag
+            || serverEntry.remotePerm != dbEntry._remotePerm
+            || serverEntry.fileId != dbEntry._fileId) {
+            return false;
+        }
+    } else if (_queryServer != ParentNotChanged) {
+        return false;
+    }
+
+    if (localEntry.isValid()) {
+        return localEntry.type == ItemTypeFile
+            && !localEntry.isDirectory
+            && !localEntry.isVirtualFile
+            && localEntry.modtime == dbEntry._modtime
+            && localEntry.size == dbEntry._fileSize
+            && localEntry.inode == dbEntry._inode;
+    }
+    return _queryLocal == ParentNotChanged;
+}
+
 // Compute the checksum of the given file and assign the result in item->_checksumHeader
 // Returns true if the checksum was successfully computed
 static bool computeLocalChecksum(const QByteArray &header, const QString &path, const SyncFileItemPtr &item)
@@ -1113,10 +1174,12 @@ void ProcessDirectoryJob::processFileFinalize(
         }
     }
 
-    if (path._original != path._target && (item->_instruction == CSYNC_INSTRUCTION_UPDATE_METADATA || item->_instruction == CSYNC_INSTRUCTION_NONE)) {
+    // The records of unchanged files below a renamed directory are moved along with it,
+    // see PropagateDirectory::slotSubJobsFinished. Directories and files with metadata
+    // changes still need their own items.
+    if (path._original != path._target
+        && (item->_instruction == CSYNC_INSTRUCTION_UPDATE_METADATA || (item->_instruction == CSYNC_INSTRUCTION_NONE && item->isDirectory()))) {
         OC_ASSERT(_dirItem && _dirItem->_instruction == CSYNC_INSTRUCTION_RENAME);
-        // This is because otherwise subitems are not updated!  (ideally renaming a directory could
-        // update the database for all items!  See PropagateDirectory::slotSubJobsFinished)
         item->_instruction = CSYNC_INSTRUCTION_RENAME;
         item->_renameTarget = path._target;
         item->_direction = _dirItem->_direction;
@@ -1148,10 +1211,41 @@ void ProcessDirectoryJob::processFileFinalize(
             || (item->_type == ItemTypeVirtualFile && item->_instruction == CSYNC_INSTRUCTION_NEW)) {
             _discoveryData->_deletedItem[path._original] = item;
         }
+        if (_discoveryData->_syncOptions._uploadOnly && item->_instruction == CSYNC_INSTRUCTION_NEW && item->_direction == SyncFileItem::Up) {
+            computeUploadChecksum(item);
+            return;
+        }
         emit _discoveryData->itemDiscovered(item);
     }
 }
 
+void ProcessDirectoryJob::computeUploadChecksum(const SyncFileItemPtr &item)
+{
+    const QByteArray checksumType = _discoveryData->_account->capabilities().preferredUploadChecksumType();
+    if (checksumType.isEmpty()) {
+        emit _discoveryData->itemDiscovered(item);
+        return;
+    }
+
+    // The propagator reuses the checksum if the file did not change until the upload
+    _pendingAsyncJobs++;
+    auto computeChecksum = new ComputeChecksum(this);
+    computeChecksum->setChecksumType(checksumType);
+    computeChecksum->setBackgroundPriority(_discoveryData->_syncOptions._backgroundPriority);
+    // the upload reads the file again much later
+    computeChecksum->setReleasePageCache(_discoveryData->_syncOptions.releasePageCache(item->_size));
+    connect(computeChecksum, &ComputeChecksum::done, this, [this, item](const QByteArray &type, const QByteArray &checksum) {
+        if (!checksum.isEmpty()) {
+            item->_checksumHeader = makeChecksumHeader(type, checksum);
+        }
+        emit _discoveryData->itemDiscovered(item);
+        _pendingAsyncJobs--;
+        QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
+    });
+    connect(computeChecksum, &ComputeChecksum::done, computeChecksum, &QObject::deleteLater);
+    computeChecksum->start(_discoveryData->_localDir + item->_file);
+}
+
 void ProcessDirectoryJob::processBlacklisted(const PathTuple &path, const OCC::LocalInfo &localEntry,
     const SyncJournalFileRecord &dbEntry)
 {
@@ -1343,6 +1437,7 @@ int ProcessDirectoryJob::processSubJobs(int nbJobs)
                 _dirItem->_instruction = CSYNC_INSTRUCTION_NONE;
             }
         }
+        _traceSpan.end();
         emit finished();
     }
 
@@ -1398,11 +1493,23 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
     connect(serverJob, &DiscoverySingleDirectoryJob::etag, this, &ProcessDirectoryJob::etag);
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
-    connect(serverJob, &DiscoverySingleDirectoryJob::finished, this, [this, serverJob](const auto &results) {
+    QElapsedTimer queryTimer;
+    queryTimer.start();
+    SyncTracer::endOn(SyncTracer::instance()->begin("discovery", QStringLiteral("DiscoverySingleDirectoryJob"), _discoveryData->_localDir, _currentFolder._server),
+        serverJob, this, &DiscoverySingleDirectoryJob::finished);
+    connect(serverJob, &DiscoverySingleDirectoryJob::finished, this, [this, serverJob, queryTimer](const auto &results) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
+        countListing(QStringLiteral("remote"), static_cast<bool>(results));
+        if (_discoveryData->_syncRecorder) {
+            _discoveryData->_syncRecorder->recordRemoteListing(_currentFolder._server, results ? *results : QVector<RemoteInfo>(),
+                results ? 207 : results.error().code, std::chrono::milliseconds(queryTimer.elapsed()));
+        }
         if (results) {
             _serverNormalQueryEntries = *results;
+            for (const auto &entry : qAsConst(_serverNormalQueryEntries)) {
+                _serverEntriesMemory.add(MemoryBudget::estimatedSize(entry));
+            }
             _serverQueryDone = true;
             if (!serverJob->_dataFingerprint.isEmpty() && _discoveryData->_dataFingerprint.isEmpty())
                 _discoveryData->_dataFingerprint = serverJob->_dataFingerprint;
@@ -1443,6 +1550,11 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
 
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
+    QElapsedTimer queryTimer;
+    queryTimer.start();
+    SyncTracer::endOn(SyncTracer::instance()->begin("discovery", QStringLiteral("DiscoverySingleLocalDirectoryJob"), _discoveryData->_localDir, _currentFolder._local),
+        localJob, this, &DiscoverySingleLocalDirectoryJob::finished, &DiscoverySingleLocalDirectoryJob::finishedFatalError,
+        &DiscoverySingleLocalDirectoryJob::finishedNonFatalError);
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::itemDiscovered, _discoveryData, &DiscoveryPhase::itemDiscovered);
 
@@ -1453,6 +1565,7 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this, [this](const QString &msg) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
+        countListing(QStringLiteral("local"), false);
         if (_serverJob)
             _serverJob->abort();
 
@@ -1462,6 +1575,7 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this, [this](const QString &msg) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
+        countListing(QStringLiteral("local"), false);
 
         if (_dirItem) {
             _dirItem->_instruction = CSYNC_INSTRUCTION_IGNORE;
@@ -1473,11 +1587,18 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
         }
     });
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this](const auto &results) {
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this, queryTimer](const auto &results) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
+        countListing(QStringLiteral("local"), true);
+        if (_discoveryData->_syncRecorder) {
+            _discoveryData->_syncRecorder->recordLocalListing(_currentFolder._local, results, std::chrono::milliseconds(queryTimer.elapsed()));
+        }
 
         _localNormalQueryEntries = results;
+        for (const auto &entry : results) {
+            _localEntriesMemory.add(MemoryBudget::estimatedSize(entry));
+        }
         _localQueryDone = true;
 
         if (_serverQueryDone)
@@ -1485,6 +1606,10 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     });
 
     QThreadPool *pool = QThreadPool::globalInstance();
+    if (_discoveryData->_syncOptions._backgroundPriority) {
+        localJob->setBackgroundPriority(true);
+        pool = Utility::backgroundThreadPool();
+    }
     pool->start(localJob); // QThreadPool takes ownership
 }
 
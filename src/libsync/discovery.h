@@ -16,7 +16,9 @@
 
 #include <QObject>
 #include "discoveryphase.h"
+#include "memorybudget.h"
 #include "syncfileitem.h"
+#include "synctracer.h"
 #include "common/asserts.h"
 #include "common/syncjournaldb.h"
 
@@ -68,6 +70,10 @@ public:
         , _discoveryData(data)
     {
         computePinState(basePinState);
+        if (data->_syncOptions._uploadOnly) {
+            _queryServer = ParentDontExist;
+        }
+        _jobMemory.add(sizeof(ProcessDirectoryJob));
     }
 
     /// For creating subjobs
@@ -82,6 +88,7 @@ public:
         , _currentFolder(path)
     {
         computePinState(parent->_pinState);
+        _jobMemory.add(sizeof(ProcessDirectoryJob) + _currentFolder._original.size() * sizeof(QChar));
     }
 
     void start();
@@ -152,6 +159,13 @@ private:
      */
     void processFile(PathTuple, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &);
 
+    /** Whether the file is up to date locally and on the server, without a metadata update.
+     *
+     * Compares the plain values, so that processFile() doesn't need to create an item
+     * for the many unchanged files of a sync.
+     */
+    bool isUnchangedFile(const PathTuple &, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &) const;
+
     /// processFile helper for when remote information is available, typically flows into AnalyzeLocalInfo when done
     void processFileAnalyzeRemoteInfo(const SyncFileItemPtr &item, PathTuple, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &);
 
@@ -164,6 +178,8 @@ private:
     /// processFile helper for common final processing
     void processFileFinalize(const SyncFileItemPtr &item, PathTuple, bool recurse, QueryMode recurseQueryLocal, QueryMode recurseQueryServer);
 
+    /// In upload only mode: compute the content checksum of a new file, then emit itemDiscovered
+    void computeUploadChecksum(const SyncFileItemPtr &item);
 
     /** Checks the permission for this item, if needed, change the item to a restoration item.
      * @return false indicate that this is an error and if it is a directory, one should not recurse
@@ -238,6 +254,8 @@ private:
     // Holds entries that resulted from a NormalQuery
     QVector<RemoteInfo> _serverNormalQueryEntries;
     QVector<LocalInfo> _localNormalQueryEntries;
+    MemoryBudget::Reservation _serverEntriesMemory { MemoryBudget::Component::RemoteListings };
+    MemoryBudget::Reservation _localEntriesMemory { MemoryBudget::Component::LocalListings };
 
     // Whether the local/remote directory item queries are done. Will be set
     // even even for do-nothing (!= NormalQuery) queries.
@@ -247,6 +265,12 @@ private:
     RemotePermissions _rootPermissions;
     QPointer<DiscoverySingleDirectoryJob> _serverJob;
 
+    /// Covers the job including its sub directories, ends when the job is destroyed at the latest
+    SyncTracer::Span _traceSpan;
+
+    // The job itself, queued jobs are kept until their parent starts them
+    MemoryBudget::Reservation _jobMemory { MemoryBudget::Component::DirectoryJobs };
+
 
     /** Number of currently running async jobs.
      *
@@ -18,6 +18,9 @@
 #include "account.h"
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "memorybudget.h"
+#include "metrics.h"
+#include "synctracer.h"
 
 #include <csync_exclude.h>
 #include "vio/csync_vio_local.h"
@@ -241,9 +244,15 @@ void DiscoveryPhase::setSelectiveSyncWhiteList(const QStringList &list)
 void DiscoveryPhase::scheduleMoreJobs()
 {
     auto limit = qMax(1, _syncOptions._parallelNetworkJobs);
+    // Over budget only one directory is listed at a time, which keeps the
+    // listings in flight and the newly queued directory jobs to a minimum.
+    if (MemoryBudget::instance()->isExhausted()) {
+        limit = 1;
+    }
     if (_currentRootJob && _currentlyActiveJobs < limit) {
         _currentRootJob->processSubJobs(limit - _currentlyActiveJobs);
     }
+    Metrics::instance()->setGauge(QStringLiteral("sync_discovery_active_jobs"), _currentlyActiveJobs);
 }
 
 DiscoverySingleLocalDirectoryJob::DiscoverySingleLocalDirectoryJob(const AccountPtr &account, const QString &localPath, OCC::Vfs *vfs, QObject *parent)
@@ -258,6 +267,11 @@ DiscoverySingleLocalDirectoryJob::DiscoverySingleLocalDirectoryJob(const Account
 
 // Use as QRunnable
 void DiscoverySingleLocalDirectoryJob::run() {
+    if (_backgroundPriority) {
+        Utility::lowerCurrentThreadPriority();
+    }
+    const auto span = SyncTracer::instance()->beginOnThread("discovery", QStringLiteral("LocalDirectoryListing"), QString(), _localPath);
+
     QString localPath = _localPath;
     if (localPath.endsWith(QLatin1Char('/'))) // Happens if _currentFolder._local.isEmpty()
         localPath.chop(1);
@@ -41,6 +41,7 @@ enum class LocalDiscoveryStyle {
 class Account;
 class SyncJournalDb;
 class ProcessDirectoryJob;
+class SyncRecorder;
 
 /**
  * Represent all the meta-data about a file in the server
@@ -88,6 +89,9 @@ class DiscoverySingleLocalDirectoryJob : public QObject, public QRunnable
 public:
     explicit DiscoverySingleLocalDirectoryJob(const AccountPtr &account, const QString &localPath, OCC::Vfs *vfs, QObject *parent = nullptr);
 
+    /// Lower the priority of the thread running the job, see Utility::lowerCurrentThreadPriority()
+    void setBackgroundPriority(bool background) { _backgroundPriority = background; }
+
     void run() override;
 signals:
     void finished(QVector<LocalInfo> result);
@@ -101,6 +105,7 @@ private:
     QString _localPath;
     AccountPtr _account;
     OCC::Vfs* _vfs;
+    bool _backgroundPriority = false;
 public:
 };
 
@@ -255,6 +260,7 @@ public:
     QStringList _serverBlacklistedFiles; // The blacklist from the capabilities
     bool _ignoreHiddenFiles = false;
     std::function<bool(const QString &)> _shouldDiscoverLocaly;
+    SyncRecorder *_syncRecorder = nullptr; // optional, records the listings for later replay
 
     void startJob(ProcessDirectoryJob *);
 
@@ -264,6 +270,8 @@ public:
     // output
     QByteArray _dataFingerprint;
     bool _anotherSyncNeeded = false;
+    /// The files that were found to be up to date, they are not reported with itemDiscovered()
+    qint64 _unchangedFiles = 0;
 
 signals:
     void fatalError(const QString &errorString);
@@ -91,15 +91,23 @@ bool FileSystem::setModTime(const QString &filename, time_t modTime)
 
 bool FileSystem::fileChanged(const QFileInfo &info,
     qint64 previousSize,
-    time_t previousMtime)
+    time_t previousMtime,
+    FileStat *current)
 {
-    // previousMtime == -1 indicates the file does not exist
-    if (!info.exists() && previousMtime != -1) {
-        qCDebug(lcFileSystem) << info.filePath() << "was removed";
-        return true;
+    FileStat stat;
+    if (!getFileStat(info.filePath(), &stat)) {
+        // previousMtime == -1 indicates the file does not exist
+        if (previousMtime != -1) {
+            qCDebug(lcFileSystem) << info.filePath() << "was removed";
+            return true;
+        }
+        return false;
     }
-    const qint64 actualSize = getSize(info);
-    const time_t actualMtime = getModTime(info.filePath());
+    if (current) {
+        *current = stat;
+    }
+    const qint64 actualSize = stat.size;
+    const time_t actualMtime = stat.modtime;
     if (actualSize != previousSize || actualMtime != previousMtime) {
         qCDebug(lcFileSystem) << "File" << info.filePath() << "has changed:"
                               << "size: " << previousSize << "<->" << actualSize
@@ -189,5 +197,21 @@ bool FileSystem::getInode(const QString &filename, quint64 *inode)
     return false;
 }
 
+bool FileSystem::getFileStat(const QString &filename, FileStat *stat)
+{
+    csync_file_stat_t fs;
+    if (csync_vio_local_stat(filename, &fs) != 0) {
+        return false;
+    }
+    stat->size = fs.size;
+    stat->inode = fs.inode;
+    stat->modtime = fs.modtime;
+    if (stat->modtime == 0) {
+        // same fallback as getModTime()
+        stat->modtime = getModTime(filename);
+    }
+    return true;
+}
+
 
 } // namespace OCC
@@ -68,16 +68,35 @@ namespace FileSystem {
      */
     bool OWNCLOUDSYNC_EXPORT getInode(const QString &filename, quint64 *inode);
 
+    struct FileStat
+    {
+        qint64 size = -1;
+        time_t modtime = -1;
+        quint64 inode = 0;
+    };
+
+    /**
+     * @brief Retrieve size, mtime and inode of a file with a single stat
+     *
+     * On network file systems every stat is a round trip, prefer this over
+     * separate getSize(), getModTime() and getInode() calls.
+     *
+     * @return false if the file does not exist or can't be accessed
+     */
+    bool OWNCLOUDSYNC_EXPORT getFileStat(const QString &filename, FileStat *stat);
+
     /**
      * @brief Check if \a fileName has changed given previous size and mtime
      *
      * Nonexisting files are covered through mtime: they have an previousMtime of -1.
+     * If \a current is set it receives the values that were compared.
      *
      * @return true if the file's mtime or size are not what is expected.
      */
     bool OWNCLOUDSYNC_EXPORT fileChanged(const QFileInfo &info,
         qint64 previousSize,
-        time_t previousMtime);
+        time_t previousMtime,
+        FileStat *current = nullptr);
 
 
     struct RemoveEntry
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "memorybudget.h"
+
+#include "discoveryphase.h"
+#include "metrics.h"
+#include "syncfileitem.h"
+
+#include <QLoggingCategory>
+#include <QStringList>
+
+#include <utility>
+
+namespace {
+Q_LOGGING_CATEGORY(lcMemoryBudget, "sync.memorybudget", QtInfoMsg)
+
+qint64 stringSize(const QString &s)
+{
+    return s.size() * static_cast<qint64>(sizeof(QChar));
+}
+}
+
+using namespace OCC;
+
+MemoryBudget::Reservation::Reservation(Reservation &&other) noexcept
+    : _component(other._component)
+    , _bytes(std::exchange(other._bytes, 0))
+{
+}
+
+MemoryBudget::Reservation &MemoryBudget::Reservation::operator=(Reservation &&other) noexcept
+{
+    reset();
+    _component = other._component;
+    _bytes = std::exchange(other._bytes, 0);
+    return *this;
+}
+
+MemoryBudget::Reservation::~Reservation()
+{
+    reset();
+}
+
+void MemoryBudget::Reservation::add(qint64 bytes)
+{
+    _bytes += bytes;
+    MemoryBudget::instance()->_usage[static_cast<size_t>(_component)] += bytes;
+}
+
+void MemoryBudget::Reservation::release(qint64 bytes)
+{
+    bytes = qMin(bytes, _bytes);
+    if (bytes <= 0) {
+        return;
+    }
+    _bytes -= bytes;
+    MemoryBudget::instance()->_usage[static_cast<size_t>(_component)] -= bytes;
+}
+
+MemoryBudget *MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return &budget;
+}
+
+MemoryBudget::MemoryBudget()
+{
+    const auto megabytes = qEnvironmentVariableIntValue("OWNCLOUD_MEMORY_BUDGET_MB");
+    if (megabytes > 0) {
+        _budget = megabytes * 1024LL * 1024LL;
+    }
+}
+
+QString MemoryBudget::componentName(Component component)
+{
+    switch (component) {
+    case Component::SyncItems:
+        return QStringLiteral("syncitems");
+    case Component::RemoteListings:
+        return QStringLiteral("remotelistings");
+    case Component::LocalListings:
+        return QStringLiteral("locallistings");
+    case Component::DirectoryJobs:
+        return QStringLiteral("directoryjobs");
+    case Component::ComponentCount:
+        break;
+    }
+    Q_UNREACHABLE();
+}
+
+qint64 MemoryBudget::estimatedSize(const SyncFileItem &item)
+{
+    return sizeof(SyncFileItem) + stringSize(item._file) + stringSize(item._renameTarget) + stringSize(item._originalFile)
+        + item._etag.size() + item._fileId.size() + item._checksumHeader.size()
+        + stringSize(item._directDownloadUrl) + stringSize(item._directDownloadCookies);
+}
+
+qint64 MemoryBudget::estimatedSize(const RemoteInfo &info)
+{
+    return sizeof(RemoteInfo) + stringSize(info.name) + info.etag.size() + info.fileId.size() + info.checksumHeader.size()
+        + stringSize(info.directDownloadUrl) + stringSize(info.directDownloadCookies);
+}
+
+qint64 MemoryBudget::estimatedSize(const LocalInfo &info)
+{
+    return sizeof(LocalInfo) + stringSize(info.name);
+}
+
+void MemoryBudget::setBudget(qint64 bytes)
+{
+    _budget = qMax<qint64>(0, bytes);
+}
+
+qint64 MemoryBudget::usage(Component component) const
+{
+    return _usage[static_cast<size_t>(component)];
+}
+
+qint64 MemoryBudget::totalUsage() const
+{
+    qint64 total = 0;
+    for (const auto &usage : _usage) {
+        total += usage;
+    }
+    return total;
+}
+
+bool MemoryBudget::isExhausted() const
+{
+    const qint64 limit = _budget;
+    return limit > 0 && totalUsage() >= limit;
+}
+
+void MemoryBudget::report() const
+{
+    QStringList parts;
+    for (int i = 0; i < static_cast<int>(Component::ComponentCount); ++i) {
+        const auto component = static_cast<Component>(i);
+        parts << QStringLiteral("%1: %2 kB").arg(componentName(component), QString::number(usage(component) / 1024));
+        Metrics::instance()->setGauge(QStringLiteral("sync_memory_usage_bytes"), usage(component), { { QStringLiteral("component"), componentName(component) } });
+    }
+    const qint64 limit = _budget;
+    qCInfo(lcMemoryBudget) << "Estimated memory usage" << parts.join(QStringLiteral(", "))
+                           << "budget:" << (limit ? QStringLiteral("%1 kB").arg(limit / 1024) : QStringLiteral("unlimited"));
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QString>
+
+#include <array>
+#include <atomic>
+
+namespace OCC {
+
+class SyncFileItem;
+struct LocalInfo;
+struct RemoteInfo;
+
+/**
+ * @brief Estimates the memory held by the sync engine and enforces a budget
+ *
+ * The components account the memory of the data they hold with a
+ * Reservation. The numbers are estimates based on the sizes of the
+ * structures and their strings.
+ *
+ * When the total is above budget() the discovery only lists one directory
+ * at a time, see DiscoveryPhase::scheduleMoreJobs(). Once the total is below
+ * the budget again the listings run in parallel again. This only throttles
+ * the growth, the discovered items are still kept until they are propagated.
+ *
+ * The budget is set with OWNCLOUD_MEMORY_BUDGET_MB or the memoryBudget
+ * config value, 0 means unlimited.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT MemoryBudget
+{
+public:
+    enum class Component {
+        SyncItems,
+        RemoteListings,
+        LocalListings,
+        DirectoryJobs,
+
+        ComponentCount
+    };
+
+    /** Memory accounted to a component, released when the reservation is destroyed */
+    class OWNCLOUDSYNC_EXPORT Reservation
+    {
+    public:
+        explicit Reservation(Component component)
+            : _component(component)
+        {
+        }
+        Reservation(Reservation &&other) noexcept;
+        Reservation &operator=(Reservation &&other) noexcept;
+        ~Reservation();
+
+        qint64 bytes() const { return _bytes; }
+
+        void add(qint64 bytes);
+        /// Releases up to @a bytes, never more than bytes()
+        void release(qint64 bytes);
+        void reset() { release(_bytes); }
+
+    private:
+        Component _component;
+        qint64 _bytes = 0;
+    };
+
+    static MemoryBudget *instance();
+
+    static QString componentName(Component component);
+
+    static qint64 estimatedSize(const SyncFileItem &item);
+    static qint64 estimatedSize(const RemoteInfo &info);
+    static qint64 estimatedSize(const LocalInfo &info);
+
+    /// In bytes, 0 means unlimited
+    qint64 budget() const { return _budget; }
+    void setBudget(qint64 bytes);
+
+    qint64 usage(Component component) const;
+    qint64 totalUsage() const;
+
+    bool isExhausted() const;
+
+    /// Logs the usage of each component and publishes it as metrics
+    void report() const;
+
+private:
+    MemoryBudget();
+
+    std::atomic<qint64> _budget { 0 };
+    std::array<std::atomic<qint64>, static_cast<size_t>(Component::ComponentCount)> _usage = {};
+};
+}
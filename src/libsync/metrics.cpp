@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "metrics.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+Q_LOGGING_CATEGORY(lcMetrics, "sync.metrics", QtInfoMsg)
+
+const QVector<double> DurationBuckets { 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300, 900, 3600 };
+
+QByteArray formatValue(double value)
+{
+    return QByteArray::number(value, 'g', 15);
+}
+
+QByteArray escapeLabelValue(const QString &value)
+{
+    auto out = value.toUtf8();
+    out.replace('\\', "\\\\");
+    out.replace('"', "\\\"");
+    out.replace('\n', "\\n");
+    return out;
+}
+
+QString renderLabels(const OCC::Metrics::Labels &labels)
+{
+    QByteArray out;
+    for (auto it = labels.cbegin(); it != labels.cend(); ++it) {
+        if (!out.isEmpty()) {
+            out += ',';
+        }
+        out += it.key().toUtf8() + "=\"" + escapeLabelValue(it.value()) + '"';
+    }
+    return QString::fromUtf8(out);
+}
+
+QByteArray labelSet(const QString &labels)
+{
+    if (labels.isEmpty()) {
+        return {};
+    }
+    return "{" + labels.toUtf8() + '}';
+}
+
+// Adds an extra label to an already rendered label set, used for the le label of the buckets
+QByteArray withLabel(const QString &labels, const QByteArray &extra)
+{
+    if (labels.isEmpty()) {
+        return "{" + extra + '}';
+    }
+    return "{" + labels.toUtf8() + ',' + extra + '}';
+}
+
+// -1 if unknown
+qint64 residentMemoryBytes()
+{
+#ifdef Q_OS_LINUX
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        const auto fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+}
+
+using namespace OCC;
+
+Metrics *Metrics::instance()
+{
+    static Metrics metrics;
+    return &metrics;
+}
+
+Metrics::Metrics()
+{
+    registerMetric(QStringLiteral("sync_runs_total"), Type::Counter, QStringLiteral("Finished sync runs by result"));
+    registerMetric(QStringLiteral("sync_duration_seconds"), Type::Histogram, QStringLiteral("Duration of sync runs"), DurationBuckets);
+    registerMetric(QStringLiteral("sync_discovery_duration_seconds"), Type::Histogram, QStringLiteral("Duration of the discovery phase"), DurationBuckets);
+    registerMetric(QStringLiteral("sync_discovery_listings_total"), Type::Counter, QStringLiteral("Directory listings by source and result"));
+    registerMetric(QStringLiteral("sync_discovery_active_jobs"), Type::Gauge, QStringLiteral("Directory listings currently running"));
+    registerMetric(QStringLiteral("sync_propagator_active_jobs"), Type::Gauge, QStringLiteral("Propagation jobs currently running"));
+    registerMetric(QStringLiteral("sync_propagator_pending_jobs"), Type::Gauge, QStringLiteral("Propagation jobs waiting to be scheduled"));
+    registerMetric(QStringLiteral("sync_items_total"), Type::Counter, QStringLiteral("Propagated items by direction and status"));
+    registerMetric(QStringLiteral("sync_transferred_bytes_total"), Type::Counter, QStringLiteral("Bytes of successfully propagated files by direction"));
+    registerMetric(QStringLiteral("sync_checksum_cache_lookups_total"), Type::Counter, QStringLiteral("Checksum cache lookups by result"));
+    registerMetric(QStringLiteral("sync_journal_size_bytes"), Type::Gauge, QStringLiteral("Size of the sync journal database including its write ahead log"));
+    registerMetric(QStringLiteral("sync_memory_usage_bytes"), Type::Gauge, QStringLiteral("Estimated memory held by the sync engine by component"));
+    registerMetric(QStringLiteral("sync_timer_wakeups_total"), Type::Counter, QStringLiteral("Expired periodic timers by timer"));
+    registerMetric(QStringLiteral("network_shared_pool_requests_total"), Type::Counter, QStringLiteral("Requests sent with a shared connection pool by origin"));
+    registerMetric(QStringLiteral("network_shared_pool_managers"), Type::Gauge, QStringLiteral("Access managers sharing a connection pool by origin"));
+    registerMetric(QStringLiteral("process_resident_memory_bytes"), Type::Gauge, QStringLiteral("Resident memory size of the client"));
+}
+
+void Metrics::registerMetric(const QString &name, Type type, const QString &help, const QVector<double> &buckets)
+{
+    QMutexLocker lock(&_mutex);
+    auto &family = _families[name];
+    family.type = type;
+    family.help = help;
+    family.buckets = buckets;
+}
+
+Metrics::Series *Metrics::series(const QString &name, Type type, const Labels &labels)
+{
+    auto it = _families.find(name);
+    if (it == _families.end() || it->type != type) {
+        qCWarning(lcMetrics) << "Unknown metric" << name;
+        Q_ASSERT(false);
+        return nullptr;
+    }
+    auto &series = it->series[renderLabels(labels)];
+    if (type == Type::Histogram && series.bucketCounts.isEmpty()) {
+        series.bucketCounts.resize(it->buckets.size());
+    }
+    return &series;
+}
+
+void Metrics::incrementCounter(const QString &name, double value, const Labels &labels)
+{
+    QMutexLocker lock(&_mutex);
+    if (auto s = series(name, Type::Counter, labels)) {
+        s->value += value;
+    }
+}
+
+void Metrics::setGauge(const QString &name, double value, const Labels &labels)
+{
+    QMutexLocker lock(&_mutex);
+    if (auto s = series(name, Type::Gauge, labels)) {
+        s->value = value;
+    }
+}
+
+void Metrics::observe(const QString &name, double value, const Labels &labels)
+{
+    QMutexLocker lock(&_mutex);
+    if (auto s = series(name, Type::Histogram, labels)) {
+        const auto &buckets = _families[name].buckets;
+        for (int i = 0; i < buckets.size(); ++i) {
+            if (value <= buckets.at(i)) {
+                ++s->bucketCounts[i];
+            }
+        }
+        s->sum += value;
+        ++s->count;
+    }
+}
+
+QByteArray Metrics::toPrometheusText()
+{
+    // sampled on demand, there is no other place that would update it
+    const auto rss = residentMemoryBytes();
+    if (rss >= 0) {
+        setGauge(QStringLiteral("process_resident_memory_bytes"), rss);
+    }
+
+    QMutexLocker lock(&_mutex);
+    QByteArray out;
+    for (auto it = _families.cbegin(); it != _families.cend(); ++it) {
+        const auto name = it.key().toUtf8();
+        const auto &family = *it;
+        if (family.series.isEmpty()) {
+            continue;
+        }
+        out += "# HELP " + name + ' ' + family.help.toUtf8() + '\n';
+        switch (family.type) {
+        case Type::Counter:
+            out += "# TYPE " + name + " counter\n";
+            break;
+        case Type::Gauge:
+            out += "# TYPE " + name + " gauge\n";
+            break;
+        case Type::Histogram:
+            out += "# TYPE " + name + " histogram\n";
+            break;
+        }
+        for (auto s = family.series.cbegin(); s != family.series.cend(); ++s) {
+            const auto &labels = s.key();
+            if (family.type != Type::Histogram) {
+                out += name + labelSet(labels) + ' ' + formatValue(s->value) + '\n';
+                continue;
+            }
+            // the bucket counts are cumulative already
+            for (int i = 0; i < family.buckets.size(); ++i) {
+                out += name + "_bucket" + withLabel(labels, "le=\"" + formatValue(family.buckets.at(i)) + '"') + ' ' + QByteArray::number(s->bucketCounts.at(i)) + '\n';
+            }
+            out += name + "_bucket" + withLabel(labels, "le=\"+Inf\"") + ' ' + QByteArray::number(s->count) + '\n';
+            out += name + "_sum" + labelSet(labels) + ' ' + formatValue(s->sum) + '\n';
+            out += name + "_count" + labelSet(labels) + ' ' + QByteArray::number(s->count) + '\n';
+        }
+    }
+    return out;
+}
+
+void Metrics::reset()
+{
+    QMutexLocker lock(&_mutex);
+    for (auto &family : _families) {
+        family.series.clear();
+    }
+}
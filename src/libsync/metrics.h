@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+namespace OCC {
+
+/**
+ * @brief Process wide registry of counters, gauges and histograms
+ *
+ * The sync engine, the propagator and the discovery update the metrics while
+ * they run, toPrometheusText() renders the current values in the Prometheus
+ * text exposition format. The gui exposes them with the V2/GET_METRICS socket
+ * api command.
+ *
+ * Metric names are registered once with a help text, updating a name that was
+ * not registered is a programming error and ignored.
+ *
+ * All methods are thread safe.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT Metrics
+{
+public:
+    enum class Type {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    using Labels = QMap<QString, QString>;
+
+    static Metrics *instance();
+
+    /// @a buckets are the upper bounds of the histogram buckets, only used for Type::Histogram
+    void registerMetric(const QString &name, Type type, const QString &help, const QVector<double> &buckets = {});
+
+    void incrementCounter(const QString &name, double value = 1, const Labels &labels = {});
+    void setGauge(const QString &name, double value, const Labels &labels = {});
+    void observe(const QString &name, double value, const Labels &labels = {});
+
+    QByteArray toPrometheusText();
+
+    /// Forget all recorded values, the registered metrics are kept
+    void reset();
+
+private:
+    Metrics();
+
+    struct Series
+    {
+        double value = 0;
+        double sum = 0;
+        quint64 count = 0;
+        QVector<quint64> bucketCounts;
+    };
+
+    struct Family
+    {
+        Type type;
+        QString help;
+        QVector<double> buckets;
+        // rendered label set -> values
+        QMap<QString, Series> series;
+    };
+
+    Series *series(const QString &name, Type type, const Labels &labels);
+
+    mutable QMutex _mutex;
+    QMap<QString, Family> _families;
+};
+}
@@ -16,11 +16,14 @@
 #include "owncloudpropagator.h"
 #include "account.h"
 #include "common/asserts.h"
+#include "common/checksums.h"
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
 #include "common/utility.h"
 #include "discoveryphase.h"
 #include "filesystem.h"
+#include "metrics.h"
+#include "propagatebulkdownload.h"
 #include "propagatedownload.h"
 #include "propagateremotedelete.h"
 #include "propagateremotemkdir.h"
@@ -44,6 +47,8 @@
 #include <QTimerEvent>
 #include <qmath.h>
 
+#include <limits>
+
 using namespace std::chrono_literals;
 
 namespace OCC {
@@ -118,6 +123,7 @@ bool PropagateItemJob::scheduleSelfOrChild()
     }
     qCInfo(lcPropagator) << "Starting" << _item->_instruction << "propagation of" << _item->destination() << "by" << this;
 
+    _traceSpan = SyncTracer::instance()->begin("propagation", QString::fromLatin1(metaObject()->className()), propagator()->localPath(), _item->destination());
     _state = Running;
     if (thread() != QApplication::instance()->thread()) {
         QMetaObject::invokeMethod(this, &PropagateItemJob::start); // We could be in a different thread (neon jobs)
@@ -127,6 +133,27 @@ bool PropagateItemJob::scheduleSelfOrChild()
     return true;
 }
 
+void PropagateItemJob::traceChecksum(ComputeChecksum *computeChecksum, const QString &name)
+{
+    auto span = SyncTracer::instance()->begin("checksum", name, propagator()->localPath(), _item->_file);
+    if (!span.isActive()) {
+        return;
+    }
+    span.setBytes(_item->_size);
+    SyncTracer::endOn(std::move(span), computeChecksum, this, &ComputeChecksum::done);
+
+    // the computation itself, on the worker thread
+    auto workerSpan = std::make_shared<SyncTracer::Span>();
+    computeChecksum->setWorkerObserver([workerSpan, name, folder = propagator()->localPath(), file = _item->_file, size = _item->_size](bool finished) {
+        if (finished) {
+            workerSpan->end();
+            return;
+        }
+        *workerSpan = SyncTracer::instance()->beginOnThread("checksum", name, folder, file);
+        workerSpan->setBytes(size);
+    });
+}
+
 static qint64 getMinBlacklistTime()
 {
     return qMax(qEnvironmentVariableIntValue("OWNCLOUD_BLACKLIST_TIME_MIN"),
@@ -232,6 +259,8 @@ void PropagateItemJob::done(SyncFileItem::Status statusArg, const QString &error
     // Duplicate calls to done() are a logic error
     OC_ENFORCE(_state != Finished);
     _state = Finished;
+    _traceSpan.setBytes(_item->_size);
+    _traceSpan.end();
 
     _item->_status = statusArg;
 
@@ -380,6 +409,22 @@ PropagateItemJob *OwncloudPropagator::createJob(const SyncFileItemPtr &item)
     Q_UNREACHABLE();
 }
 
+PropagateDirectory *OwncloudPropagator::createDirectoryJob(int directoryNode)
+{
+    // release the node, the job takes over its contents
+    const DirectoryNode node = std::move(_directoryNodes[directoryNode]);
+    _directoryNodes[directoryNode] = {};
+
+    auto *dir = new PropagateDirectory(this, node.item);
+    for (const int subDirectory : node.subDirectories) {
+        dir->appendDirectory(subDirectory);
+    }
+    for (const auto &task : node.tasks) {
+        dir->appendTask(task);
+    }
+    return dir;
+}
+
 qint64 OwncloudPropagator::smallFileSize()
 {
     const qint64 smallFileSize = 100 * 1024; //default to 1 MB. Not dynamic right now.
@@ -391,15 +436,28 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
     /* This builds all the jobs needed for the propagation.
      * Each directory is a PropagateDirectory job, which contains the files in it.
      * In order to do that we loop over the items. (which are sorted by destination)
-     * When we enter a directory, we can create the directory job and push it on the stack. */
+     * When we enter a directory, we create a DirectoryNode for it and push it on the stack.
+     * The node is turned into a job by createDirectoryJob() once it gets scheduled. */
+
+    struct DirectoryEntry
+    {
+        QString path;
+        SyncFileItemPtr item;
+        // Either a DirectoryNode collecting the contents, or a job for directories
+        // that need to exist right away (the root and removed directories).
+        int node;
+        PropagateDirectory *job;
+    };
 
     _rootJob.reset(new PropagateRootDirectory(this));
-    QStack<QPair<QString /* directory name */, PropagateDirectory * /* job */>> directories;
-    directories.push(qMakePair(QString(), _rootJob.data()));
+    _directoryNodes.clear();
+    QStack<DirectoryEntry> directories;
+    directories.push({ QString(), _rootJob->item(), -1, _rootJob.data() });
     QVector<PropagatorJob *> directoriesToRemove;
     QString removedDirectory;
     QString maybeConflictDirectory;
-    for (const auto &item : qAsConst(items)) {
+    for (auto it = items.cbegin(); it != items.cend(); ++it) {
+        const auto &item = *it;
         if (!removedDirectory.isEmpty() && item->_file.startsWith(removedDirectory)) {
             // this is an item in a directory which is going to be removed.
             PropagateDirectory *delDirJob = qobject_cast<PropagateDirectory *>(directoriesToRemove.first());
@@ -446,12 +504,12 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
             }
         }
 
-        while (!item->destination().startsWith(directories.top().first)) {
+        while (!item->destination().startsWith(directories.top().path)) {
             directories.pop();
         }
 
         if (item->isDirectory()) {
-            PropagateDirectory *dir = new PropagateDirectory(this, item);
+            const QString directoryPath = item->destination() + QLatin1Char('/');
 
             if (item->_instruction == CSYNC_INSTRUCTION_TYPE_CHANGE
                 && item->_direction == SyncFileItem::Up) {
@@ -460,15 +518,15 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
                 // checkForPermissions() has already run and used the permissions
                 // of the file we're about to delete to decide whether uploading
                 // to the new dir is ok...
-                for (const auto &item2 : qAsConst(items)) {
-                    if (item2->destination().startsWith(item->destination() + QLatin1Char('/'))) {
-                        item2->_instruction = CSYNC_INSTRUCTION_NONE;
-                        _anotherSyncNeeded = true;
-                    }
+                // The items are sorted by destination, so the contents directly follow.
+                for (auto it2 = std::next(it); it2 != items.cend() && (*it2)->destination().startsWith(directoryPath); ++it2) {
+                    (*it2)->_instruction = CSYNC_INSTRUCTION_NONE;
+                    _anotherSyncNeeded = true;
                 }
             }
 
             if (item->_instruction == CSYNC_INSTRUCTION_REMOVE) {
+                PropagateDirectory *dir = new PropagateDirectory(this, item);
                 // We do the removal of directories at the end, because there might be moves from
                 // these directories that will happen later.
                 directoriesToRemove.prepend(dir);
@@ -479,21 +537,33 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
                 // NOTE: Currently this means that we don't update those etag at all in this sync,
                 //       but it should not be a problem, they will be updated in the next sync.
                 for (int i = 0; i < directories.size(); ++i) {
-                    if (directories[i].second->item()->_instruction == CSYNC_INSTRUCTION_UPDATE_METADATA)
-                        directories[i].second->item()->_instruction = CSYNC_INSTRUCTION_NONE;
+                    if (directories[i].item->_instruction == CSYNC_INSTRUCTION_UPDATE_METADATA)
+                        directories[i].item->_instruction = CSYNC_INSTRUCTION_NONE;
                 }
+                directories.push({ directoryPath, item, -1, dir });
             } else {
-                PropagateDirectory *currentDirJob = directories.top().second;
-                currentDirJob->appendJob(dir);
+                const int node = static_cast<int>(_directoryNodes.size());
+                _directoryNodes.push_back({ item, {}, {} });
+                const auto &currentDir = directories.top();
+                if (currentDir.job) {
+                    currentDir.job->appendDirectory(node);
+                } else {
+                    _directoryNodes[currentDir.node].subDirectories.append(node);
+                }
+                directories.push({ directoryPath, item, node, nullptr });
             }
-            directories.push(qMakePair(item->destination() + QLatin1Char('/'), dir));
         } else {
             if (item->_instruction == CSYNC_INSTRUCTION_TYPE_CHANGE) {
                 // will delete directories, so defer execution
                 directoriesToRemove.prepend(createJob(item));
                 removedDirectory = item->_file + QLatin1Char('/');
             } else {
-                directories.top().second->appendTask(item);
+                const auto &currentDir = directories.top();
+                if (currentDir.job) {
+                    currentDir.job->appendTask(item);
+                } else {
+                    _directoryNodes[currentDir.node].tasks.append(item);
+                }
             }
 
             if (item->_instruction == CSYNC_INSTRUCTION_CONFLICT) {
@@ -519,6 +589,12 @@ const SyncOptions &OwncloudPropagator::syncOptions() const
     return _syncOptions;
 }
 
+bool OwncloudPropagator::useBackgroundPriority(const SyncFileItem &item) const
+{
+    static constexpr qint64 minimumSize = 1024 * 1024;
+    return _syncOptions._backgroundPriority && item._type != ItemTypeVirtualFileDownload && item._size >= minimumSize;
+}
+
 void OwncloudPropagator::setSyncOptions(const SyncOptions &syncOptions)
 {
     _syncOptions = syncOptions;
@@ -648,6 +724,9 @@ void OwncloudPropagator::scheduleNextJobImpl()
             }
         }
     }
+
+    Metrics::instance()->setGauge(QStringLiteral("sync_propagator_active_jobs"), _activeJobList.count());
+    Metrics::instance()->setGauge(QStringLiteral("sync_propagator_pending_jobs"), _rootJob->pendingJobCount());
 }
 
 void OwncloudPropagator::reportFileTotal(const SyncFileItem &item, qint64 newSize)
@@ -827,17 +906,50 @@ OwncloudPropagator *PropagatorJob::propagator() const
     return qobject_cast<OwncloudPropagator *>(parent());
 }
 
+void PropagatorJob::adjustScheduleCounts(int pendingDelta, int blockingDelta)
+{
+    if (pendingDelta == 0 && blockingDelta == 0) {
+        return;
+    }
+    _pendingJobCount += pendingDelta;
+    _blockingJobCount += blockingDelta;
+    OC_ASSERT(_pendingJobCount >= 0 && _blockingJobCount >= 0);
+    if (_parentJob) {
+        _parentJob->childScheduleCountsChanged(this, pendingDelta, blockingDelta);
+    }
+}
+
+void PropagatorJob::childScheduleCountsChanged(PropagatorJob *, int pendingDelta, int blockingDelta)
+{
+    adjustScheduleCounts(pendingDelta, blockingDelta);
+}
+
 // ================================================================================
 
 PropagatorJob::JobParallelism PropagatorCompositeJob::parallelism()
 {
     // If any of the running sub jobs is not parallel, we have to wait
-    for (int i = 0; i < _runningJobs.count(); ++i) {
-        if (_runningJobs.at(i)->parallelism() != FullParallelism) {
-            return _runningJobs.at(i)->parallelism();
-        }
+    return _blockingJobCount > 0 ? WaitForFinished : FullParallelism;
+}
+
+void PropagatorCompositeJob::childScheduleCountsChanged(PropagatorJob *child, int pendingDelta, int blockingDelta)
+{
+    updateRunningJobIndex(child);
+    adjustScheduleCounts(pendingDelta, blockingDelta);
+}
+
+void PropagatorCompositeJob::updateRunningJobIndex(PropagatorJob *job)
+{
+    if (job->_pendingJobCount > 0) {
+        _runningJobsWithPendingWork.insert(job->_startOrder, job);
+    } else {
+        _runningJobsWithPendingWork.remove(job->_startOrder);
+    }
+    if (job->_blockingJobCount > 0) {
+        _blockingRunningJobs.insert(job->_startOrder, job);
+    } else {
+        _blockingRunningJobs.remove(job->_startOrder);
     }
-    return FullParallelism;
 }
 
 void PropagatorCompositeJob::slotSubJobAbortFinished()
@@ -855,6 +967,7 @@ void PropagatorCompositeJob::appendJob(PropagatorJob *job)
 {
     job->setAssociatedComposite(this);
     _jobsToDo.append(job);
+    adjustScheduleCounts(1, 0);
 }
 
 bool PropagatorCompositeJob::scheduleSelfOrChild()
@@ -868,46 +981,86 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
         _state = Running;
     }
 
-    // Ask all the running composite jobs if they have something new to schedule.
-    for (int i = 0; i < _runningJobs.size(); ++i) {
-        OC_ASSERT(_runningJobs.at(i)->_state == Running);
-
-        if (possiblyRunNextJob(_runningJobs.at(i))) {
+    // Ask the running jobs that still have something to start, in the order they were started.
+    // If any of the running sub jobs is not parallel, we have to cancel the scheduling
+    // of the rest of the list and wait for the blocking job to finish and schedule the next one.
+    const quint64 firstBlocking = _blockingRunningJobs.isEmpty() ? std::numeric_limits<quint64>::max() : _blockingRunningJobs.firstKey();
+    auto it = _runningJobsWithPendingWork.cbegin();
+    while (it != _runningJobsWithPendingWork.cend() && it.key() <= firstBlocking) {
+        const quint64 startOrder = it.key();
+        OC_ASSERT(it.value()->_state == Running);
+        if (it.value()->scheduleSelfOrChild()) {
             return true;
         }
-
-        // If any of the running sub jobs is not parallel, we have to cancel the scheduling
-        // of the rest of the list and wait for the blocking job to finish and schedule the next one.
-        auto paral = _runningJobs.at(i)->parallelism();
-        if (paral == WaitForFinished) {
-            return false;
-        }
+        // the index might have changed while the child was scheduling
+        it = _runningJobsWithPendingWork.upperBound(startOrder);
+    }
+    if (!_blockingRunningJobs.isEmpty()) {
+        return false;
     }
 
     // Now it's our turn, check if we have something left to do.
-    // First, convert a task to a job if necessary
+    // First, convert a directory or a task to a job if necessary
+    if (_jobsToDo.empty() && !_directoriesToDo.empty()) {
+        // the directory is already accounted for in _pendingJobCount
+        PropagatorJob *job = propagator()->createDirectoryJob(_directoriesToDo.front());
+        _directoriesToDo.pop_front();
+        job->setAssociatedComposite(this);
+        _jobsToDo.append(job);
+    }
     while (_jobsToDo.empty() && !_tasksToDo.empty()) {
         const SyncFileItemPtr nextTask = *_tasksToDo.begin();
         _tasksToDo.erase(_tasksToDo.begin());
+        if (PropagateVirtualFiles::canPropagate(propagator(), *nextTask)) {
+            // Batch the new virtual files that follow, they don't need the network
+            auto job = new PropagateVirtualFiles(propagator());
+            job->addItem(nextTask);
+            while (!_tasksToDo.empty() && job->count() < PropagateVirtualFiles::MaxBatchSize
+                && PropagateVirtualFiles::canPropagate(propagator(), **_tasksToDo.begin())) {
+                job->addItem(*_tasksToDo.begin());
+                _tasksToDo.erase(_tasksToDo.begin());
+            }
+            // the batch replaces all of its tasks but one
+            adjustScheduleCounts(1 - job->count(), 0);
+            job->setAssociatedComposite(this);
+            _jobsToDo.append(job);
+            break;
+        }
+        if (PropagateBulkDownload::canPropagate(propagator(), *nextTask)
+            && !_tasksToDo.empty() && PropagateBulkDownload::canPropagate(propagator(), **_tasksToDo.begin())) {
+            // Fetch the new small files that follow in one archive
+            auto job = new PropagateBulkDownload(propagator());
+            job->addItem(nextTask);
+            while (!_tasksToDo.empty() && job->canAddItem(**_tasksToDo.begin())) {
+                job->addItem(*_tasksToDo.begin());
+                _tasksToDo.erase(_tasksToDo.begin());
+            }
+            adjustScheduleCounts(1 - job->count(), 0);
+            job->setAssociatedComposite(this);
+            _jobsToDo.append(job);
+            break;
+        }
         PropagatorJob *job = propagator()->createJob(nextTask);
         if (!job) {
             qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->_instruction;
+            adjustScheduleCounts(-1, 0);
             continue;
         }
-        appendJob(job);
+        // the task is already accounted for in _pendingJobCount
+        job->setAssociatedComposite(this);
+        _jobsToDo.append(job);
         break;
     }
     // Then run the next job
     if (!_jobsToDo.isEmpty()) {
         PropagatorJob *nextJob = _jobsToDo.first();
         _jobsToDo.remove(0);
-        _runningJobs.append(nextJob);
-        return possiblyRunNextJob(nextJob);
+        return startNextJob(nextJob);
     }
 
     // If neither us or our children had stuff left to do we could hang. Make sure
     // we mark this job as finished so that the propagator can schedule a new one.
-    if (_jobsToDo.isEmpty() && _tasksToDo.empty() && _runningJobs.isEmpty()) {
+    if (isEmpty()) {
         // Our parent jobs are already iterating over their running jobs, post to the event loop
         // to avoid removing ourself from that list while they iterate.
         QMetaObject::invokeMethod(this, &PropagatorCompositeJob::finalize, Qt::QueuedConnection);
@@ -915,6 +1068,26 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     return false;
 }
 
+bool PropagatorCompositeJob::startNextJob(PropagatorJob *next)
+{
+    OC_ASSERT(next->_state == NotYetStarted);
+    connect(next, &PropagatorJob::finished, this, &PropagatorCompositeJob::slotSubJobFinished);
+
+    // Jobs like a directory rename block by themselves, composites
+    // derive their parallelism from the blocking count of their children.
+    if (next->_blockingJobCount == 0 && next->parallelism() == WaitForFinished) {
+        next->_blockingJobCount = 1;
+    }
+    next->_startOrder = ++_startedJobsCount;
+    next->_parentJob = this;
+    _runningJobs.append(next);
+    updateRunningJobIndex(next);
+    // The job itself is no longer pending, but everything it contains now is
+    adjustScheduleCounts(next->_pendingJobCount - 1, next->_blockingJobCount);
+
+    return next->scheduleSelfOrChild();
+}
+
 void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
 {
     PropagatorJob *subJob = static_cast<PropagatorJob *>(sender());
@@ -925,6 +1098,11 @@ void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
     int i = _runningJobs.indexOf(subJob);
     OC_ENFORCE(i >= 0); // should only happen if this function is called more than once
     _runningJobs.remove(i);
+    _runningJobsWithPendingWork.remove(subJob->_startOrder);
+    _blockingRunningJobs.remove(subJob->_startOrder);
+    // An aborted job might still contain jobs that never started
+    subJob->_parentJob = nullptr;
+    adjustScheduleCounts(-subJob->_pendingJobCount, -subJob->_blockingJobCount);
 
     // Any sub job error will cause the whole composite to fail. This is important
     // for knowing whether to update the etag in PropagateDirectory, for example.
@@ -936,7 +1114,7 @@ void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
         _hasError = status;
     }
 
-    if (_jobsToDo.isEmpty() && _tasksToDo.empty() && _runningJobs.isEmpty()) {
+    if (isEmpty()) {
         finalize();
     } else {
         propagator()->scheduleNextJob();
@@ -973,20 +1151,20 @@ PropagateDirectory::PropagateDirectory(OwncloudPropagator *propagator, const Syn
     if (_firstJob) {
         connect(_firstJob.data(), &PropagatorJob::finished, this, &PropagateDirectory::slotFirstJobFinished);
         _firstJob->setAssociatedComposite(&_subJobs);
+        _firstJob->_parentJob = this;
+        if (_firstJob->parallelism() == WaitForFinished) {
+            _firstJob->_blockingJobCount = 1;
+        }
+        adjustScheduleCounts(1, _firstJob->_blockingJobCount);
     }
+    _subJobs._parentJob = this;
     connect(&_subJobs, &PropagatorJob::finished, this, &PropagateDirectory::slotSubJobsFinished);
 }
 
 PropagatorJob::JobParallelism PropagateDirectory::parallelism()
 {
-    // If any of the non-finished sub jobs is not parallel, we have to wait
-    if (_firstJob && _firstJob->parallelism() != FullParallelism) {
-        return WaitForFinished;
-    }
-    if (_subJobs.parallelism() != FullParallelism) {
-        return WaitForFinished;
-    }
-    return FullParallelism;
+    // If any of the non-finished sub jobs (including the first job) is not parallel, we have to wait
+    return _blockingJobCount > 0 ? WaitForFinished : FullParallelism;
 }
 
 
@@ -1001,6 +1179,7 @@ bool PropagateDirectory::scheduleSelfOrChild()
     }
 
     if (_firstJob && _firstJob->_state == NotYetStarted) {
+        adjustScheduleCounts(-1, 0);
         return _firstJob->scheduleSelfOrChild();
     }
 
@@ -1014,7 +1193,10 @@ bool PropagateDirectory::scheduleSelfOrChild()
 
 void PropagateDirectory::slotFirstJobFinished(SyncFileItem::Status status)
 {
-    _firstJob.take()->deleteLater();
+    auto *firstJob = _firstJob.take();
+    firstJob->_parentJob = nullptr;
+    adjustScheduleCounts(0, -firstJob->_blockingJobCount);
+    firstJob->deleteLater();
 
     if (status != SyncFileItem::Success
         && status != SyncFileItem::Restoration
@@ -1027,6 +1209,10 @@ void PropagateDirectory::slotFirstJobFinished(SyncFileItem::Status status)
         return;
     }
 
+    if (_subJobs.pendingJobCount() == 0) {
+        // Nothing will schedule an empty composite anymore, give it the chance to finish.
+        _subJobs.scheduleSelfOrChild();
+    }
     propagator()->scheduleNextJob();
 }
 
@@ -1041,15 +1227,18 @@ void PropagateDirectory::slotSubJobsFinished(const SyncFileItem::Status status)
             return;
         }
 
-        if (status == SyncFileItem::Success) {
-            // If a directory is renamed, recursively delete any stale items
-            // that may still exist below the old path.
-            if (_item->_instruction == CSYNC_INSTRUCTION_RENAME
-                && _item->_originalFile != _item->_renameTarget) {
-                // TODO: check result but it breaks TestDatabaseError
-                propagator()->_journal->deleteFileRecord(_item->_originalFile, true);
+        // The directory was renamed: the items below it that changed were moved by
+        // their own jobs, the records of the unchanged files are moved along now.
+        if (_item->_instruction == CSYNC_INSTRUCTION_RENAME
+            && _item->_originalFile != _item->_renameTarget) {
+            if (!propagator()->_journal->moveFileRecordsBelow(_item->_originalFile, _item->_renameTarget)) {
+                qCWarning(lcDirectory) << "Error moving the records below" << _item->_originalFile << "to" << _item->_renameTarget;
+                done(SyncFileItem::FatalError, tr("Error writing metadata to the database"));
+                return;
             }
+        }
 
+        if (status == SyncFileItem::Success) {
             if (_item->_instruction == CSYNC_INSTRUCTION_NEW && _item->_direction == SyncFileItem::Down) {
                 // special case for local MKDIR, set local directory mtime
                 // (it's not synced later at all, but can be nice to have it set initially)
@@ -1094,6 +1283,7 @@ PropagateRootDirectory::PropagateRootDirectory(OwncloudPropagator *propagator)
     : PropagateDirectory(propagator, SyncFileItemPtr(new SyncFileItem))
     , _dirDeletionJobs(propagator)
 {
+    _dirDeletionJobs._parentJob = this;
     connect(&_dirDeletionJobs, &PropagatorJob::finished, this, &PropagateRootDirectory::slotDirDeletionJobsFinished);
 }
 
@@ -24,12 +24,15 @@
 #include <QIODevice>
 #include <QMutex>
 
+#include <deque>
+
 #include "csync.h"
 #include "syncfileitem.h"
 #include "common/syncjournaldb.h"
 #include "bandwidthmanager.h"
 #include "accountfwd.h"
 #include "syncoptions.h"
+#include "synctracer.h"
 
 namespace OCC {
 
@@ -48,6 +51,7 @@ qint64 freeSpaceLimit();
 
 class SyncJournalDb;
 class OwncloudPropagator;
+class ComputeChecksum;
 class PropagatorCompositeJob;
 
 /**
@@ -110,6 +114,13 @@ public:
      */
     void setAssociatedComposite(PropagatorCompositeJob *job) { _associatedComposite = job; }
 
+    /** The number of jobs and tasks below this job that were not started yet.
+     *
+     * Maintained incrementally and propagated to the parent job, so the
+     * scheduler only descends into subtrees that have something to start.
+     */
+    int pendingJobCount() const { return _pendingJobCount; }
+
 public slots:
     /*
      * Asynchronous abort requires emit of abortFinished() signal,
@@ -146,6 +157,32 @@ protected:
      * becoming composite jobs themselves.
      */
     PropagatorCompositeJob *_associatedComposite = nullptr;
+
+    /** Adjust the pending and blocking counters and forward the change to the parent job */
+    void adjustScheduleCounts(int pendingDelta, int blockingDelta);
+
+    /** Called when the counters of a job that has this job as _parentJob changed */
+    virtual void childScheduleCountsChanged(PropagatorJob *child, int pendingDelta, int blockingDelta);
+
+    /** The job that schedules this job, set once this job is accounted for in the parent's counters.
+     *
+     * For jobs in a PropagatorCompositeJob that is the composite, for the
+     * PropagateDirectory::_firstJob and PropagateDirectory::_subJobs that is
+     * the directory job.
+     */
+    PropagatorJob *_parentJob = nullptr;
+
+    /** See pendingJobCount() */
+    int _pendingJobCount = 0;
+
+    /** The number of running jobs below (or including) this one with WaitForFinished parallelism */
+    int _blockingJobCount = 0;
+
+    /** The position of this job in the start order of the composite that runs it */
+    quint64 _startOrder = 0;
+
+    friend class PropagatorCompositeJob;
+    friend class PropagateDirectory;
 };
 
 /*
@@ -157,9 +194,15 @@ class PropagateItemJob : public PropagatorJob
 protected:
     virtual void done(SyncFileItem::Status status, const QString &errorString = QString());
 
+    /// Adds a span for @a computeChecksum to the sync trace, see SyncTracer
+    void traceChecksum(ComputeChecksum *computeChecksum, const QString &name);
+
     SyncFileItemPtr _item;
     friend class PropagateDirectory;
 
+private:
+    SyncTracer::Span _traceSpan;
+
 public:
     PropagateItemJob(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
         : PropagatorJob(propagator)
@@ -181,11 +224,21 @@ class PropagatorCompositeJob : public PropagatorJob
     Q_OBJECT
 public:
     QVector<PropagatorJob *> _jobsToDo;
+    /** Directories that are only turned into PropagateDirectory jobs when they are scheduled.
+     *  See OwncloudPropagator::createDirectoryJob() */
+    std::deque<int> _directoriesToDo;
     SyncFileItemSet _tasksToDo;
     QVector<PropagatorJob *> _runningJobs;
     SyncFileItem::Status _hasError; // NoStatus,  or NormalError / SoftError if there was an error
     quint64 _abortsCount;
 
+    /** The subset of _runningJobs that still have jobs to start, keyed by start order */
+    QMap<quint64, PropagatorJob *> _runningJobsWithPendingWork;
+
+    /** The subset of _runningJobs that have WaitForFinished parallelism, keyed by start order */
+    QMap<quint64, PropagatorJob *> _blockingRunningJobs;
+    quint64 _startedJobsCount = 0;
+
     explicit PropagatorCompositeJob(OwncloudPropagator *propagator)
         : PropagatorJob(propagator)
         , _hasError(SyncFileItem::NoStatus), _abortsCount(0)
@@ -202,7 +255,14 @@ public:
     void appendJob(PropagatorJob *job);
     void appendTask(const SyncFileItemPtr &item)
     {
-        _tasksToDo.insert(item);
+        if (_tasksToDo.insert(item).second) {
+            adjustScheduleCounts(1, 0);
+        }
+    }
+    void appendDirectory(int directoryNode)
+    {
+        _directoriesToDo.push_back(directoryNode);
+        adjustScheduleCounts(1, 0);
     }
 
     bool scheduleSelfOrChild() override;
@@ -231,16 +291,21 @@ public:
 
     qint64 committedDiskSpace() const override;
 
-private slots:
-    void slotSubJobAbortFinished();
-    bool possiblyRunNextJob(PropagatorJob *next)
+    bool isEmpty() const
     {
-        if (next->_state == NotYetStarted) {
-            connect(next, &PropagatorJob::finished, this, &PropagatorCompositeJob::slotSubJobFinished);
-        }
-        return next->scheduleSelfOrChild();
+        return _jobsToDo.isEmpty() && _directoriesToDo.empty() && _tasksToDo.empty() && _runningJobs.isEmpty();
     }
 
+protected:
+    void childScheduleCountsChanged(PropagatorJob *child, int pendingDelta, int blockingDelta) override;
+
+private:
+    /** Move a job from _jobsToDo to _runningJobs and start it */
+    bool startNextJob(PropagatorJob *next);
+    void updateRunningJobIndex(PropagatorJob *job);
+
+private slots:
+    void slotSubJobAbortFinished();
     void slotSubJobFinished(SyncFileItem::Status status);
     void finalize();
 };
@@ -270,6 +335,11 @@ public:
         _subJobs.appendTask(item);
     }
 
+    void appendDirectory(int directoryNode)
+    {
+        _subJobs.appendDirectory(directoryNode);
+    }
+
     bool scheduleSelfOrChild() override;
     JobParallelism parallelism() override;
     void abort(PropagatorJob::AbortType abortType) override
@@ -389,6 +459,13 @@ public:
     const SyncOptions &syncOptions() const;
     void setSyncOptions(const SyncOptions &syncOptions);
 
+    /** Whether the checksums of @a item are computed with background priority
+     *
+     * Small files and the hydration of virtual files requested by the user
+     * are handled at normal priority.
+     */
+    bool useBackgroundPriority(const SyncFileItem &item) const;
+
     int _downloadLimit = 0;
     int _uploadLimit = 0;
     BandwidthManager _bandwidthManager;
@@ -401,7 +478,7 @@ public:
         Jobs add themself to the list when they do an assynchronous operation.
         Jobs can be several time on the list (example, when several chunks are uploaded in parallel)
      */
-    QList<PropagateItemJob *> _activeJobList;
+    QList<PropagatorJob *> _activeJobList;
 
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded;
@@ -465,6 +542,15 @@ public:
      */
     PropagateItemJob *createJob(const SyncFileItemPtr &item);
 
+    /** Creates the job for a directory collected in start().
+     *
+     * The contents of the directory are handed over to the job and the
+     * node is released.
+     */
+    PropagateDirectory *createDirectoryJob(int directoryNode);
+
+    PropagateRootDirectory *rootJob() const { return _rootJob.data(); } // for the test
+
     void scheduleNextJob();
     void reportProgress(const SyncFileItem &, qint64 bytes);
     void reportFileTotal(const SyncFileItem &item, qint64 newSize);
@@ -560,6 +646,21 @@ signals:
     void insufficientRemoteStorage();
 
 private:
+    /** Plain description of a directory and its contents.
+     *
+     * Directories are collected like this in start() and only become
+     * PropagateDirectory jobs when the scheduler reaches them, so that
+     * the number of job objects alive is bounded by the directories in
+     * flight instead of all directories of the sync.
+     */
+    struct DirectoryNode
+    {
+        SyncFileItemPtr item;
+        QVector<int> subDirectories;
+        QVector<SyncFileItemPtr> tasks; // sorted by destination
+    };
+    std::vector<DirectoryNode> _directoryNodes;
+
     AccountPtr _account;
     QScopedPointer<PropagateRootDirectory> _rootJob;
     SyncOptions _syncOptions;
@@ -0,0 +1,561 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "config.h"
+#include "propagatebulkdownload.h"
+
+#include "account.h"
+#include "common/asserts.h"
+#include "common/syncjournaldb.h"
+#include "filesystem.h"
+#include "propagatedownload.h"
+
+#include <QLoggingCategory>
+#include <QUrlQuery>
+
+#include <algorithm>
+#include <utility>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcBulkDownload, "sync.propagator.bulkdownload", QtInfoMsg)
+
+QString OWNCLOUDSYNC_EXPORT createDownloadTmpFileName(const QString &previous);
+
+namespace {
+    /// Requests the archive of the files with the given ids
+    class GETArchiveJob : public GETFileJob
+    {
+    public:
+        GETArchiveJob(AccountPtr account, const QUrl &url, const QUrlQuery &query, QIODevice *device, QObject *parent)
+            : GETFileJob(account, url, {}, device, {}, {}, 0, parent)
+        {
+            setQuery(query);
+            setEtagRequired(false);
+        }
+    };
+
+    /// Parses the octal or, for large values, base-256 numbers of a tar header
+    qint64 parseTarNumber(const QByteArray &block, int offset, int length)
+    {
+        const auto *p = reinterpret_cast<const unsigned char *>(block.constData()) + offset;
+        qint64 value = 0;
+        if (p[0] & 0x80) {
+            value = p[0] & 0x7f;
+            for (int i = 1; i < length; ++i) {
+                if (value >> 55) {
+                    return -1;
+                }
+                value = (value << 8) | p[i];
+            }
+            return value;
+        }
+        int i = 0;
+        while (i < length && (p[i] == ' ' || p[i] == '\0')) {
+            ++i;
+        }
+        for (; i < length && p[i] >= '0' && p[i] <= '7'; ++i) {
+            value = value * 8 + (p[i] - '0');
+        }
+        return value;
+    }
+
+    QString parseTarString(const QByteArray &block, int offset, int length)
+    {
+        const char *p = block.constData() + offset;
+        return QString::fromUtf8(p, static_cast<int>(qstrnlen(p, length)));
+    }
+}
+
+/**
+ * @brief Unpacks a tar archive while it is written, see PropagateBulkDownload
+ *
+ * Understands ustar, pax and GNU long names, which covers what archivers
+ * send for regular files. Only regular files are passed on, everything else
+ * is skipped.
+ */
+class TarExtractor : public QIODevice
+{
+public:
+    explicit TarExtractor(PropagateBulkDownload *receiver)
+        : _receiver(receiver)
+    {
+    }
+
+    /// Whether the end of the archive was seen
+    bool isComplete() const { return _state == State::End; }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    static constexpr int BlockSize = 512;
+    // pax records and long names are small, don't buffer arbitrary amounts of data
+    static constexpr qint64 MaxExtendedHeaderSize = 64 * 1024;
+
+    enum class State {
+        Header,
+        FileData,
+        ExtendedData,
+        SkipData,
+        Padding,
+        End
+    };
+
+    bool parseHeader(const QByteArray &block);
+    void dataFinished();
+    void parsePaxRecords();
+
+    PropagateBulkDownload *_receiver;
+    State _state = State::Header;
+    /// The current header block or the data of an extended header
+    QByteArray _buffer;
+    char _extendedType = 0;
+    qint64 _remaining = 0;
+    qint64 _padding = 0;
+
+    // set by the extended headers, for the next entry
+    QString _nextName;
+    qint64 _nextSize = -1;
+};
+
+qint64 TarExtractor::writeData(const char *data, qint64 len)
+{
+    qint64 pos = 0;
+    while (pos < len && _state != State::End) {
+        const qint64 available = len - pos;
+        switch (_state) {
+        case State::Header: {
+            const qint64 n = std::min<qint64>(BlockSize - _buffer.size(), available);
+            _buffer.append(data + pos, n);
+            pos += n;
+            if (_buffer.size() == BlockSize) {
+                const QByteArray block = std::exchange(_buffer, {});
+                if (!parseHeader(block)) {
+                    setErrorString(PropagateBulkDownload::tr("The archive sent by the server is damaged"));
+                    return -1;
+                }
+            }
+            break;
+        }
+        case State::Padding: {
+            const qint64 n = std::min(_padding, available);
+            _padding -= n;
+            pos += n;
+            if (_padding == 0) {
+                _state = State::Header;
+            }
+            break;
+        }
+        default: {
+            const qint64 n = std::min(_remaining, available);
+            if (_state == State::FileData) {
+                _receiver->entryData(data + pos, n);
+            } else if (_state == State::ExtendedData) {
+                _buffer.append(data + pos, n);
+            }
+            _remaining -= n;
+            pos += n;
+            if (_remaining == 0) {
+                dataFinished();
+            }
+            break;
+        }
+        }
+    }
+    // whatever follows the end of the archive is ignored
+    return len;
+}
+
+bool TarExtractor::parseHeader(const QByteArray &block)
+{
+    const auto *h = reinterpret_cast<const unsigned char *>(block.constData());
+    if (std::all_of(h, h + BlockSize, [](unsigned char c) { return c == 0; })) {
+        _state = State::End;
+        return true;
+    }
+
+    // the checksum is computed with its own field taken as spaces
+    qint64 sum = 0;
+    for (int i = 0; i < BlockSize; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    }
+    if (parseTarNumber(block, 148, 8) != sum) {
+        qCWarning(lcBulkDownload) << "Invalid tar header checksum";
+        return false;
+    }
+
+    qint64 size = parseTarNumber(block, 124, 12);
+    if (size < 0) {
+        return false;
+    }
+    const char type = block.at(156);
+    if (type == 'x' || type == 'L') {
+        // pax extended header or GNU long name for the next entry
+        if (size > MaxExtendedHeaderSize) {
+            qCWarning(lcBulkDownload) << "Extended tar header too large" << size;
+            return false;
+        }
+        _extendedType = type;
+        _state = State::ExtendedData;
+    } else if (type == 'g') {
+        // global pax header, nothing we need
+        _state = State::SkipData;
+    } else {
+        QString name = std::exchange(_nextName, {});
+        if (name.isEmpty()) {
+            name = parseTarString(block, 0, 100);
+            const QString prefix = block.mid(257, 5) == "ustar" ? parseTarString(block, 345, 155) : QString();
+            if (!prefix.isEmpty()) {
+                name = prefix + QLatin1Char('/') + name;
+            }
+        }
+        if (_nextSize >= 0) {
+            size = std::exchange(_nextSize, -1);
+        }
+        const bool regularFile = type == '0' || type == '\0' || type == '7';
+        _state = regularFile && _receiver->entryStarted(name, size) ? State::FileData : State::SkipData;
+    }
+
+    _remaining = size;
+    _padding = (BlockSize - size % BlockSize) % BlockSize;
+    if (_remaining == 0) {
+        dataFinished();
+    }
+    return true;
+}
+
+void TarExtractor::dataFinished()
+{
+    if (_state == State::FileData) {
+        _receiver->entryFinished();
+    } else if (_state == State::ExtendedData) {
+        if (_extendedType == 'L') {
+            _nextName = parseTarString(_buffer, 0, _buffer.size());
+        } else {
+            parsePaxRecords();
+        }
+        _buffer.clear();
+    }
+    _state = _padding > 0 ? State::Padding : State::Header;
+}
+
+void TarExtractor::parsePaxRecords()
+{
+    // "<length> <key>=<value>\n", the length includes the whole record
+    int pos = 0;
+    while (pos < _buffer.size()) {
+        const int space = _buffer.indexOf(' ', pos);
+        if (space < 0) {
+            return;
+        }
+        bool ok;
+        const int length = _buffer.mid(pos, space - pos).toInt(&ok);
+        if (!ok || length <= space - pos + 1 || pos + length > _buffer.size()) {
+            return;
+        }
+        const QByteArray record = _buffer.mid(space + 1, pos + length - space - 2);
+        const int equals = record.indexOf('=');
+        if (equals > 0) {
+            const auto key = record.left(equals);
+            if (key == "path") {
+                _nextName = QString::fromUtf8(record.mid(equals + 1));
+            } else if (key == "size") {
+                _nextSize = record.mid(equals + 1).toLongLong();
+            }
+        }
+        pos += length;
+    }
+}
+
+PropagateBulkDownload::PropagateBulkDownload(OwncloudPropagator *propagator)
+    : PropagatorJob(propagator)
+{
+}
+
+PropagateBulkDownload::~PropagateBulkDownload()
+{
+    if (auto p = propagator()) {
+        // see ~PropagateItemJob
+        p->_activeJobList.removeAll(this);
+    }
+    // the jobs that were handed to the composite job are not ours anymore
+    for (const auto &entry : _entries) {
+        delete entry.job;
+    }
+}
+
+bool PropagateBulkDownload::canPropagate(OwncloudPropagator *propagator, const SyncFileItem &item)
+{
+    return item._instruction == CSYNC_INSTRUCTION_NEW
+        && item._direction == SyncFileItem::Down
+        && item._type == ItemTypeFile
+        && item._size < propagator->smallFileSize()
+        && !item._fileId.isEmpty()
+        && item._directDownloadUrl.isEmpty()
+        && propagator->account()->capabilities().archiverSupport().isValid();
+}
+
+bool PropagateBulkDownload::canAddItem(const SyncFileItem &item) const
+{
+    const auto &archiver = propagator()->account()->capabilities().archiverSupport();
+    return canPropagate(propagator(), item)
+        && count() < MaxBatchSize
+        && (archiver.maxNumFiles <= 0 || count() < archiver.maxNumFiles)
+        && (archiver.maxSize <= 0 || _totalSize + item._size <= archiver.maxSize);
+}
+
+void PropagateBulkDownload::addItem(const SyncFileItemPtr &item)
+{
+    OC_ASSERT(_state == NotYetStarted);
+    _entriesByName.insert(item->_file.mid(item->_file.lastIndexOf(QLatin1Char('/')) + 1), _entries.size());
+    _entries.push_back(Entry { new PropagateDownloadFile(propagator(), item) });
+    _totalSize += item->_size;
+}
+
+qint64 PropagateBulkDownload::committedDiskSpace() const
+{
+    return _state == Running ? _totalSize : 0;
+}
+
+bool PropagateBulkDownload::scheduleSelfOrChild()
+{
+    if (_state != NotYetStarted) {
+        return false;
+    }
+    _state = Running;
+    if (propagator()->_abortRequested) {
+        return true;
+    }
+
+    // Partial downloads are resumed and low disk space is reported by the single downloads
+    const bool diskSpaceOk = propagator()->diskSpaceCheck() == OwncloudPropagator::DiskSpaceOk;
+    QUrlQuery query;
+    int requested = 0;
+    for (auto &entry : _entries) {
+        const auto &item = *entry.job->_item;
+        if (diskSpaceOk && !propagator()->_journal->getDownloadInfo(item._file)._valid) {
+            query.addQueryItem(QStringLiteral("id"), QString::fromUtf8(QUrl::toPercentEncoding(QString::fromUtf8(item._fileId))));
+            ++requested;
+
+            // like a single download, so the file is cleaned up if we don't get to finish it
+            entry.tmpFileName = createDownloadTmpFileName(item._file);
+            SyncJournalDb::DownloadInfo pi;
+            pi._etag = item._etag;
+            pi._tmpfile = entry.tmpFileName;
+            pi._valid = true;
+            propagator()->_journal->setDownloadInfo(item._file, pi);
+        } else {
+            _entriesByName.remove(item._file.mid(item._file.lastIndexOf(QLatin1Char('/')) + 1));
+        }
+    }
+    if (requested == 0) {
+        finish();
+        return true;
+    }
+    propagator()->_journal->commit(QStringLiteral("bulk download start"));
+    query.addQueryItem(QStringLiteral("output-format"), QStringLiteral("tar"));
+
+    qCInfo(lcBulkDownload) << "Fetching" << requested << "files in one archive";
+    _extractor = std::make_unique<TarExtractor>(this);
+    _extractor->open(QIODevice::WriteOnly);
+    const QUrl url = propagator()->account()->url().resolved(QUrl(propagator()->account()->capabilities().archiverSupport().archiverUrl));
+    _job = new GETArchiveJob(propagator()->account(), url, query, _extractor.get(), this);
+    _job->setBandwidthManager(&propagator()->_bandwidthManager);
+    connect(_job.data(), &GETJob::finishedSignal, this, &PropagateBulkDownload::slotGetFinished);
+    propagator()->_activeJobList.append(this);
+    _job->start();
+    return true;
+}
+
+void PropagateBulkDownload::slotGetFinished()
+{
+    propagator()->_activeJobList.removeOne(this);
+
+    if (_job->reply()->error() != QNetworkReply::NoError) {
+        qCWarning(lcBulkDownload) << "Archive download failed:" << _job->errorString();
+    } else if (!_extractor->isComplete()) {
+        qCWarning(lcBulkDownload) << "The archive is incomplete";
+    }
+    // the entry that was cut off, if any
+    discardCurrentEntry();
+    finish();
+}
+
+bool PropagateBulkDownload::entryStarted(const QString &name, qint64 size)
+{
+    // the entries are named relative to the common parent of the requested files
+    const auto it = _entriesByName.constFind(name.mid(name.lastIndexOf(QLatin1Char('/')) + 1));
+    if (it == _entriesByName.cend()) {
+        qCWarning(lcBulkDownload) << "Unexpected archive entry" << name;
+        return false;
+    }
+    auto &entry = _entries[it.value()];
+    const auto &item = *entry.job->_item;
+    if (entry.received || entry.tmpFileName.isEmpty()) {
+        return false;
+    }
+    if (size != item._size) {
+        // changed on the server since the discovery, the single download fetches the new version
+        qCInfo(lcBulkDownload) << "Size of" << item._file << "changed from" << item._size << "to" << size;
+        return false;
+    }
+
+    _currentFile.setFileName(propagator()->fullLocalPath(entry.tmpFileName));
+    if (!_currentFile.open(QIODevice::WriteOnly)) {
+        qCWarning(lcBulkDownload) << "Could not open temporary file" << _currentFile.fileName() << _currentFile.errorString();
+        return false;
+    }
+    FileSystem::setFileHidden(_currentFile.fileName(), true);
+    _currentEntry = &entry;
+
+    // validate the checksum of the discovery and compute the content checksum
+    _checksums.clear();
+    for (const auto &type : { parseChecksumHeaderType(item._checksumHeader), propagator()->account()->capabilities().preferredUploadChecksumType() }) {
+        if (type.isEmpty() || std::any_of(_checksums.cbegin(), _checksums.cend(), [&type](const auto &c) { return c->checksumType() == type; })) {
+            continue;
+        }
+        auto checksum = std::make_unique<StreamingChecksum>(type);
+        if (checksum->isValid()) {
+            _checksums.push_back(std::move(checksum));
+        }
+    }
+    return true;
+}
+
+void PropagateBulkDownload::entryData(const char *data, qint64 size)
+{
+    if (!_currentEntry) {
+        return;
+    }
+    if (_currentFile.write(data, size) != size) {
+        qCWarning(lcBulkDownload) << "Error writing" << _currentFile.fileName() << _currentFile.errorString();
+        discardCurrentEntry();
+        return;
+    }
+    for (const auto &checksum : _checksums) {
+        checksum->addData(data, size);
+    }
+}
+
+void PropagateBulkDownload::entryFinished()
+{
+    if (!_currentEntry) {
+        return;
+    }
+    if (!_currentFile.flush()) {
+        qCWarning(lcBulkDownload) << "Error writing" << _currentFile.fileName() << _currentFile.errorString();
+        discardCurrentEntry();
+        return;
+    }
+    _currentFile.close();
+
+    auto &entry = *_currentEntry;
+    const auto &item = *entry.job->_item;
+    const auto expectedType = parseChecksumHeaderType(item._checksumHeader);
+    const auto contentType = propagator()->account()->capabilities().preferredUploadChecksumType();
+    QByteArray checksumHeader = item._checksumHeader;
+    for (const auto &checksum : _checksums) {
+        const auto header = makeChecksumHeader(checksum->checksumType(), checksum->result());
+        if (checksum->checksumType() == expectedType && header != item._checksumHeader) {
+            qCWarning(lcBulkDownload) << "Checksum mismatch for" << item._file << header << "!=" << item._checksumHeader;
+            discardCurrentEntry();
+            return;
+        }
+        if (checksum->checksumType() == contentType) {
+            checksumHeader = header;
+        }
+    }
+    entry.checksumHeader = checksumHeader;
+    entry.received = true;
+    _currentEntry = nullptr;
+    _checksums.clear();
+}
+
+void PropagateBulkDownload::discardCurrentEntry()
+{
+    if (!_currentEntry) {
+        return;
+    }
+    _currentFile.close();
+    FileSystem::remove(_currentFile.fileName());
+    _currentEntry = nullptr;
+    _checksums.clear();
+}
+
+void PropagateBulkDownload::discardTmpFile(Entry &entry)
+{
+    if (entry.tmpFileName.isEmpty()) {
+        return;
+    }
+    const QString tmpFile = propagator()->fullLocalPath(entry.tmpFileName);
+    if (FileSystem::fileExists(tmpFile)) {
+        FileSystem::remove(tmpFile);
+    }
+    propagator()->_journal->setDownloadInfo(entry.job->_item->_file, SyncJournalDb::DownloadInfo());
+    entry.tmpFileName.clear();
+}
+
+void PropagateBulkDownload::finish()
+{
+    if (propagator()->_abortRequested) {
+        for (auto &entry : _entries) {
+            discardTmpFile(entry);
+        }
+        propagator()->_journal->commit(QStringLiteral("bulk download"));
+        _state = Finished;
+        emit finished(SyncFileItem::NormalError);
+        return;
+    }
+
+    int fetched = 0;
+    for (auto &entry : _entries) {
+        if (!entry.received) {
+            // fall back to a single download
+            discardTmpFile(entry);
+            _associatedComposite->appendJob(std::exchange(entry.job, nullptr));
+            continue;
+        }
+        auto *job = entry.job;
+        ++fetched;
+        job->_bulkTmpFileName = entry.tmpFileName;
+        job->_item->_checksumHeader = entry.checksumHeader;
+        job->setAssociatedComposite(_associatedComposite);
+        // nothing left that needs the network, the job finishes right away
+        job->scheduleSelfOrChild();
+        OC_ASSERT(job->_state == Finished);
+        if (job->_item->hasErrorStatus() && _status == SyncFileItem::Success) {
+            _status = job->_item->_status;
+        }
+        // left over if the job failed, the single download starts from scratch
+        discardTmpFile(entry);
+    }
+    propagator()->_journal->commit(QStringLiteral("bulk download"));
+    qCInfo(lcBulkDownload) << "Fetched" << fetched << "of" << _entries.size() << "files in one archive";
+
+    _state = Finished;
+    emit finished(_status);
+}
+
+void PropagateBulkDownload::abort(PropagatorJob::AbortType abortType)
+{
+    if (_job && _job->reply()) {
+        _job->reply()->abort();
+    }
+    if (abortType == AbortType::Asynchronous) {
+        emit abortFinished();
+    }
+}
+}
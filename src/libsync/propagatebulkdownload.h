@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudpropagator.h"
+#include "common/checksums.h"
+
+#include <QFile>
+#include <QHash>
+#include <QPointer>
+
+#include <memory>
+#include <vector>
+
+namespace OCC {
+
+class GETFileJob;
+class PropagateDownloadFile;
+class TarExtractor;
+
+/**
+ * @brief Downloads many new small files with a single request
+ *
+ * Instead of one GET per file, the files of a batch are requested from the
+ * server's archiver as one tar archive. The archive is unpacked while it is
+ * received, every entry is written to the temporary file of its item and
+ * validated against the size and checksum reported by the discovery.
+ *
+ * Once the archive is complete, the items that were received are finished
+ * like a normal download. The others, because they were missing, broken or
+ * the request failed, are handed back to the composite job as normal
+ * PropagateDownloadFile jobs.
+ *
+ * The archive request takes one of the propagator's transfer slots. The
+ * temporary files are recorded as DownloadInfo before the request is sent,
+ * they are cleaned up like those of a single download if the client quits.
+ *
+ * @ingroup libsync
+ */
+class PropagateBulkDownload : public PropagatorJob
+{
+    Q_OBJECT
+public:
+    /// The maximum number of files requested at once, the file ids are sent in the url
+    static constexpr int MaxBatchSize = 100;
+
+    explicit PropagateBulkDownload(OwncloudPropagator *propagator);
+    ~PropagateBulkDownload() override;
+
+    /// Whether @a item may be fetched by this job
+    static bool canPropagate(OwncloudPropagator *propagator, const SyncFileItem &item);
+
+    /// Whether @a item may be added to this batch, see the limits of the archiver
+    bool canAddItem(const SyncFileItem &item) const;
+    void addItem(const SyncFileItemPtr &item);
+    int count() const { return static_cast<int>(_entries.size()); }
+
+    bool scheduleSelfOrChild() override;
+    /// Like a single download, only a batch with little data to transfer counts as small
+    bool isLikelyFinishedQuickly() override { return _totalSize < propagator()->smallFileSize(); }
+    qint64 committedDiskSpace() const override;
+
+public slots:
+    void abort(PropagatorJob::AbortType abortType) override;
+
+private slots:
+    void slotGetFinished();
+
+private:
+    struct Entry
+    {
+        PropagateDownloadFile *job;
+        /// Relative to the sync root, set if the file is requested
+        QString tmpFileName;
+        /// The content checksum to record for the file
+        QByteArray checksumHeader;
+        bool received = false;
+    };
+
+    // called by the TarExtractor
+    bool entryStarted(const QString &name, qint64 size);
+    void entryData(const char *data, qint64 size);
+    void entryFinished();
+    /// Closes and removes the temporary file of the current entry
+    void discardCurrentEntry();
+    /// Removes the temporary file of @a entry and its download info
+    void discardTmpFile(Entry &entry);
+
+    /// Finishes the received entries and hands the others back to the composite job
+    void finish();
+
+    std::vector<Entry> _entries;
+    /// Index into _entries by file name, all items are in the same directory
+    QHash<QString, size_t> _entriesByName;
+    qint64 _totalSize = 0;
+
+    QPointer<GETFileJob> _job;
+    std::unique_ptr<TarExtractor> _extractor;
+    Entry *_currentEntry = nullptr;
+    QFile _currentFile;
+    std::vector<std::unique_ptr<StreamingChecksum>> _checksums;
+
+    SyncFileItem::Status _status = SyncFileItem::Success;
+
+    friend class TarExtractor;
+};
+}
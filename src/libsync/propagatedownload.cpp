@@ -31,6 +31,7 @@
 #include <QLoggingCategory>
 #include <QNetworkAccessManager>
 #include <QRandomGenerator>
+#include <QtConcurrent>
 
 #include <cmath>
 
@@ -121,6 +122,8 @@ void GETFileJob::newReplyHook(QNetworkReply *reply)
     connect(reply, &QIODevice::readyRead, this, &GETFileJob::slotReadyRead);
     connect(reply, &QNetworkReply::finished, this, &GETFileJob::slotReadyRead);
     connect(reply, &QNetworkReply::downloadProgress, this, &GETFileJob::downloadProgress);
+    _streamingChecksums.clear();
+    _pageCacheReleaser.reset();
 }
 
 void GETFileJob::slotMetaDataChanged()
@@ -155,7 +158,7 @@ void GETFileJob::slotMetaDataChanged()
     }
     _etag = getEtagFromReply(reply());
 
-    if (_etag.isEmpty()) {
+    if (_etag.isEmpty() && _etagRequired) {
         qCWarning(lcGetJob) << "No E-Tag reply by server, considering it invalid";
         _errorString = tr("No E-Tag received from server, check Proxy/Gateway");
         _errorStatus = SyncFileItem::NormalError;
@@ -214,9 +217,56 @@ void GETFileJob::slotMetaDataChanged()
         _lastModified = Utility::qDateTimeToTime_t(lastModified.toDateTime());
     }
 
+    // The part of a resumed download that is already on disk would have to be read again
+    if (_resumeStart == 0) {
+        startStreamingChecksums();
+    }
+
+    if (_releasePageCache) {
+        if (auto file = qobject_cast<QFile *>(_device)) {
+            _pageCacheReleaser = std::make_unique<FileSystem::PageCacheReleaser>(file, FileSystem::PageCacheReleaser::Mode::Write, file->pos());
+        }
+    }
+
     _saveBodyToFile = true;
 }
 
+void GETFileJob::startStreamingChecksums()
+{
+    _streamingChecksums.clear();
+    auto types = _streamingChecksumTypes;
+    const auto transmissionChecksumType = parseChecksumHeaderType(transmissionChecksumHeader());
+    if (!transmissionChecksumType.isEmpty() && !types.contains(transmissionChecksumType)) {
+        types.append(transmissionChecksumType);
+    }
+    for (const auto &type : qAsConst(types)) {
+        auto checksum = std::make_unique<StreamingChecksum>(type);
+        if (checksum->isValid()) {
+            _streamingChecksums.push_back(std::move(checksum));
+        }
+    }
+}
+
+QByteArray GETFileJob::transmissionChecksumHeader() const
+{
+    auto checksumHeader = findBestChecksum(reply()->rawHeader(checkSumHeaderC));
+    const auto contentMd5Header = reply()->rawHeader(contentMd5HeaderC);
+    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty()) {
+        checksumHeader = "MD5:" + contentMd5Header;
+    }
+    return checksumHeader;
+}
+
+QByteArray GETFileJob::streamedChecksum(const QByteArray &checksumType) const
+{
+    for (const auto &checksum : _streamingChecksums) {
+        if (checksum->checksumType() == checksumType) {
+            return checksum->result();
+        }
+    }
+    return QByteArray();
+}
+
 void GETJob::setBandwidthManager(BandwidthManager *bwm)
 {
     _bandwidthManager = bwm;
@@ -288,6 +338,12 @@ void GETFileJob::slotReadyRead()
             reply()->abort();
             return;
         }
+        for (const auto &checksum : _streamingChecksums) {
+            checksum->addData(buffer.constData(), r);
+        }
+        if (_pageCacheReleaser) {
+            _pageCacheReleaser->advance(_device->pos());
+        }
     }
 
     if (reply()->isFinished() && (reply()->bytesAvailable() == 0 || !_saveBodyToFile)) {
@@ -295,6 +351,11 @@ void GETFileJob::slotReadyRead()
         if (_bandwidthManager) {
             _bandwidthManager->unregisterDownloadJob(this);
         }
+        if (_pageCacheReleaser) {
+            // the device belongs to the caller, it may be gone after finishedSignal
+            _pageCacheReleaser->finish();
+            _pageCacheReleaser.reset();
+        }
         if (!_hasEmittedFinishedSignal) {
             qCInfo(lcGetJob) << "GET of" << reply()->request().url().toString() << "FINISHED WITH STATUS"
                              << replyStatusString()
@@ -372,12 +433,11 @@ void PropagateDownloadFile::start()
             done(SyncFileItem::NormalError, tr("File %1 can not be downloaded because of a local file name clash with %2!").arg(QDir::toNativeSeparators(_item->_file), QDir::toNativeSeparators(clash.get())));
             return;
         }
-        auto r = vfs->createPlaceholder(*_item);
-        if (!r) {
-            done(SyncFileItem::NormalError, r.error());
+        if (_bulkPlaceholder) {
+            // PropagateVirtualFiles creates the placeholder and calls placeholderCreated()
             return;
         }
-        updateMetadata(false);
+        placeholderCreated(vfs->createPlaceholder(*_item));
         return;
     }
 
@@ -409,8 +469,12 @@ void PropagateDownloadFile::start()
         qCDebug(lcPropagateDownload) << _item->_file << "may not need download, computing checksum";
         auto computeChecksum = new ComputeChecksum(this);
         computeChecksum->setChecksumType(parseChecksumHeaderType(_item->_checksumHeader));
+        computeChecksum->setChecksumCache(propagator()->_journal);
+        computeChecksum->setBackgroundPriority(propagator()->useBackgroundPriority(*_item));
+        computeChecksum->setReleasePageCache(propagator()->syncOptions().releasePageCache(_item->_size));
         connect(computeChecksum, &ComputeChecksum::done,
             this, &PropagateDownloadFile::conflictChecksumComputed);
+        traceChecksum(computeChecksum, QStringLiteral("ConflictChecksum"));
         propagator()->_activeJobList.append(this);
         computeChecksum->start(propagator()->fullLocalPath(_item->_file));
         return;
@@ -460,6 +524,13 @@ void PropagateDownloadFile::startDownload()
     }
     propagator()->reportProgress(*_item, 0);
 
+    if (!_bulkTmpFileName.isEmpty()) {
+        // PropagateBulkDownload fetched and validated the file already
+        _tmpFile.setFileName(propagator()->fullLocalPath(_bulkTmpFileName));
+        downloadFinished();
+        return;
+    }
+
     QString tmpFileName;
     const SyncJournalDb::DownloadInfo progressInfo = propagator()->_journal->getDownloadInfo(_item->_file);
     if (progressInfo._valid) {
@@ -556,8 +627,15 @@ void PropagateDownloadFile::startFullDownload()
             &_tmpFile, headers, _expectedEtagForResume, _resumeStart, this);
     }
     _job->setBandwidthManager(&propagator()->_bandwidthManager);
+    auto getFileJob = qobject_cast<GETFileJob *>(_job.data());
+    // the transmission checksum is validated and the content checksum is computed without reading the file again
+    const QByteArray contentChecksumType = propagator()->account()->capabilities().preferredUploadChecksumType();
+    if (!contentChecksumType.isEmpty()) {
+        getFileJob->setStreamingChecksumTypes({ contentChecksumType });
+    }
+    getFileJob->setReleasePageCache(propagator()->syncOptions().releasePageCache(_item->_size));
     connect(_job.data(), &GETJob::finishedSignal, this, &PropagateDownloadFile::slotGetFinished);
-    connect(qobject_cast<GETFileJob *>(_job.data()), &GETFileJob::downloadProgress,
+    connect(getFileJob, &GETFileJob::downloadProgress,
         this, &PropagateDownloadFile::slotDownloadProgress);
     propagator()->_activeJobList.append(this);
     _job->start();
@@ -741,11 +819,18 @@ void PropagateDownloadFile::slotGetFinished()
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
-    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
-        checksumHeader = "MD5:" + contentMd5Header;
-    validator->start(_tmpFile.fileName(), checksumHeader);
+    SyncTracer::endOn(SyncTracer::instance()->begin("checksum", QStringLiteral("ValidateChecksum"), propagator()->localPath(), _item->_file),
+        validator, this, &ValidateChecksumHeader::validated, &ValidateChecksumHeader::validationFailed);
+    auto getFileJob = qobject_cast<GETFileJob *>(job);
+    const auto checksumHeader = getFileJob->transmissionChecksumHeader();
+    const auto checksumType = parseChecksumHeaderType(checksumHeader);
+    const auto streamedChecksum = getFileJob->streamedChecksum(checksumType);
+    _streamedContentChecksum = getFileJob->streamedChecksum(propagator()->account()->capabilities().preferredUploadChecksumType());
+    if (!streamedChecksum.isEmpty()) {
+        validator->validate(checksumHeader, checksumType, streamedChecksum);
+    } else {
+        validator->start(_tmpFile.fileName(), checksumHeader);
+    }
 }
 
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg)
@@ -862,6 +947,9 @@ void PropagateDownloadFile::transmissionChecksumValidated(const QByteArray &chec
     if (theContentChecksumType == checksumType || theContentChecksumType.isEmpty()) {
         return contentChecksumComputed(checksumType, checksum);
     }
+    if (!_streamedContentChecksum.isEmpty()) {
+        return contentChecksumComputed(theContentChecksumType, _streamedContentChecksum);
+    }
 
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
@@ -869,6 +957,7 @@ void PropagateDownloadFile::transmissionChecksumValidated(const QByteArray &chec
 
     connect(computeChecksum, &ComputeChecksum::done,
         this, &PropagateDownloadFile::contentChecksumComputed);
+    traceChecksum(computeChecksum, QStringLiteral("ContentChecksum"));
     computeChecksum->start(_tmpFile.fileName());
 }
 
@@ -894,7 +983,13 @@ void PropagateDownloadFile::downloadFinished()
     FileSystem::setModTime(_tmpFile.fileName(), _item->_modtime);
     // We need to fetch the time again because some file systems such as FAT have worse than a second
     // Accuracy, and we really need the time from the file system. (#3103)
-    _item->_modtime = FileSystem::getModTime(_tmpFile.fileName());
+    // The rename below keeps the size and the inode, they are used for the journal.
+    FileSystem::FileStat tmpStat;
+    if (FileSystem::getFileStat(_tmpFile.fileName(), &tmpStat)) {
+        _item->_modtime = tmpStat.modtime;
+    } else {
+        _item->_modtime = FileSystem::getModTime(_tmpFile.fileName());
+    }
 
     bool previousFileExists = FileSystem::fileExists(fn);
     if (previousFileExists) {
@@ -965,7 +1060,13 @@ void PropagateDownloadFile::downloadFinished()
 
     // Maybe we downloaded a newer version of the file than we thought we would...
     // Get up to date information for the journal.
-    _item->_size = FileSystem::getSize(fn);
+    if (tmpStat.size >= 0) {
+        _item->_size = tmpStat.size;
+        _item->_inode = tmpStat.inode;
+        _item->_localStatIsCurrent = true;
+    } else {
+        _item->_size = FileSystem::getSize(fn);
+    }
 
     // Maybe what we downloaded was a conflict file? If so, set a conflict record.
     // (the data was prepared in slotGetFinished above)
@@ -1016,7 +1117,10 @@ void PropagateDownloadFile::updateMetadata(bool isConflict)
         return;
     }
     propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
-    propagator()->_journal->commit(QStringLiteral("download file start2"));
+    if (!_bulkPlaceholder && _bulkTmpFileName.isEmpty()) {
+        // PropagateVirtualFiles and PropagateBulkDownload commit once for the whole batch
+        propagator()->_journal->commit(QStringLiteral("download file start2"));
+    }
 
     done(isConflict ? SyncFileItem::Conflict : SyncFileItem::Success);
 
@@ -1034,6 +1138,15 @@ void PropagateDownloadFile::updateMetadata(bool isConflict)
     }
 }
 
+void PropagateDownloadFile::placeholderCreated(const Result<void, QString> &result)
+{
+    if (!result) {
+        done(SyncFileItem::NormalError, result.error());
+        return;
+    }
+    updateMetadata(false);
+}
+
 void PropagateDownloadFile::slotDownloadProgress(qint64 received, qint64)
 {
     if (!_job)
@@ -1053,4 +1166,116 @@ void PropagateDownloadFile::abort(PropagatorJob::AbortType abortType)
         emit abortFinished();
     }
 }
+
+PropagateVirtualFiles::PropagateVirtualFiles(OwncloudPropagator *propagator)
+    : PropagatorJob(propagator)
+{
+    connect(&_watcher, &QFutureWatcherBase::finished, this, &PropagateVirtualFiles::slotPlaceholdersCreated);
+}
+
+PropagateVirtualFiles::~PropagateVirtualFiles()
+{
+    qDeleteAll(_jobs);
+}
+
+bool PropagateVirtualFiles::canPropagate(OwncloudPropagator *propagator, const SyncFileItem &item)
+{
+    return item._instruction == CSYNC_INSTRUCTION_NEW
+        && item._direction == SyncFileItem::Down
+        && item._type == ItemTypeVirtualFile
+        && propagator->syncOptions()._vfs->mode() != Vfs::Off;
+}
+
+void PropagateVirtualFiles::addItem(const SyncFileItemPtr &item)
+{
+    OC_ASSERT(_state == NotYetStarted);
+    auto job = new PropagateDownloadFile(propagator(), item);
+    job->_bulkPlaceholder = true;
+    _jobs.push_back(job);
+}
+
+bool PropagateVirtualFiles::scheduleSelfOrChild()
+{
+    if (_state != NotYetStarted) {
+        return false;
+    }
+    _state = Running;
+    if (propagator()->_abortRequested) {
+        return true;
+    }
+    qCInfo(lcPropagateDownload) << "Creating" << _jobs.size() << "placeholders in bulk";
+
+    // The checks of the items are done right away, only the placeholders are created in the thread
+    std::vector<SyncFileItemPtr> items;
+    for (auto *job : _jobs) {
+        job->scheduleSelfOrChild();
+        if (job->_state == Finished) {
+            if (job->_item->hasErrorStatus() && _status == SyncFileItem::Success) {
+                _status = job->_item->_status;
+            }
+        } else {
+            _pendingJobs.push_back(job);
+            items.push_back(job->_item);
+        }
+    }
+    if (_pendingJobs.empty()) {
+        _state = Finished;
+        emit finished(_status);
+        return true;
+    }
+
+    auto vfs = propagator()->syncOptions()._vfs;
+    auto createPlaceholders = [vfs, items = std::move(items)] {
+        std::vector<Result<void, QString>> results;
+        results.reserve(items.size());
+        for (const auto &item : items) {
+            results.push_back(vfs->createPlaceholder(*item));
+        }
+        return results;
+    };
+    if (vfs->canCreatePlaceholdersInThread()) {
+        _watcher.setFuture(QtConcurrent::run(std::move(createPlaceholders)));
+    } else {
+        // the plugin is only called from the main thread
+        finishPlaceholders(createPlaceholders());
+    }
+    return true;
+}
+
+void PropagateVirtualFiles::slotPlaceholdersCreated()
+{
+    finishPlaceholders(_watcher.result());
+}
+
+void PropagateVirtualFiles::finishPlaceholders(const std::vector<Result<void, QString>> &results)
+{
+    OC_ASSERT(results.size() == _pendingJobs.size());
+    for (size_t i = 0; i < _pendingJobs.size(); ++i) {
+        auto *job = _pendingJobs[i];
+        job->placeholderCreated(results[i]);
+        if (job->_item->hasErrorStatus() && _status == SyncFileItem::Success) {
+            _status = job->_item->_status;
+        }
+    }
+    propagator()->_journal->commit(QStringLiteral("bulk placeholders"));
+
+    _state = Finished;
+    emit finished(_status);
+}
+
+void PropagateVirtualFiles::abort(PropagatorJob::AbortType abortType)
+{
+    if (_watcher.isRunning()) {
+        if (abortType == AbortType::Asynchronous) {
+            // the placeholders are still recorded, it doesn't take long
+            connect(&_watcher, &QFutureWatcherBase::finished, this, &PropagatorJob::abortFinished);
+        } else {
+            _watcher.waitForFinished();
+        }
+        return;
+    }
+    if (abortType == AbortType::Asynchronous) {
+        emit abortFinished();
+    }
+}
 }
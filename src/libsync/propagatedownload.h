@@ -15,9 +15,14 @@
 
 #include "owncloudpropagator.h"
 #include "networkjobs.h"
+#include "common/checksums.h"
+#include "common/filesystembase.h"
 
 #include <QBuffer>
 #include <QFile>
+#include <QFutureWatcher>
+
+#include <vector>
 
 namespace OCC {
 
@@ -76,6 +81,15 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public GETJob
     /// Will be set to true once we've seen a 2xx response header
     bool _saveBodyToFile = false;
 
+    QList<QByteArray> _streamingChecksumTypes;
+    /// Computed while the body is written, only if it is received from the start
+    std::vector<std::unique_ptr<StreamingChecksum>> _streamingChecksums;
+
+    bool _releasePageCache = false;
+    std::unique_ptr<FileSystem::PageCacheReleaser> _pageCacheReleaser;
+
+    bool _etagRequired = true;
+
 public:
     // DOES NOT take ownership of the device.
     // For directDownloadUrl:
@@ -110,6 +124,27 @@ public:
     qint64 expectedContentLength() const { return _expectedContentLength; }
     void setExpectedContentLength(qint64 size) { _expectedContentLength = size; }
 
+    /** Checksums of these types are computed while the body is written, like
+     * the one of the transmission checksum header.
+     */
+    void setStreamingChecksumTypes(const QList<QByteArray> &types) { _streamingChecksumTypes = types; }
+
+    /// The best checksum the server sent with the reply, "MD5:<Content-MD5>" as a fallback
+    QByteArray transmissionChecksumHeader() const;
+
+    /// The checksum of the whole body, empty if it was not computed while the body was received
+    QByteArray streamedChecksum(const QByteArray &checksumType) const;
+
+    /// Drop the written body from the page cache once it was written back, only if the device is a QFile
+    void setReleasePageCache(bool release) { _releasePageCache = release; }
+
+protected:
+    /// Generated bodies, like archives, come without an ETag
+    void setEtagRequired(bool required) { _etagRequired = required; }
+
+private:
+    void startStreamingChecksums();
+
 private slots:
     void slotReadyRead();
     void slotMetaDataChanged();
@@ -214,6 +249,8 @@ private slots:
 
 private:
     void deleteExistingFolder();
+    /// Called by PropagateVirtualFiles once the placeholder was created
+    void placeholderCreated(const Result<void, QString> &result);
 
     qint64 _resumeStart;
     qint64 _downloadProgress;
@@ -221,7 +258,64 @@ private:
     QFile _tmpFile;
     bool _deleteExisting;
     ConflictRecord _conflictRecord;
+    /// The content checksum computed while the file was downloaded
+    QByteArray _streamedContentChecksum;
+    /// The placeholder is created by a PropagateVirtualFiles job
+    bool _bulkPlaceholder = false;
+    /// The validated file fetched by a PropagateBulkDownload job, relative to the sync root
+    QString _bulkTmpFileName;
 
     QElapsedTimer _stopwatch;
+
+    friend class PropagateVirtualFiles;
+    friend class PropagateBulkDownload;
+};
+
+/**
+ * @brief Creates the placeholders of new virtual files in bulk
+ *
+ * The new virtual files of a directory are not propagated one by one, the
+ * placeholders of a batch are created together and their journal records are
+ * written in a single transaction. If the plugin allows it, see
+ * Vfs::canCreatePlaceholdersInThread(), they are created on a worker thread.
+ *
+ * No network request is involved, the job does not take one of the
+ * propagator's transfer slots.
+ *
+ * @ingroup libsync
+ */
+class PropagateVirtualFiles : public PropagatorJob
+{
+    Q_OBJECT
+public:
+    /// The maximum number of placeholders handled by one job
+    static constexpr int MaxBatchSize = 500;
+
+    explicit PropagateVirtualFiles(OwncloudPropagator *propagator);
+    ~PropagateVirtualFiles() override;
+
+    /// Whether the propagation of @a item can be done by this job
+    static bool canPropagate(OwncloudPropagator *propagator, const SyncFileItem &item);
+
+    void addItem(const SyncFileItemPtr &item);
+    int count() const { return static_cast<int>(_jobs.size()); }
+
+    bool scheduleSelfOrChild() override;
+    bool isLikelyFinishedQuickly() override { return true; }
+
+public slots:
+    void abort(PropagatorJob::AbortType abortType) override;
+
+private slots:
+    void slotPlaceholdersCreated();
+
+private:
+    void finishPlaceholders(const std::vector<Result<void, QString>> &results);
+
+    std::vector<PropagateDownloadFile *> _jobs;
+    /// The jobs that passed their checks and wait for their placeholder
+    std::vector<PropagateDownloadFile *> _pendingJobs;
+    QFutureWatcher<std::vector<Result<void, QString>>> _watcher;
+    SyncFileItem::Status _status = SyncFileItem::Success;
 };
 }
@@ -164,6 +164,7 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
 
     // remember the modtime before checksumming to be able to detect a file
     // change during the checksum calculation
+    const auto discoveredModtime = _item->_modtime;
     _item->_modtime = FileSystem::getModTime(filePath);
 
     const QByteArray checksumType = propagator()->account()->capabilities().preferredUploadChecksumType();
@@ -171,19 +172,33 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
     // Maybe the discovery already computed the checksum?
     QByteArray existingChecksumType, existingChecksum;
     parseChecksumHeader(_item->_checksumHeader, &existingChecksumType, &existingChecksum);
-    if (existingChecksumType == checksumType) {
+    if (existingChecksumType == checksumType && _item->_modtime == discoveredModtime) {
         slotComputeTransmissionChecksum(checksumType, existingChecksum);
         return;
     }
 
+    // The checksum is sent at the end, compute it while the data is sent
+    if (supportsTrailingChecksum() && uploadChecksumEnabled()
+        && propagator()->account()->capabilities().supportedChecksumTypes().contains(checksumType)) {
+        auto trailingChecksum = std::make_shared<UploadChecksum>(checksumType);
+        if (trailingChecksum->isValid()) {
+            _trailingChecksum = trailingChecksum;
+            slotStartUpload(QByteArray(), QByteArray());
+            return;
+        }
+    }
+
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
     computeChecksum->setChecksumType(checksumType);
+    computeChecksum->setChecksumCache(propagator()->_journal);
+    computeChecksum->setBackgroundPriority(propagator()->useBackgroundPriority(*_item));
 
     connect(computeChecksum, &ComputeChecksum::done,
         this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
+    traceChecksum(computeChecksum, QStringLiteral("ContentChecksum"));
     computeChecksum->start(filePath);
 }
 
@@ -206,11 +221,14 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray
     } else {
         computeChecksum->setChecksumType(QByteArray());
     }
+    computeChecksum->setChecksumCache(propagator()->_journal);
+    computeChecksum->setBackgroundPriority(propagator()->useBackgroundPriority(*_item));
 
     connect(computeChecksum, &ComputeChecksum::done,
         this, &PropagateUploadFileCommon::slotStartUpload);
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
+    traceChecksum(computeChecksum, QStringLiteral("TransmissionChecksum"));
     const QString filePath = propagator()->fullLocalPath(_item->_file);
     computeChecksum->start(filePath);
 }
@@ -230,11 +248,12 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
 
     const QString fullFilePath = propagator()->fullLocalPath(_item->_file);
 
-    if (!FileSystem::fileExists(fullFilePath)) {
+    FileSystem::FileStat stat;
+    if (!FileSystem::getFileStat(fullFilePath, &stat)) {
         done(SyncFileItem::SoftError, tr("File Removed"));
         return;
     }
-    _item->_size = FileSystem::getSize(fullFilePath);
+    _item->_size = stat.size;
 
     const time_t prevModtime = _item->_modtime; // the _item value was set in PropagateUploadFile::start()
     // but a potential checksum calculation could have taken some time during which the file could
@@ -243,7 +262,7 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
     // But skip the file if the mtime is too close to 'now'!
     // That usually indicates a file that is still being changed
     // or not yet fully copied to the destination.
-    _item->_modtime = FileSystem::getModTime(fullFilePath);
+    _item->_modtime = stat.modtime;
     if (prevModtime != _item->_modtime || fileIsStillChanging(*_item)) {
         propagator()->_anotherSyncNeeded = true;
         done(SyncFileItem::Message, tr("Local file changed during sync. It will be resumed."));
@@ -253,6 +272,75 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
     doStartUpload();
 }
 
+void PropagateUploadFileCommon::finishTrailingChecksum(const std::function<void()> &callback)
+{
+    const auto checksumType = _trailingChecksum->checksumType();
+    const auto checksum = _trailingChecksum->result(_item->_size);
+    _trailingChecksum.reset();
+    if (!checksum.isEmpty()) {
+        setTrailingChecksumHeader(makeChecksumHeader(checksumType, checksum));
+        callback();
+        return;
+    }
+
+    // The upload was resumed, the data sent by the previous attempt was not hashed
+    propagator()->_activeJobList.append(this);
+    auto computeChecksum = new ComputeChecksum(this);
+    computeChecksum->setChecksumType(checksumType);
+    computeChecksum->setChecksumCache(propagator()->_journal);
+    computeChecksum->setBackgroundPriority(propagator()->useBackgroundPriority(*_item));
+    // the file was sent already
+    computeChecksum->setReleasePageCache(propagator()->syncOptions().releasePageCache(_item->_size));
+    connect(computeChecksum, &ComputeChecksum::done, this, [this, callback](const QByteArray &type, const QByteArray &checksum) {
+        propagator()->_activeJobList.removeOne(this);
+        if (propagator()->_abortRequested) {
+            return;
+        }
+        setTrailingChecksumHeader(makeChecksumHeader(type, checksum));
+        callback();
+    });
+    connect(computeChecksum, &ComputeChecksum::done,
+        computeChecksum, &QObject::deleteLater);
+    traceChecksum(computeChecksum, QStringLiteral("ContentChecksum"));
+    computeChecksum->start(propagator()->fullLocalPath(_item->_file));
+}
+
+void PropagateUploadFileCommon::setTrailingChecksumHeader(const QByteArray &checksumHeader)
+{
+    _transmissionChecksumHeader = checksumHeader;
+    _item->_checksumHeader = checksumHeader;
+
+    // The upload info was stored without the checksum. If the reply to the last
+    // request gets lost, the next discovery compares it with the server's (#5106)
+    auto uploadInfo = propagator()->_journal->getUploadInfo(_item->_file);
+    if (uploadInfo._valid) {
+        uploadInfo._contentChecksum = checksumHeader;
+        propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
+        propagator()->_journal->commit(QStringLiteral("Upload info"));
+    }
+}
+
+void UploadChecksum::addData(qint64 offset, const char *data, qint64 length)
+{
+    // a gap, the checksum can't be completed anymore
+    if (offset > _hashedSize) {
+        return;
+    }
+    const qint64 alreadyHashed = _hashedSize - offset;
+    if (length > alreadyHashed) {
+        _checksum.addData(data + alreadyHashed, length - alreadyHashed);
+        _hashedSize += length - alreadyHashed;
+    }
+}
+
+QByteArray UploadChecksum::result(qint64 size) const
+{
+    if (_hashedSize != size) {
+        return QByteArray();
+    }
+    return _checksum.result();
+}
+
 UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm)
     : _file(fileName)
     , _start(start)
@@ -270,6 +358,9 @@ UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, B
 
 UploadDevice::~UploadDevice()
 {
+    if (_pageCacheReleaser) {
+        _pageCacheReleaser->finish();
+    }
     if (_bandwidthManager) {
         _bandwidthManager->unregisterUploadDevice(this);
     }
@@ -292,12 +383,19 @@ bool UploadDevice::open(QIODevice::OpenMode mode)
 
     _size = qBound(0ll, _size, fileDiskSize - _start);
     _read = 0;
+    if (_releasePageCache) {
+        _pageCacheReleaser = std::make_unique<FileSystem::PageCacheReleaser>(&_file, FileSystem::PageCacheReleaser::Mode::Read, _start);
+    }
 
     return QIODevice::open(mode);
 }
 
 void UploadDevice::close()
 {
+    if (_pageCacheReleaser) {
+        _pageCacheReleaser->finish();
+        _pageCacheReleaser.reset();
+    }
     _file.close();
     QIODevice::close();
 }
@@ -337,7 +435,13 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
         setErrorString(_file.errorString());
         return -1;
     }
+    if (_uploadChecksum) {
+        _uploadChecksum->addData(_start + _read, data, c);
+    }
     _read += c;
+    if (_pageCacheReleaser) {
+        _pageCacheReleaser->advance(_start + _read);
+    }
     return c;
 }
 
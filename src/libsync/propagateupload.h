@@ -15,11 +15,15 @@
 
 #include "owncloudpropagator.h"
 #include "networkjobs.h"
+#include "common/checksums.h"
+#include "common/filesystembase.h"
 
 #include <QBuffer>
 #include <QFile>
 #include <QElapsedTimer>
 
+#include <memory>
+
 namespace OCC {
 
 Q_DECLARE_LOGGING_CATEGORY(lcPutJob)
@@ -29,6 +33,36 @@ Q_DECLARE_LOGGING_CATEGORY(lcPropagateUploadNG)
 
 class BandwidthManager;
 
+/**
+ * @brief Computes the checksum of an upload from the data that is sent
+ *
+ * The devices of all chunks add their data. Only the part that is contiguous
+ * from the start of the file is hashed: data that is read again after a seek
+ * is skipped and the gap of a resumed upload leaves the checksum incomplete.
+ * @ingroup libsync
+ */
+class UploadChecksum
+{
+public:
+    explicit UploadChecksum(const QByteArray &checksumType)
+        : _checksum(checksumType)
+    {
+    }
+
+    bool isValid() const { return _checksum.isValid(); }
+    QByteArray checksumType() const { return _checksum.checksumType(); }
+
+    /// Adds the data at @a offset in the file
+    void addData(qint64 offset, const char *data, qint64 length);
+
+    /// The checksum of the file if its @a size bytes were all added, empty otherwise
+    QByteArray result(qint64 size) const;
+
+private:
+    StreamingChecksum _checksum;
+    qint64 _hashedSize = 0;
+};
+
 /**
  * @brief The UploadDevice class
  * @ingroup libsync
@@ -57,6 +91,12 @@ public:
     bool isChoked() { return _choked; }
     void giveBandwidthQuota(qint64 bwq);
 
+    /// The data that is read is added to @a checksum
+    void setUploadChecksum(const std::shared_ptr<UploadChecksum> &checksum) { _uploadChecksum = checksum; }
+
+    /// Drop the data that was sent from the page cache, must be set before open()
+    void setReleasePageCache(bool release) { _releasePageCache = release; }
+
 signals:
 
 private:
@@ -76,6 +116,9 @@ private:
     qint64 _readWithProgress;
     bool _bandwidthLimited; // if _bandwidthQuota will be used
     bool _choked; // if upload is paused (readData() will return 0)
+    std::shared_ptr<UploadChecksum> _uploadChecksum;
+    bool _releasePageCache = false;
+    std::unique_ptr<FileSystem::PageCacheReleaser> _pageCacheReleaser;
     friend class BandwidthManager;
 public slots:
     void slotJobUploadProgress(qint64 sent, qint64 t);
@@ -168,6 +211,12 @@ protected:
 
     QByteArray _transmissionChecksumHeader;
 
+    /** Computed while the data is sent if the protocol supports a trailing
+     * checksum, the content and transmission checksum are not known before
+     * the upload then.
+     */
+    std::shared_ptr<UploadChecksum> _trailingChecksum;
+
 public:
     PropagateUploadFileCommon(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
         : PropagateItemJob(propagator, item)
@@ -242,6 +291,20 @@ protected:
     /** Bases headers that need to be sent on the PUT, or in the MOVE for chunking-ng */
     QMap<QByteArray, QByteArray> headers();
 
+    /// Whether the checksum is only sent with the last request of the upload
+    virtual bool supportsTrailingChecksum() const { return false; }
+
+    /**
+     * Sets the content and transmission checksum from the trailing checksum, or
+     * computes them from the file if the sent data did not cover all of it.
+     *
+     * @a callback is called once they are set.
+     */
+    void finishTrailingChecksum(const std::function<void()> &callback);
+
+    /// Stores the finished trailing checksum in the item and the upload info
+    void setTrailingChecksumHeader(const QByteArray &checksumHeader);
+
 #ifdef Q_OS_WIN
     Utility::Handle m_fileLock;
 #endif
@@ -365,6 +428,10 @@ public:
     PropagateUploadFileNG(OwncloudPropagator *propagator, const SyncFileItemPtr &item);
     void doStartUpload() override;
 
+protected:
+    // The checksum is sent with the final MOVE
+    bool supportsTrailingChecksum() const override { return true; }
+
 private:
     void doStartUploadNext();
     void startNewUpload();
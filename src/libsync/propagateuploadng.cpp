@@ -347,6 +347,11 @@ void PropagateUploadFileNG::doFinalMove()
 
     OC_ENFORCE_X(_jobs.isEmpty(), "MOVE for upload even though jobs are still running");
 
+    if (_trailingChecksum) {
+        finishTrailingChecksum([this] { doFinalMove(); });
+        return;
+    }
+
     _finished = true;
 
     // Finish with a MOVE
@@ -409,6 +414,7 @@ void PropagateUploadFileNG::startNextChunk()
     const QString fileName = propagator()->fullLocalPath(_item->_file);
     auto device = std::make_unique<UploadDevice>(fileName, _currentChunkOffset, _currentChunkSize,
         &propagator()->_bandwidthManager);
+    device->setReleasePageCache(propagator()->syncOptions().releasePageCache(_item->_size));
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadNG) << "Could not prepare upload device: " << device->errorString();
         // Soft error because this is likely caused by the user modifying his files while syncing
@@ -416,6 +422,8 @@ void PropagateUploadFileNG::startNextChunk()
         return;
     }
 
+    device->setUploadChecksum(_trailingChecksum);
+
     QMap<QByteArray, QByteArray> headers;
     headers["OC-Chunk-Offset"] = QByteArray::number(_currentChunkOffset);
 
@@ -507,12 +515,17 @@ void PropagateUploadFileNG::slotPutFinished()
     }
 
     // Check whether the file changed since discovery.
-    if (FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime)) {
+    FileSystem::FileStat stat;
+    if (FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime, &stat)) {
         propagator()->_anotherSyncNeeded = true;
         if (!_finished) {
             abortWithError(SyncFileItem::SoftError, tr("Local file changed during sync."));
             return;
         }
+    } else if (_finished) {
+        // the journal record is written with this inode
+        _item->_inode = stat.inode;
+        _item->_localStatIsCurrent = true;
     }
 
     if (!_finished) {
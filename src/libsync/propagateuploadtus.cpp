@@ -66,6 +66,7 @@ UploadDevice *PropagateUploadFileTUS::prepareDevice(const quint64 &chunkSize)
         return nullptr;
     }
     auto device = std::make_unique<UploadDevice>(localFileName, _currentOffset, chunkSize, &propagator()->_bandwidthManager);
+    device->setReleasePageCache(propagator()->syncOptions().releasePageCache(_item->_size));
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadTUS) << "Could not prepare upload device: " << device->errorString();
 
@@ -212,7 +213,8 @@ void PropagateUploadFileTUS::slotChunkFinished()
     }
 
     // Check whether the file changed since discovery.
-    if (FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime)) {
+    FileSystem::FileStat stat;
+    if (FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime, &stat)) {
         propagator()->_anotherSyncNeeded = true;
         if (!_finished) {
             abortWithError(SyncFileItem::SoftError, tr("Local file changed during sync."));
@@ -220,6 +222,10 @@ void PropagateUploadFileTUS::slotChunkFinished()
             //         and also checking that after the last chunk, and removed the file in case of INSTRUCTION_NEW
             return;
         }
+    } else if (_finished) {
+        // the journal record is written with this inode
+        _item->_inode = stat.inode;
+        _item->_localStatIsCurrent = true;
     }
     if (!_finished) {
         startNextChunk();
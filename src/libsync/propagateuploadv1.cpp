@@ -142,6 +142,7 @@ void PropagateUploadFileV1::startNextChunk()
     const QString fileName = propagator()->fullLocalPath(_item->_file);
     auto device = std::make_unique<UploadDevice>(fileName, chunkStart, currentChunkSize,
         &propagator()->_bandwidthManager);
+    device->setReleasePageCache(propagator()->syncOptions().releasePageCache(_item->_size));
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadV1) << "Could not prepare upload device: " << device->errorString();
         // Soft error because this is likely caused by the user modifying his files while syncing
@@ -250,7 +251,8 @@ void PropagateUploadFileV1::slotPutFinished()
     }
 
     // Check whether the file changed since discovery.
-    if (FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime)) {
+    FileSystem::FileStat stat;
+    if (FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime, &stat)) {
         propagator()->_anotherSyncNeeded = true;
         if (!_finished) {
             abortWithError(SyncFileItem::SoftError, tr("Local file changed during sync."));
@@ -258,6 +260,10 @@ void PropagateUploadFileV1::slotPutFinished()
             //         and also checking that after the last chunk, and removed the file in case of INSTRUCTION_NEW
             return;
         }
+    } else if (_finished) {
+        // the journal record is written with this inode
+        _item->_inode = stat.inode;
+        _item->_localStatIsCurrent = true;
     }
 
     if (!_finished) {
@@ -28,6 +28,9 @@
 #include "common/asserts.h"
 #include "discovery.h"
 #include "common/vfs.h"
+#include "metrics.h"
+#include "syncrecorder.h"
+#include "synctracer.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -42,6 +45,7 @@
 #include <QCoreApplication>
 #include <QSslSocket>
 #include <QDir>
+#include <QFileInfo>
 #include <QLoggingCategory>
 #include <QMutexLocker>
 #include <QThread>
@@ -350,6 +354,9 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
         return true;
     }());
     _syncItems.insert(item);
+    // the strings of the item change during the propagation, release what was added
+    item->_accountedMemory = MemoryBudget::estimatedSize(*item);
+    _syncItemsMemory.add(item->_accountedMemory);
 
     slotNewItem(item);
 
@@ -452,6 +459,11 @@ void SyncEngine::startSync()
         return;
     }
 
+    _syncRecorder = SyncRecorder::createFromEnvironment();
+    if (_syncRecorder) {
+        _syncRecorder->recordJournal(_journal);
+    }
+
     _stopWatch.start();
     _progressInfo->_status = ProgressInfo::Starting;
     emit transmissionProgress(*_progressInfo);
@@ -475,6 +487,7 @@ void SyncEngine::startSync()
         _discoveryPhase->_remoteFolder+=QLatin1Char('/');
     _discoveryPhase->_syncOptions = _syncOptions;
     _discoveryPhase->_shouldDiscoverLocaly = [this](const QString &s) { return shouldDiscoverLocally(s); };
+    _discoveryPhase->_syncRecorder = _syncRecorder.get();
     _discoveryPhase->setSelectiveSyncBlackList(selectiveSyncBlackList);
     _discoveryPhase->setSelectiveSyncWhiteList(_journal->getSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, &ok));
     if (!ok) {
@@ -553,7 +566,11 @@ void SyncEngine::slotDiscoveryFinished()
         return;
     }
 
-    qCInfo(lcEngine) << "#### Discovery end #################################################### " << _stopWatch.addLapTime(QStringLiteral("Discovery Finished")) << "ms";
+    const auto discoveryDuration = _stopWatch.addLapTime(QStringLiteral("Discovery Finished"));
+    qCInfo(lcEngine) << "#### Discovery end #################################################### " << discoveryDuration << "ms";
+    Metrics::instance()->observe(QStringLiteral("sync_discovery_duration_seconds"), discoveryDuration / 1000.0);
+    Metrics::instance()->setGauge(QStringLiteral("sync_discovery_active_jobs"), 0);
+    MemoryBudget::instance()->report();
 
     // Sanity check
     if (!_journal->open()) {
@@ -679,10 +696,15 @@ void SyncEngine::slotDiscoveryFinished()
             Q_EMIT started();
 
         _propagator->start(std::move(_syncItems));
+        // the jobs hold the items now, they are freed once their job is done
+        _syncItems.clear();
 
         qCInfo(lcEngine) << "#### Post-Reconcile end #################################################### " << _stopWatch.addLapTime(QStringLiteral("Post-Reconcile Finished")) << "ms";
     };
 
+    if (_discoveryPhase->_unchangedFiles > 0) {
+        _hasNoneFiles = true;
+    }
     if (!_hasNoneFiles && _hasRemoveFile) {
         qCInfo(lcEngine) << "All the files are going to be changed, asking the user";
         int side = 0; // > 0 means more deleted on the server.  < 0 means more deleted on the client
@@ -741,6 +763,19 @@ void SyncEngine::slotItemCompleted(const SyncFileItemPtr &item)
     }());
 
     _progressInfo->setProgressComplete(*item);
+    _syncItemsMemory.release(item->_accountedMemory);
+    item->_accountedMemory = 0;
+    if (_syncRecorder) {
+        _syncRecorder->recordItem(*item);
+    }
+    {
+        const auto direction = Utility::enumToString(item->_direction);
+        Metrics::instance()->incrementCounter(QStringLiteral("sync_items_total"), 1,
+            { { QStringLiteral("direction"), direction }, { QStringLiteral("status"), Utility::enumToString(item->_status) } });
+        if (item->_status == SyncFileItem::Success && ProgressInfo::isSizeDependent(*item)) {
+            Metrics::instance()->incrementCounter(QStringLiteral("sync_transferred_bytes_total"), item->_size, { { QStringLiteral("direction"), direction } });
+        }
+    }
 
     emit transmissionProgress(*_progressInfo);
     emit itemCompleted(item);
@@ -759,6 +794,7 @@ void SyncEngine::slotPropagationFinished(bool success)
     conflictRecordMaintenance();
 
     _journal->deleteStaleFlagsEntries();
+    _journal->deleteStaleChecksumCacheEntries();
     _journal->commit(QStringLiteral("All Finished."), false);
 
     // Send final progress information even if no
@@ -773,9 +809,40 @@ void SyncEngine::slotPropagationFinished(bool success)
 
 void SyncEngine::finalize(bool success)
 {
-    qCInfo(lcEngine) << "Sync run took " << _stopWatch.addLapTime(QStringLiteral("Sync Finished")) << "ms";
+    const auto syncDuration = _stopWatch.addLapTime(QStringLiteral("Sync Finished"));
+    qCInfo(lcEngine) << "Sync run took " << syncDuration << "ms";
     _stopWatch.stop();
 
+    // SyncJournalDb lives in the common library, sample its size from here
+    const QString journalPath = _journal->databaseFilePath();
+    Metrics::instance()->setGauge(QStringLiteral("sync_journal_size_bytes"),
+        QFileInfo(journalPath).size() + QFileInfo(journalPath + QStringLiteral("-wal")).size(),
+        { { QStringLiteral("journal"), QFileInfo(journalPath).fileName() } });
+    Metrics::instance()->observe(QStringLiteral("sync_duration_seconds"), syncDuration / 1000.0);
+    const auto checksumCache = _journal->takeChecksumCacheStatistics();
+    if (checksumCache.hits || checksumCache.misses) {
+        qCInfo(lcEngine) << "Checksum cache hits:" << checksumCache.hits << "misses:" << checksumCache.misses;
+        Metrics::instance()->incrementCounter(QStringLiteral("sync_checksum_cache_lookups_total"), checksumCache.hits, { { QStringLiteral("result"), QStringLiteral("hit") } });
+        Metrics::instance()->incrementCounter(QStringLiteral("sync_checksum_cache_lookups_total"), checksumCache.misses, { { QStringLiteral("result"), QStringLiteral("miss") } });
+    }
+    Metrics::instance()->incrementCounter(QStringLiteral("sync_runs_total"), 1,
+        { { QStringLiteral("result"), success ? QStringLiteral("success") : QStringLiteral("failure") } });
+
+    if (_discoveryPhase) {
+        // pending listings must not record into the deleted recorder
+        _discoveryPhase->_syncRecorder = nullptr;
+    }
+    if (_syncRecorder) {
+        for (const auto &lap : { QStringLiteral("Discovery Finished"), QStringLiteral("Reconcile (aboutToPropagate OK)"), QStringLiteral("Sync Finished") }) {
+            _syncRecorder->recordPhase(lap, std::chrono::milliseconds(_stopWatch.durationOfLap(lap)));
+        }
+        _syncRecorder->close();
+        _syncRecorder.reset();
+    }
+    SyncTracer::instance()->flush();
+    MemoryBudget::instance()->report();
+    _syncItemsMemory.reset();
+
     if (_discoveryPhase) {
         _discoveryPhase.take()->deleteLater();
     }
@@ -981,6 +1048,7 @@ void SyncEngine::abort()
         // Delete the discovery and all child jobs after ensuring
         // it can't finish and start the propagator
         disconnect(_discoveryPhase.data(), nullptr, this, nullptr);
+        _discoveryPhase->_syncRecorder = nullptr;
         _discoveryPhase.take()->deleteLater();
 
         if (!_goingDown) {
@@ -24,6 +24,7 @@
 #include <QMap>
 #include <QStringList>
 #include <QSharedPointer>
+#include <memory>
 #include <set>
 
 #include "csync/csync_exclude.h"
@@ -34,6 +35,7 @@
 #include "syncfilestatustracker.h"
 #include "accountfwd.h"
 #include "discoveryphase.h"
+#include "memorybudget.h"
 #include "common/checksums.h"
 
 class QProcess;
@@ -44,6 +46,7 @@ class SyncJournalFileRecord;
 class SyncJournalDb;
 class OwncloudPropagator;
 class ProcessDirectoryJob;
+class SyncRecorder;
 
 enum AnotherSyncNeeded {
     NoFollowUpSync,
@@ -237,6 +240,9 @@ private:
     QByteArray _remoteRootEtag;
     SyncJournalDb *_journal;
     QScopedPointer<DiscoveryPhase> _discoveryPhase;
+    std::unique_ptr<SyncRecorder> _syncRecorder;
+    // The discovered items until they are propagated
+    MemoryBudget::Reservation _syncItemsMemory { MemoryBudget::Component::SyncItems };
     QSharedPointer<OwncloudPropagator> _propagator;
 
     // List of all files with conflicts
@@ -47,7 +47,9 @@ SyncJournalFileRecord SyncFileItem::toSyncJournalFileRecordWithInode(const QStri
 
     // Update the inode if possible
     rec._inode = _inode;
-    if (FileSystem::getInode(localFileName, &rec._inode)) {
+    if (_localStatIsCurrent) {
+        // the propagator just read it
+    } else if (FileSystem::getInode(localFileName, &rec._inode)) {
         qCDebug(lcFileItem) << localFileName << "Retrieved inode " << rec._inode << "(previous item inode: " << _inode << ")";
     } else {
         // use the "old" inode coming with the item for the case where the
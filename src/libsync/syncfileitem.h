@@ -270,6 +270,11 @@ public:
     quint64 _inode;
     QByteArray _fileId;
 
+    /// Set by the propagator when _size, _modtime and _inode were read from the
+    /// local file after it was last written, the journal record is then written
+    /// without another stat, see toSyncJournalFileRecordWithInode()
+    bool _localStatIsCurrent = false;
+
     // This is the value for the 'new' side, matching with _size and _modtime.
     //
     // When is this set, and is it the local or the remote checksum?
@@ -287,6 +292,9 @@ public:
 
     bool _relevantDirectoyInstruction = false;
     bool _finished = false;
+
+    // The memory the SyncEngine accounted for the item, released once it is propagated
+    qint64 _accountedMemory = 0;
 };
 
 
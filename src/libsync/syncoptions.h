@@ -73,6 +73,27 @@ public:
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** Whether the local discovery and checksum computations run on
+     * Utility::backgroundThreadPool() with low I/O and CPU priority */
+    bool _backgroundPriority = false;
+
+    /** Only upload the local files, the remote folder is not discovered.
+     *
+     * For uploads into a folder that is known to be empty, like the backups
+     * of the socket api. The content checksums are computed in parallel
+     * during the discovery. */
+    bool _uploadOnly = false;
+
+    /** Whether large files are read and written without keeping them in the
+     * page cache, see FileSystem::PageCacheReleaser */
+    bool _releasePageCache = false;
+
+    /** Whether the reads and writes of a file of @a size bytes release the page cache
+     *
+     * Small files are cheap to keep and likely to be used again.
+     */
+    bool releasePageCache(qint64 size) const { return _releasePageCache && size >= 8 * 1024 * 1024; }
+
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
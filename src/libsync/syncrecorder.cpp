@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncrecorder.h"
+
+#include "common/syncjournaldb.h"
+#include "common/utility.h"
+#include "syncfileitem.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QRandomGenerator>
+
+namespace {
+Q_LOGGING_CATEGORY(lcSyncRecorder, "sync.recorder", QtInfoMsg)
+
+// the sync journal, the discovery silently excludes it
+bool isJournalFile(const QString &name)
+{
+    return name.contains(QLatin1String(".db"))
+        && (name.startsWith(QLatin1String(".sync_"), Qt::CaseInsensitive) || name.startsWith(QLatin1String("._sync_"), Qt::CaseInsensitive)
+            || name.startsWith(QLatin1String(".csync_journal.db"), Qt::CaseInsensitive));
+}
+}
+
+using namespace OCC;
+
+std::unique_ptr<SyncRecorder> SyncRecorder::createFromEnvironment()
+{
+    const auto dir = qEnvironmentVariable("OWNCLOUD_SYNC_RECORDER_DIR");
+    if (dir.isEmpty()) {
+        return nullptr;
+    }
+    if (!QDir().mkpath(dir)) {
+        qCWarning(lcSyncRecorder) << "Could not create the sync recorder directory" << dir;
+        return nullptr;
+    }
+    const auto fileName = QStringLiteral("sync-%1.jsonl").arg(QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-HHmmss-zzz")));
+    return std::unique_ptr<SyncRecorder>(new SyncRecorder(QDir(dir).filePath(fileName)));
+}
+
+SyncRecorder::SyncRecorder(const QString &outputPath)
+    : _outputPath(outputPath)
+    , _file(outputPath)
+{
+    // a fresh salt per trace, the hashes are only meant to be compared within one trace
+    const quint64 salt = QRandomGenerator::system()->generate64();
+    _salt = QByteArray::number(salt, 16);
+
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(lcSyncRecorder) << "Could not open" << _outputPath << _file.errorString();
+        _writeError = true;
+        return;
+    }
+    write(QStringLiteral("header"), QJsonObject { { QStringLiteral("version"), 2 } });
+}
+
+SyncRecorder::~SyncRecorder()
+{
+    close();
+}
+
+void SyncRecorder::write(const QString &kind, QJsonObject &&record)
+{
+    if (!_file.isOpen()) {
+        return;
+    }
+    record.insert(QStringLiteral("kind"), kind);
+    // one record per line, nothing is kept in memory
+    if (_file.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n') == -1) {
+        if (!_writeError) {
+            qCWarning(lcSyncRecorder) << "Could not write" << _outputPath << _file.errorString();
+        }
+        _writeError = true;
+    }
+}
+
+QString SyncRecorder::anonymizedValue(const QByteArray &value) const
+{
+    if (value.isEmpty()) {
+        return QString();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(_salt);
+    hash.addData(value);
+    return QString::fromLatin1(hash.result().toHex().left(16));
+}
+
+QString SyncRecorder::anonymizedName(const QString &name) const
+{
+    if (name.isEmpty()) {
+        return name;
+    }
+    // keep what is relevant for the sync decisions: hidden files and the suffix
+    const bool hidden = name.startsWith(QLatin1Char('.'));
+    const int dot = name.lastIndexOf(QLatin1Char('.'));
+    const QString suffix = dot > 0 ? name.mid(dot) : QString();
+    auto out = anonymizedValue(name.toUtf8()) + suffix;
+    if (hidden) {
+        out.prepend(QLatin1Char('.'));
+    }
+    return out;
+}
+
+QString SyncRecorder::anonymizedPath(const QString &path) const
+{
+    auto parts = path.split(QLatin1Char('/'));
+    for (auto &part : parts) {
+        part = anonymizedName(part);
+    }
+    return parts.join(QLatin1Char('/'));
+}
+
+void SyncRecorder::recordJournal(SyncJournalDb *journal)
+{
+    journal->getFilesBelowPath(QByteArray(), [this](const SyncJournalFileRecord &rec) {
+        write(QStringLiteral("journal"), QJsonObject {
+            { QStringLiteral("path"), anonymizedPath(QString::fromUtf8(rec._path)) },
+            { QStringLiteral("type"), static_cast<int>(rec._type) },
+            { QStringLiteral("modtime"), static_cast<qint64>(rec._modtime) },
+            { QStringLiteral("size"), rec._fileSize },
+            { QStringLiteral("etag"), anonymizedValue(rec._etag) },
+            { QStringLiteral("fileId"), anonymizedValue(rec._fileId) },
+            { QStringLiteral("remotePerm"), QString::fromUtf8(rec._remotePerm.toDbValue()) },
+        });
+    });
+}
+
+void SyncRecorder::recordRemoteListing(const QString &path, const QVector<RemoteInfo> &entries, int httpCode, std::chrono::milliseconds duration)
+{
+    QJsonArray list;
+    for (const auto &entry : entries) {
+        list.append(QJsonObject {
+            { QStringLiteral("name"), anonymizedName(entry.name) },
+            { QStringLiteral("isDirectory"), entry.isDirectory },
+            { QStringLiteral("modtime"), static_cast<qint64>(entry.modtime) },
+            { QStringLiteral("size"), static_cast<qint64>(entry.size) },
+            { QStringLiteral("etag"), anonymizedValue(entry.etag) },
+            { QStringLiteral("fileId"), anonymizedValue(entry.fileId) },
+            { QStringLiteral("remotePerm"), QString::fromUtf8(entry.remotePerm.toDbValue()) },
+        });
+    }
+    write(QStringLiteral("remoteListing"), QJsonObject {
+        { QStringLiteral("path"), anonymizedPath(path) },
+        { QStringLiteral("httpCode"), httpCode },
+        { QStringLiteral("durationMs"), static_cast<qint64>(duration.count()) },
+        { QStringLiteral("entries"), list },
+    });
+}
+
+void SyncRecorder::recordLocalListing(const QString &path, const QVector<LocalInfo> &entries, std::chrono::milliseconds duration)
+{
+    QJsonArray list;
+    for (const auto &entry : entries) {
+        // the journal is already part of the trace, a replay must not turn it into a user file
+        if (isJournalFile(entry.name)) {
+            continue;
+        }
+        list.append(QJsonObject {
+            { QStringLiteral("name"), anonymizedName(entry.name) },
+            { QStringLiteral("type"), static_cast<int>(entry.type) },
+            { QStringLiteral("modtime"), static_cast<qint64>(entry.modtime) },
+            { QStringLiteral("size"), static_cast<qint64>(entry.size) },
+            { QStringLiteral("isHidden"), entry.isHidden },
+            { QStringLiteral("isSymLink"), entry.isSymLink },
+        });
+    }
+    write(QStringLiteral("localListing"), QJsonObject {
+        { QStringLiteral("path"), anonymizedPath(path) },
+        { QStringLiteral("durationMs"), static_cast<qint64>(duration.count()) },
+        { QStringLiteral("entries"), list },
+    });
+}
+
+void SyncRecorder::recordItem(const SyncFileItem &item)
+{
+    write(QStringLiteral("item"), QJsonObject {
+        { QStringLiteral("path"), anonymizedPath(item.destination()) },
+        { QStringLiteral("type"), static_cast<int>(item._type) },
+        { QStringLiteral("instruction"), static_cast<int>(item._instruction) },
+        { QStringLiteral("direction"), Utility::enumToString(item._direction) },
+        { QStringLiteral("status"), Utility::enumToString(item._status) },
+        { QStringLiteral("httpCode"), item._httpErrorCode },
+        { QStringLiteral("size"), item._size },
+    });
+}
+
+void SyncRecorder::recordPhase(const QString &name, std::chrono::milliseconds duration)
+{
+    write(QStringLiteral("phase"), QJsonObject {
+        { QStringLiteral("name"), name },
+        { QStringLiteral("durationMs"), static_cast<qint64>(duration.count()) },
+    });
+}
+
+bool SyncRecorder::close()
+{
+    if (!_file.isOpen()) {
+        return !_writeError;
+    }
+    if (!_file.flush()) {
+        qCWarning(lcSyncRecorder) << "Could not write" << _outputPath << _file.errorString();
+        _writeError = true;
+    }
+    _file.close();
+    if (!_writeError) {
+        qCInfo(lcSyncRecorder) << "Sync trace written to" << _outputPath;
+    }
+    return !_writeError;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+#include "discoveryphase.h"
+
+#include <QFile>
+#include <QJsonObject>
+
+#include <chrono>
+#include <memory>
+
+namespace OCC {
+
+class SyncJournalDb;
+
+/**
+ * @brief Records an anonymized trace of a sync run
+ *
+ * Recording is enabled by pointing OWNCLOUD_SYNC_RECORDER_DIR to a directory.
+ * Every sync run then writes a json lines file to that directory. Each record
+ * is written as soon as it is recorded, as one json object with a "kind":
+ * - "header": the format version
+ * - "journal": one entry of the journal state at the start of the sync
+ * - "remoteListing", "localListing": a directory listing and the time it took
+ * - "item": the instruction and result of a propagated item
+ * - "phase": the duration of a sync phase
+ *
+ * File names are replaced by salted hashes, only a leading dot and the file
+ * extension are kept. Etags and file ids are hashed the same way, so unchanged
+ * entries can still be recognized when the trace is replayed.
+ *
+ * test/testutils/syncreplay.h turns a trace back into a FakeFolder.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT SyncRecorder
+{
+public:
+    /** Returns a recorder if OWNCLOUD_SYNC_RECORDER_DIR is set, nullptr otherwise */
+    static std::unique_ptr<SyncRecorder> createFromEnvironment();
+
+    explicit SyncRecorder(const QString &outputPath);
+    ~SyncRecorder();
+
+    void recordJournal(SyncJournalDb *journal);
+    void recordRemoteListing(const QString &path, const QVector<RemoteInfo> &entries, int httpCode, std::chrono::milliseconds duration);
+    void recordLocalListing(const QString &path, const QVector<LocalInfo> &entries, std::chrono::milliseconds duration);
+    void recordItem(const SyncFileItem &item);
+    void recordPhase(const QString &name, std::chrono::milliseconds duration);
+
+    /** Flushes and closes the trace, returns false if a record could not be written */
+    bool close();
+
+    QString outputPath() const { return _outputPath; }
+
+    QString anonymizedPath(const QString &path) const;
+    QString anonymizedName(const QString &name) const;
+    QString anonymizedValue(const QByteArray &value) const;
+
+private:
+    void write(const QString &kind, QJsonObject &&record);
+
+    QString _outputPath;
+    QByteArray _salt;
+    QFile _file;
+    bool _writeError = false;
+};
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "synctracer.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QThread>
+
+#include <chrono>
+
+namespace {
+Q_LOGGING_CATEGORY(lcSyncTracer, "sync.tracer", QtInfoMsg)
+
+// a few hundred bytes per span, stop recording before the trace gets unusable
+const int DefaultMaxSpans = 1000000;
+
+// qHash is seeded per process
+QByteArray hashed(const QString &value)
+{
+    if (value.isEmpty()) {
+        return QByteArray();
+    }
+    return QCryptographicHash::hash(value.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+}
+
+qint64 nowInMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+using namespace OCC;
+
+SyncTracer::Span::Span(Span &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+SyncTracer::Span &SyncTracer::Span::operator=(Span &&other) noexcept
+{
+    end();
+    _category = other._category;
+    _name = std::move(other._name);
+    _folderHash = std::move(other._folderHash);
+    _pathHash = std::move(other._pathHash);
+    _start = other._start;
+    _bytes = other._bytes;
+    _thread = other._thread;
+    _onThread = other._onThread;
+    other._start = -1;
+    return *this;
+}
+
+SyncTracer::Span::~Span()
+{
+    end();
+}
+
+void SyncTracer::Span::end()
+{
+    if (!isActive()) {
+        return;
+    }
+    SyncTracer::instance()->record(*this, nowInMicroseconds());
+    _start = -1;
+}
+
+SyncTracer *SyncTracer::instance()
+{
+    static SyncTracer tracer;
+    return &tracer;
+}
+
+SyncTracer::SyncTracer()
+    : _maxSpans(DefaultMaxSpans)
+{
+    const auto dir = qEnvironmentVariable("OWNCLOUD_SYNC_TRACE_DIR");
+    if (!dir.isEmpty()) {
+        _outputDirectory = dir;
+        _enabled = true;
+    }
+}
+
+void SyncTracer::setEnabled(bool enabled)
+{
+    if (!enabled && isEnabled()) {
+        flush();
+    }
+    _enabled = enabled;
+}
+
+QString SyncTracer::outputDirectory() const
+{
+    QMutexLocker lock(&_mutex);
+    return _outputDirectory;
+}
+
+void SyncTracer::setOutputDirectory(const QString &dir)
+{
+    QMutexLocker lock(&_mutex);
+    _outputDirectory = dir;
+}
+
+SyncTracer::Span SyncTracer::begin(const char *category, const QString &name, const QString &folder, const QString &path)
+{
+    return beginImpl(category, name, folder, path, false);
+}
+
+SyncTracer::Span SyncTracer::beginOnThread(const char *category, const QString &name, const QString &folder, const QString &path)
+{
+    return beginImpl(category, name, folder, path, true);
+}
+
+SyncTracer::Span SyncTracer::beginImpl(const char *category, const QString &name, const QString &folder, const QString &path, bool onThread)
+{
+    Span span;
+    if (!isEnabled()) {
+        return span;
+    }
+    span._category = category;
+    span._name = name;
+    span._folderHash = hashed(folder);
+    span._pathHash = hashed(path);
+    span._thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    span._onThread = onThread;
+    span._start = nowInMicroseconds();
+    return span;
+}
+
+void SyncTracer::setMaxSpans(int maxSpans)
+{
+    QMutexLocker lock(&_mutex);
+    _maxSpans = maxSpans;
+}
+
+void SyncTracer::record(const Span &span, qint64 end)
+{
+    QJsonObject args;
+    if (!span._folderHash.isEmpty()) {
+        args.insert(QStringLiteral("folder"), QString::fromLatin1(span._folderHash));
+    }
+    if (!span._pathHash.isEmpty()) {
+        args.insert(QStringLiteral("path"), QString::fromLatin1(span._pathHash));
+    }
+    if (span._bytes >= 0) {
+        args.insert(QStringLiteral("bytes"), span._bytes);
+    }
+    QJsonObject beginEvent {
+        { QStringLiteral("name"), span._name },
+        { QStringLiteral("cat"), QString::fromLatin1(span._category) },
+        { QStringLiteral("ts"), span._start },
+        { QStringLiteral("pid"), QCoreApplication::applicationPid() },
+        { QStringLiteral("tid"), static_cast<qint64>(span._thread) },
+        { QStringLiteral("args"), args },
+    };
+    QJsonObject endEvent;
+    if (span._onThread) {
+        // a complete event on the track of the thread
+        beginEvent.insert(QStringLiteral("ph"), QStringLiteral("X"));
+        beginEvent.insert(QStringLiteral("dur"), end - span._start);
+    } else {
+        // async events: spans of different jobs overlap on the same thread
+        beginEvent.insert(QStringLiteral("ph"), QStringLiteral("b"));
+        endEvent = beginEvent;
+        endEvent.remove(QStringLiteral("args"));
+        endEvent.insert(QStringLiteral("ph"), QStringLiteral("e"));
+        endEvent.insert(QStringLiteral("ts"), end);
+    }
+
+    QMutexLocker lock(&_mutex);
+    if (_spanCount >= _maxSpans) {
+        ++_droppedSpans;
+        return;
+    }
+    if (!_events.isEmpty()) {
+        _events += ",\n";
+    }
+    if (span._onThread) {
+        _events += QJsonDocument(beginEvent).toJson(QJsonDocument::Compact);
+    } else {
+        const auto id = QString::number(_nextId++);
+        beginEvent.insert(QStringLiteral("id"), id);
+        endEvent.insert(QStringLiteral("id"), id);
+        _events += QJsonDocument(beginEvent).toJson(QJsonDocument::Compact) + ",\n" + QJsonDocument(endEvent).toJson(QJsonDocument::Compact);
+    }
+    ++_spanCount;
+}
+
+bool SyncTracer::flush()
+{
+    QByteArray events;
+    QString dir;
+    int droppedSpans;
+    {
+        QMutexLocker lock(&_mutex);
+        if (_spanCount == 0) {
+            return true;
+        }
+        if (_droppedSpans) {
+            qCWarning(lcSyncTracer) << "Dropped" << _droppedSpans << "spans, the trace is limited to" << _maxSpans << "spans";
+        }
+        droppedSpans = _droppedSpans;
+        events = std::move(_events);
+        _events.clear();
+        _spanCount = 0;
+        _droppedSpans = 0;
+        dir = _outputDirectory;
+    }
+
+    if (dir.isEmpty() || !QDir().mkpath(dir)) {
+        qCWarning(lcSyncTracer) << "Can't write the sync trace to" << dir;
+        return false;
+    }
+    const auto fileName = QDir(dir).filePath(QStringLiteral("sync-trace-%1.json").arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss-zzz"))));
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcSyncTracer) << "Could not open" << fileName << file.errorString();
+        return false;
+    }
+    file.write("{\"traceEvents\":[\n");
+    file.write(events);
+    file.write("\n],\"otherData\":{\"droppedSpans\":\"" + QByteArray::number(droppedSpans) + "\"}}\n");
+    if (!file.commit()) {
+        qCWarning(lcSyncTracer) << "Could not write" << fileName << file.errorString();
+        return false;
+    }
+    qCInfo(lcSyncTracer) << "Sync trace written to" << fileName;
+    return true;
+}
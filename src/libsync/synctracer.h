@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+namespace OCC {
+
+/**
+ * @brief Records when sync jobs run, as a Chrome trace event file
+ *
+ * Discovery, checksum and propagation jobs open a Span when they start and
+ * close it when they are done. These spans are async events, the jobs overlap
+ * on the main thread. The work done in thread pools, like reading a local
+ * directory or computing a checksum, is recorded with a second span on the
+ * worker thread, see beginOnThread().
+ *
+ * At the end of a sync the spans are written to outputDirectory() as
+ * sync-trace-<date>.json, which can be loaded in chrome://tracing or
+ * https://ui.perfetto.dev to see which jobs overlapped and where the pipeline
+ * was idle.
+ *
+ * Tracing is enabled with OWNCLOUD_SYNC_TRACE_DIR or from the log window.
+ * Folders and file names are only recorded as hashes, which are the same in
+ * every run so traces of different runs can be compared.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT SyncTracer
+{
+public:
+    class OWNCLOUDSYNC_EXPORT Span
+    {
+    public:
+        Span() = default;
+        Span(Span &&other) noexcept;
+        Span &operator=(Span &&other) noexcept;
+        ~Span();
+
+        bool isActive() const { return _start >= 0; }
+        void setBytes(qint64 bytes) { _bytes = bytes; }
+
+        /// Records the span, further calls do nothing
+        void end();
+
+    private:
+        friend class SyncTracer;
+        const char *_category = nullptr;
+        QString _name;
+        QByteArray _folderHash;
+        QByteArray _pathHash;
+        qint64 _start = -1;
+        qint64 _bytes = -1;
+        quint64 _thread = 0;
+        bool _onThread = false;
+    };
+
+    static SyncTracer *instance();
+
+    bool isEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    QString outputDirectory() const;
+    void setOutputDirectory(const QString &dir);
+
+    /**
+     * Starts a span, returns an inactive span if tracing is disabled
+     *
+     * @param category a string literal, e.g. "discovery"
+     */
+    Span begin(const char *category, const QString &name, const QString &folder = QString(), const QString &path = QString());
+
+    /**
+     * Starts a span of work done by the current thread, e.g. in a runnable of a thread pool
+     *
+     * The span must be ended on the same thread, it is shown on the track of that thread.
+     */
+    Span beginOnThread(const char *category, const QString &name, const QString &folder = QString(), const QString &path = QString());
+
+    /// Ends @a span when @a sender emits any of @a signals, or when the connections are destroyed
+    template <typename Sender, typename... Signals>
+    static void endOn(Span &&span, const Sender *sender, const QObject *context, Signals... signals)
+    {
+        if (!span.isActive()) {
+            return;
+        }
+        auto shared = std::make_shared<Span>(std::move(span));
+        (QObject::connect(sender, signals, context, [shared] { shared->end(); }), ...);
+    }
+
+    /// Writes the recorded spans to a new file in outputDirectory() and forgets them
+    bool flush();
+
+    /// Spans beyond this number are dropped until the next flush(), the count of dropped spans is written to the trace
+    void setMaxSpans(int maxSpans);
+
+private:
+    SyncTracer();
+    Span beginImpl(const char *category, const QString &name, const QString &folder, const QString &path, bool onThread);
+    void record(const Span &span, qint64 end);
+
+    std::atomic<bool> _enabled { false };
+    mutable QMutex _mutex;
+    QString _outputDirectory;
+    QByteArray _events;
+    int _spanCount = 0;
+    int _maxSpans;
+    int _droppedSpans = 0;
+    quint64 _nextId = 1;
+};
+}
@@ -42,6 +42,8 @@ public:
 
 
     Result<void, QString> createPlaceholder(const SyncFileItem &item) override;
+    // only writes the placeholder file
+    bool canCreatePlaceholdersInThread() const override { return true; }
 
     bool needsMetadataUpdate(const SyncFileItem &) override { return false; }
     bool isDehydratedPlaceholder(const QString &filePath) override;
@@ -0,0 +1,60 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Like LargeSync, but with a generated remote tree that only costs memory
+ * where it gets modified. The defaults create about 5 million files.
+ */
+
+#include "testutils/syncenginetestutils.h"
+#include <syncengine.h>
+
+#include <QCommandLineParser>
+
+using namespace OCC;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption filesOption(QStringLiteral("files-per-dir"), QStringLiteral("Files in each directory"), QStringLiteral("count"), QStringLiteral("17"));
+    const QCommandLineOption dirsOption(QStringLiteral("dirs-per-dir"), QStringLiteral("Sub directories of each directory"), QStringLiteral("count"), QStringLiteral("8"));
+    const QCommandLineOption depthOption(QStringLiteral("depth"), QStringLiteral("Depth of the tree"), QStringLiteral("levels"), QStringLiteral("6"));
+    const QCommandLineOption sizeOption(QStringLiteral("size"), QStringLiteral("Size of each file"), QStringLiteral("bytes"), QStringLiteral("1"));
+    const QCommandLineOption vfsOption(QStringLiteral("vfs"), QStringLiteral("Use suffix virtual files instead of downloading"));
+    parser.addOptions({ filesOption, dirsOption, depthOption, sizeOption, vfsOption });
+    parser.process(app);
+
+    FileInfoGenerator generator;
+    generator.filesPerDir = parser.value(filesOption).toInt();
+    generator.dirsPerDir = parser.value(dirsOption).toInt();
+    generator.depth = parser.value(depthOption).toInt();
+    generator.fileSize = parser.value(sizeOption).toLongLong();
+
+    FakeFolder fakeFolder { FileInfo {} };
+    if (parser.isSet(vfsOption)) {
+        fakeFolder.switchToVfs(QSharedPointer<Vfs>(createVfsFromPlugin(Vfs::WithSuffix).release()));
+        fakeFolder.syncJournal().internalPinStates().setForPath("", PinState::Unspecified);
+    }
+    fakeFolder.remoteModifier() = FileInfo::fromGenerator(QString(), generator);
+
+    qDebug() << "NUMFILES" << generator.fileCount();
+    QElapsedTimer timer;
+    timer.start();
+    bool result1 = fakeFolder.syncOnce();
+    qDebug() << "FIRST SYNC: " << result1 << timer.restart();
+
+    // touch a few files on the server, only their directories get materialized
+    for (int i = 1; i <= generator.filesPerDir; i += 4) {
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("dir1/file%1").arg(i));
+    }
+    bool result2 = fakeFolder.syncOnce();
+    qDebug() << "SECOND SYNC: " << result2 << timer.restart();
+    return (result1 && result2) ? 0 : -1;
+}
@@ -0,0 +1,76 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Syncs against WebDavTestServer, the requests go through the real Qt network stack
+ * over the loopback interface.
+ */
+
+#include "testutils/syncenginetestutils.h"
+#include "testutils/webdavtestserver.h"
+#include <syncengine.h>
+
+#include <QCommandLineParser>
+
+using namespace OCC;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption latencyOption(QStringLiteral("latency"), QStringLiteral("Delay of every reply in ms"), QStringLiteral("ms"), QStringLiteral("0"));
+    const QCommandLineOption bandwidthOption(QStringLiteral("bandwidth"), QStringLiteral("Bytes per second and connection, 0 is unlimited"), QStringLiteral("bytes"), QStringLiteral("0"));
+    const QCommandLineOption filesOption(QStringLiteral("files"), QStringLiteral("Number of small files"), QStringLiteral("count"), QStringLiteral("1000"));
+    parser.addOptions({ latencyOption, bandwidthOption, filesOption });
+    parser.process(app);
+
+    FakeFolder fakeFolder { FileInfo {} };
+
+    const int numFiles = parser.value(filesOption).toInt();
+    FileInfo remote;
+    for (int i = 0; i < numFiles; ++i) {
+        const auto dir = QStringLiteral("dir%1").arg(i / 100);
+        if (!remote.find(dir)) {
+            remote.mkdir(dir);
+        }
+        remote.insert(QStringLiteral("%1/file%2").arg(dir, QString::number(i)), 64 * 1024);
+    }
+    // larger than the initial chunk size to go through chunking NG
+    remote.insert(QStringLiteral("big1"), 30 * 1000 * 1000);
+    remote.insert(QStringLiteral("big2"), 30 * 1000 * 1000);
+
+    WebDavTestServer server { remote };
+    server.setLatency(std::chrono::milliseconds(parser.value(latencyOption).toInt()));
+    server.setBandwidthLimit(parser.value(bandwidthOption).toLongLong());
+    if (!server.listen()) {
+        qWarning() << "Could not listen" << server.errorString();
+        return -1;
+    }
+    fakeFolder.account()->setCredentials(new FakeCredentials { server.createAccessManager() });
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool download = fakeFolder.syncOnce();
+    qDebug() << "DOWNLOAD SYNC: " << download << timer.restart() << "ms" << server.requestCount() << "requests" << server.bytesSent() << "bytes";
+
+    for (int i = 0; i < numFiles; i += 10) {
+        fakeFolder.localModifier().appendByte(QStringLiteral("dir%1/file%2").arg(QString::number(i / 100), QString::number(i)));
+    }
+    fakeFolder.localModifier().appendByte(QStringLiteral("big1"));
+    fakeFolder.localModifier().insert(QStringLiteral("big3"), 30 * 1000 * 1000);
+
+    timer.restart();
+    const bool upload = fakeFolder.syncOnce();
+    qDebug() << "UPLOAD SYNC: " << upload << timer.restart() << "ms" << server.requestCount() << "requests" << server.bytesReceived() << "bytes";
+
+    const bool noop = fakeFolder.syncOnce();
+    qDebug() << "NOOP SYNC: " << noop << timer.restart() << "ms" << server.requestCount() << "requests";
+
+    return (download && upload && noop) ? 0 : -1;
+}
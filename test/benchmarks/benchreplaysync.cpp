@@ -0,0 +1,37 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Replays a trace written by OCC::SyncRecorder (OWNCLOUD_SYNC_RECORDER_DIR),
+ * see test/testutils/syncreplay.h.
+ */
+
+#include "testutils/syncreplay.h"
+#include <syncengine.h>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    if (argc < 2) {
+        qWarning() << "Usage:" << argv[0] << "<trace.jsonl>";
+        return -1;
+    }
+    const auto trace = SyncTrace::load(QString::fromLocal8Bit(argv[1]));
+    if (!trace) {
+        return -1;
+    }
+    auto fakeFolder = createReplayFolder(*trace);
+
+    qDebug() << "RECORDED PHASES" << trace->phases;
+    qDebug() << "RECORDED ITEMS" << trace->items.size();
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool result = fakeFolder->syncOnce();
+    qDebug() << "REPLAYED SYNC: " << result << timer.elapsed();
+    return result ? 0 : -1;
+}
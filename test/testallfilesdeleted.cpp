@@ -300,6 +300,29 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testSomeFilesDeleted()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+
+        QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToRemoveAllFiles,
+            [&](SyncFileItem::Direction, std::function<void(bool)>) {
+                QFAIL("should not be called");
+            });
+
+        // only files, no directory
+        fakeFolder.remoteModifier().insert("a");
+        fakeFolder.remoteModifier().insert("b");
+        fakeFolder.remoteModifier().insert("c");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // the unchanged file counts even though it is not reported as an item
+        fakeFolder.remoteModifier().remove("a");
+        fakeFolder.remoteModifier().remove("b");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testSelectiveSyncNoPopup() {
         const auto original = FileInfo::A12_B12_C12_S12();
 
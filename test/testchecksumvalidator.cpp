@@ -170,6 +170,65 @@ using namespace OCC::Utility;
         delete vali;
     }
 
+    void testUploadChecksummingReleasingPageCache() {
+        ComputeChecksum *vali = new ComputeChecksum(this);
+        _expectedType = OCC::checkSumSHA1C;
+        vali->setChecksumType(_expectedType);
+        vali->setReleasePageCache(true);
+        connect(vali, &ComputeChecksum::done, this, &TestChecksumValidator::slotUpValidated);
+
+        _expected = ComputeChecksum::computeNowOnFile(_testfile, _expectedType);
+        QVERIFY(!_expected.isEmpty());
+
+        vali->start(_testfile);
+
+        QEventLoop loop;
+        connect(vali, &ComputeChecksum::done, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+        loop.exec();
+
+        delete vali;
+    }
+
+    void testChecksumCache()
+    {
+        SyncJournalDb journal(_root.path() + "/checksumcache.db");
+        const QString file = _root.path() + "/file_cached.bin";
+        QVERIFY(TestUtils::writeRandomFile(file, 1000));
+
+        ChecksumCacheKey key;
+        QVERIFY(FileSystem::getInode(file, &key.inode));
+        const QFileInfo info(file);
+        key.size = info.size();
+        key.modtime = info.lastModified().toMSecsSinceEpoch();
+        key.ctime = info.metadataChangeTime().toMSecsSinceEpoch();
+        journal.setCachedChecksum(key, OCC::checkSumSHA1C, "cachedsum");
+
+        auto compute = [&] {
+            QByteArray result;
+            ComputeChecksum computeChecksum;
+            computeChecksum.setChecksumType(OCC::checkSumSHA1C);
+            computeChecksum.setChecksumCache(&journal);
+            connect(&computeChecksum, &ComputeChecksum::done, this, [&result](const QByteArray &, const QByteArray &checksum) { result = checksum; });
+            computeChecksum.start(file);
+            [&] { QTRY_VERIFY(!result.isEmpty()); }();
+            return result;
+        };
+
+        // the file is not read if the cache has an entry
+        QCOMPARE(compute(), QByteArray("cachedsum"));
+
+        // a modification invalidates the entry
+        QVERIFY(TestUtils::writeRandomFile(file, 100));
+        QFile fileDevice(file);
+        QVERIFY(fileDevice.open(QIODevice::ReadOnly));
+        QCOMPARE(compute(), calcSha1(&fileDevice));
+
+        const auto statistics = journal.takeChecksumCacheStatistics();
+        QCOMPARE(statistics.hits, qint64(1));
+        QCOMPARE(statistics.misses, qint64(1));
+        journal.close();
+    }
+
     void testDownloadChecksummingAdler() {
         ValidateChecksumHeader *vali = new ValidateChecksumHeader(this);
         connect(vali, &ValidateChecksumHeader::validated, this, &TestChecksumValidator::slotDownValidated);
@@ -204,6 +263,42 @@ using namespace OCC::Utility;
         delete vali;
     }
 
+    void testStreamingChecksum()
+    {
+        QFile file(_testfile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray data = file.readAll();
+
+        for (const QByteArray type : { "Adler32", "MD5", "SHA1", "SHA256", "SHA3-256" }) {
+            StreamingChecksum checksum(type);
+            QVERIFY(checksum.isValid());
+            // uneven parts, like the buffers of a download
+            for (int pos = 0; pos < data.size(); pos += 1000) {
+                checksum.addData(data.constData() + pos, qMin(1000, data.size() - pos));
+            }
+            file.seek(0);
+            QCOMPARE(checksum.result(), ComputeChecksum::computeNow(&file, type));
+        }
+
+        QVERIFY(!StreamingChecksum("Klaas32").isValid());
+        QVERIFY(StreamingChecksum("Adler32").result().isEmpty());
+    }
+
+    void testValidateComputedChecksum()
+    {
+        ValidateChecksumHeader vali;
+        connect(&vali, &ValidateChecksumHeader::validated, this, &TestChecksumValidator::slotDownValidated);
+        connect(&vali, &ValidateChecksumHeader::validationFailed, this, &TestChecksumValidator::slotDownError);
+
+        _successDown = false;
+        vali.validate("SHA1:abc", "SHA1", "abc");
+        QVERIFY(_successDown);
+
+        _expectedError = QStringLiteral("The downloaded file does not match the checksum, it will be resumed. 'abc' != 'abd'");
+        _errorSeen = false;
+        vali.validate("SHA1:abc", "SHA1", "abd");
+        QVERIFY(_errorSeen);
+    }
 
     void cleanupTestCase() {
     }
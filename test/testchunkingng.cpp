@@ -78,6 +78,81 @@ private slots:
         QCOMPARE(fakeFolder.uploadState().children.count(), 2); // the transfer was done with chunking
     }
 
+    // The checksum of the final MOVE is computed while the chunks are sent,
+    // or from the file if the upload was resumed
+    void testTrailingChecksum()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        setChunkSize(fakeFolder.syncEngine(), 1 * 1000 * 1000);
+        const int size = 5 * 1000 * 1000;
+
+        QByteArray checksumHeader;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) == "MOVE") {
+                checksumHeader = request.rawHeader("OC-Checksum");
+            }
+            return nullptr;
+        });
+        auto expectedChecksum = [&](const QString &path) {
+            return "SHA1:" + ComputeChecksum::computeNowOnFile(fakeFolder.localPath() + path, "SHA1");
+        };
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(checksumHeader, expectedChecksum(QStringLiteral("A/a0")));
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/a0"), &record));
+        QCOMPARE(record._checksumHeader, checksumHeader);
+
+        partialUpload(fakeFolder, "A/a1", size);
+        checksumHeader.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(checksumHeader, expectedChecksum(QStringLiteral("A/a1")));
+    }
+
+    // The trailing checksum is stored in the upload info before the MOVE,
+    // a lost MOVE reply is recovered without a conflict (#5106)
+    void testTrailingChecksumMoveReplyLost()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        setChunkSize(fakeFolder.syncEngine(), 1 * 1000 * 1000);
+        const int size = 5 * 1000 * 1000;
+
+        QByteArray checksumHeader;
+        bool moveReplyLost = true;
+        int nRequests = 0;
+        QScopedValueRollback<std::chrono::seconds> setHttpTimeout(AbstractNetworkJob::httpTimeout, 1s);
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
+            if (verb == "MOVE" && moveReplyLost) {
+                checksumHeader = request.rawHeader("OC-Checksum");
+                // the server applies the MOVE, but the reply times out
+                return new DelayedReply<FakeChunkMoveReply>(24h, fakeFolder.uploadState(), fakeFolder.remoteModifier(), op, request, &fakeFolder.syncEngine());
+            }
+            if (op == QNetworkAccessManager::GetOperation || op == QNetworkAccessManager::PutOperation || verb == "MOVE") {
+                ++nRequests;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(checksumHeader, "SHA1:" + ComputeChecksum::computeNowOnFile(fakeFolder.localPath() + QStringLiteral("A/a0"), "SHA1"));
+        QCOMPARE(fakeFolder.syncJournal().getUploadInfo(QStringLiteral("A/a0"))._contentChecksum, checksumHeader);
+        fakeFolder.remoteModifier().find("A/a0")->checksums = checksumHeader; // The test system don't do that automatically
+
+        // neither uploaded again nor downloaded as a conflict
+        moveReplyLost = false;
+        nRequests = 0;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nRequests, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentLocalState().find("A")->children.size(), 3);
+    }
+
     // Test resuming when there's a confusing chunk added
     void testResume1() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
@@ -0,0 +1,101 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "configfile.h"
+#include "configstore.h"
+
+using namespace OCC;
+
+class TestConfigStore : public QObject
+{
+    Q_OBJECT
+
+    QVariant fileValue(const QString &key)
+    {
+        return QSettings(ConfigFile::configFile(), QSettings::IniFormat).value(key);
+    }
+
+private slots:
+    void testSetValue()
+    {
+        auto store = ConfigStore::instance();
+        QSignalSpy changed(store, &ConfigStore::changed);
+
+        store->setValue(QStringLiteral("Test/value"), 42);
+        QCOMPARE(store->value<int>(QStringLiteral("Test/value"), 0), 42);
+        QCOMPARE(store->value<int>(QStringLiteral("Test/missing"), 7), 7);
+        QCOMPARE(changed.count(), 1);
+        QCOMPARE(changed.first().first().toString(), QStringLiteral("Test/value"));
+
+        // nothing changes, nothing is emitted
+        store->setValue(QStringLiteral("Test/value"), 42);
+        QCOMPARE(changed.count(), 1);
+
+        // the writes are batched
+        QVERIFY(!fileValue(QStringLiteral("Test/value")).isValid());
+        QTRY_COMPARE(fileValue(QStringLiteral("Test/value")).toInt(), 42);
+    }
+
+    void testMakeQSettingsSeesPendingWrites()
+    {
+        auto store = ConfigStore::instance();
+        store->setValue(QStringLiteral("Test/pending"), QStringLiteral("value"));
+        QCOMPARE(ConfigFile::makeQSettings().value(QStringLiteral("Test/pending")).toString(), QStringLiteral("value"));
+    }
+
+    void testRemove()
+    {
+        auto store = ConfigStore::instance();
+        store->setValue(QStringLiteral("Removed/a"), 1);
+        store->setValue(QStringLiteral("Removed/sub/b"), 2);
+        store->sync();
+
+        QSignalSpy changed(store, &ConfigStore::changed);
+        store->remove(QStringLiteral("Removed"));
+        QCOMPARE(changed.count(), 1);
+        QVERIFY(!store->contains(QStringLiteral("Removed/a")));
+        QVERIFY(!store->contains(QStringLiteral("Removed/sub/b")));
+
+        store->sync();
+        QVERIFY(!fileValue(QStringLiteral("Removed/a")).isValid());
+        QVERIFY(!fileValue(QStringLiteral("Removed/sub/b")).isValid());
+    }
+
+    void testReset()
+    {
+        auto store = ConfigStore::instance();
+        QCOMPARE(store->value(QStringLiteral("Test/external")), QVariant());
+
+        // the file is only read again after a reset
+        {
+            QSettings settings(ConfigFile::configFile(), QSettings::IniFormat);
+            settings.setValue(QStringLiteral("Test/external"), 5);
+        }
+        QCOMPARE(store->value(QStringLiteral("Test/external")), QVariant());
+        store->reset();
+        QCOMPARE(store->value<int>(QStringLiteral("Test/external"), 0), 5);
+    }
+
+    void testConfigFile()
+    {
+        QSignalSpy changed(ConfigStore::instance(), &ConfigStore::changed);
+        ConfigFile cfg;
+        cfg.setUploadLimit(cfg.uploadLimit() + 1);
+        QCOMPARE(changed.count(), 1);
+        QCOMPARE(changed.first().first().toString(), QStringLiteral("BWLimit/uploadLimit"));
+        QCOMPARE(ConfigFile().uploadLimit(), cfg.uploadLimit());
+
+        // the values read for every sync come from the store
+        ConfigStore::instance()->setValue(QStringLiteral("chunkSize"), 1234);
+        QCOMPARE(cfg.chunkSize(), qint64(1234));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestConfigStore)
+#include "testconfigstore.moc"
@@ -0,0 +1,122 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QNetworkCookie>
+#include <QNetworkCookieJar>
+#include <QNetworkProxy>
+#include <QNetworkReply>
+#include <QTcpServer>
+
+#include "accessmanager.h"
+#include "connectionbroker.h"
+
+using namespace OCC;
+
+class TestConnectionBroker : public QObject
+{
+    Q_OBJECT
+
+    ConnectionBroker::PoolStatistics statistics(const QString &origin)
+    {
+        for (const auto &pool : ConnectionBroker::instance()->statistics()) {
+            if (pool.origin == origin) {
+                return pool;
+            }
+        }
+        return {};
+    }
+
+private slots:
+    void testPoolKey()
+    {
+        const QNetworkProxy noProxy(QNetworkProxy::DefaultProxy);
+        const QNetworkRequest request(QUrl(QStringLiteral("https://user@example.com/remote.php/dav")));
+        const auto key = ConnectionBroker::poolKey(request, noProxy);
+
+        // the same origin shares the pool
+        QCOMPARE(ConnectionBroker::poolKey(QNetworkRequest(QUrl(QStringLiteral("https://example.com/ocs/v2.php"))), noProxy), key);
+
+        // other origins don't
+        QVERIFY(ConnectionBroker::poolKey(QNetworkRequest(QUrl(QStringLiteral("http://example.com/remote.php/dav"))), noProxy) != key);
+        QVERIFY(ConnectionBroker::poolKey(QNetworkRequest(QUrl(QStringLiteral("https://example.com:8443/remote.php/dav"))), noProxy) != key);
+        QVERIFY(ConnectionBroker::poolKey(QNetworkRequest(QUrl(QStringLiteral("https://example.org/remote.php/dav"))), noProxy) != key);
+
+        // nor other proxies
+        QVERIFY(ConnectionBroker::poolKey(request, QNetworkProxy(QNetworkProxy::HttpProxy, QStringLiteral("proxy"), 3128)) != key);
+        QVERIFY(ConnectionBroker::poolKey(request, QNetworkProxy(QNetworkProxy::NoProxy)) != key);
+    }
+
+    void testSharedRequests()
+    {
+        // nothing listens there, the requests fail right away
+        const QString origin = QStringLiteral("http://127.0.0.1:1");
+        const QUrl url(origin + QStringLiteral("/remote.php/dav"));
+
+        auto first = new AccessManager;
+        auto second = new AccessManager;
+        first->setShareConnections(true);
+        second->setShareConnections(true);
+        first->cookieJar()->setCookiesFromUrl({ QNetworkCookie("session", "first") }, url);
+
+        auto firstReply = first->get(QNetworkRequest(url));
+        auto secondReply = second->get(QNetworkRequest(url));
+        QVERIFY(firstReply->manager() != first);
+        QCOMPARE(firstReply->manager(), secondReply->manager());
+
+        // each request only carries the cookies of its account
+        QCOMPARE(firstReply->request().header(QNetworkRequest::CookieHeader).value<QList<QNetworkCookie>>().size(), 1);
+        QVERIFY(secondReply->request().header(QNetworkRequest::CookieHeader).value<QList<QNetworkCookie>>().isEmpty());
+
+        auto pool = statistics(origin);
+        QCOMPARE(pool.managers, 2);
+        QCOMPARE(pool.requests, qint64(2));
+        QCOMPARE(pool.activeRequests, 2);
+
+        QSignalSpy firstFinished(firstReply, &QNetworkReply::finished);
+        QSignalSpy secondFinished(secondReply, &QNetworkReply::finished);
+        QVERIFY(firstFinished.count() || firstFinished.wait());
+        QVERIFY(secondFinished.count() || secondFinished.wait());
+        QCOMPARE(statistics(origin).activeRequests, 0);
+
+        // the pool goes away with the last manager using it
+        delete first;
+        QCOMPARE(statistics(origin).managers, 1);
+        delete second;
+        QVERIFY(statistics(origin).origin.isEmpty());
+    }
+
+    void testRemovedManagerAbortsReplies()
+    {
+        // accepts the connection but never answers
+        QTcpServer server;
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+        const QUrl url(QStringLiteral("http://127.0.0.1:%1/remote.php/dav").arg(server.serverPort()));
+
+        auto removed = new AccessManager;
+        auto remaining = new AccessManager;
+        removed->setShareConnections(true);
+        remaining->setShareConnections(true);
+
+        QPointer<QNetworkReply> reply = removed->get(QNetworkRequest(url));
+        QPointer<QNetworkReply> otherReply = remaining->get(QNetworkRequest(url));
+        QSignalSpy finished(reply.data(), &QNetworkReply::finished);
+        QTRY_VERIFY(server.hasPendingConnections());
+        QVERIFY(!reply->isFinished());
+
+        // the replies of the removed account do not stay in the shared pool
+        delete removed;
+        QCOMPARE(finished.count(), 1);
+        QTRY_VERIFY(reply.isNull());
+        QVERIFY(otherReply && !otherReply->isFinished());
+
+        delete remaining;
+    }
+};
+
+QTEST_GUILESS_MAIN(TestConnectionBroker)
+#include "testconnectionbroker.moc"
@@ -9,6 +9,8 @@
 #include "testutils/syncenginetestutils.h"
 #include <syncengine.h>
 
+#include "common/ownsql.h"
+
 using namespace OCC;
 
 
@@ -82,6 +84,37 @@ private slots:
             }
         }
     }
+
+    void testMoveRecordsBelowError()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+
+        // Only moving the records below a renamed directory updates the path of a record
+        auto execOnJournal = [&fakeFolder](const QByteArray &sql) {
+            fakeFolder.syncJournal().close();
+            SqlDatabase db;
+            if (!db.openOrCreateReadWrite(fakeFolder.syncJournal().databaseFilePath())) {
+                return false;
+            }
+            SqlQuery query(sql, db);
+            return query.exec();
+        };
+        QVERIFY(execOnJournal("CREATE TRIGGER failmove BEFORE UPDATE OF path ON metadata BEGIN SELECT RAISE(ABORT, 'simulated'); END;"));
+
+        fakeFolder.localModifier().rename("A", "A_renamed");
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(completeSpy.findItem("A_renamed")->_status, SyncFileItem::FatalError);
+        QVERIFY(fakeFolder.currentRemoteState().find("A_renamed/a1"));
+
+        // The next sync recovers
+        QVERIFY(execOnJournal("DROP TRIGGER failmove;"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A_renamed/a1"), &record));
+        QVERIFY(record.isValid());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestDatabaseError)
@@ -7,8 +7,10 @@
 
 #include <QtTest>
 #include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
 #include <syncengine.h>
 #include <owncloudpropagator.h>
+#include <propagatebulkdownload.h>
 
 using namespace std::chrono_literals;
 using namespace OCC;
@@ -51,7 +53,6 @@ SyncFileItemPtr getItem(const QSignalSpy &spy, const QString &path)
     return {};
 }
 
-
 class TestDownload : public QObject
 {
     Q_OBJECT
@@ -249,6 +250,143 @@ private slots:
         QCOMPARE(getItem(completeSpy, "A/resendme")->_status, SyncFileItem::NormalError);
         QVERIFY(getItem(completeSpy, "A/resendme")->_errorString.contains(serverMessage));
     }
+
+    void testBulkDownload()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        fakeFolder.account()->setCapabilities(TestUtils::archiverCapabilities());
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < 10; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/a%1").arg(i), 100 + i);
+        }
+        fakeFolder.remoteModifier().insert("A/empty", 0);
+        // needs a pax header in the archive
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/") + QString(120, QLatin1Char('l')), 10);
+        // not small
+        fakeFolder.remoteModifier().insert("A/big", 1024 * 1024);
+        // alone in its directory
+        fakeFolder.remoteModifier().mkdir("B");
+        fakeFolder.remoteModifier().insert("B/b1", 5);
+
+        int archiveRequests = 0;
+        QStringList gets;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.url().path() == sArchiverPath) {
+                ++archiveRequests;
+            } else if (op == QNetworkAccessManager::GetOperation) {
+                gets.append(getFilePathFromUrl(request.url()));
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(archiveRequests, 1);
+        gets.sort();
+        QCOMPARE(gets, QStringList({ QStringLiteral("A/big"), QStringLiteral("B/b1") }));
+
+        // recorded like a single download
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/a3"), &record));
+        QVERIFY(record.isValid());
+        QCOMPARE(record._fileSize, 103);
+        QVERIFY(record._checksumHeader.startsWith("SHA1:"));
+    }
+
+    void testBulkDownloadFallback()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        fakeFolder.account()->setCapabilities(TestUtils::archiverCapabilities());
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/a%1").arg(i), 100 + i);
+        }
+        // validated against the checksum of the discovery
+        fakeFolder.remoteModifier().find("A/a0")->checksums = "SHA1:" + QCryptographicHash::hash(QByteArray(100, 'W'), QCryptographicHash::Sha1).toHex();
+        fakeFolder.remoteModifier().find("A/a1")->checksums = "SHA1:0000000000000000000000000000000000000000";
+        const QString missingId = QString::fromUtf8(fakeFolder.remoteModifier().find("A/a2")->fileId);
+
+        bool archiveFails = false;
+        QStringList gets;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.url().path() == sArchiverPath) {
+                if (archiveFails) {
+                    return new FakeErrorReply(op, request, this, 500);
+                }
+                auto ids = QUrlQuery(request.url()).allQueryItemValues(QStringLiteral("id"), QUrl::FullyDecoded);
+                ids.removeAll(missingId);
+                return new FakePayloadReply(op, request, FakeArchiveReply::makeArchive(fakeFolder.remoteModifier(), ids), this);
+            } else if (op == QNetworkAccessManager::GetOperation) {
+                gets.append(getFilePathFromUrl(request.url()));
+            }
+            return nullptr;
+        });
+
+        // the broken and the missing entry are downloaded on their own
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        gets.sort();
+        QCOMPARE(gets, QStringList({ QStringLiteral("A/a1"), QStringLiteral("A/a2") }));
+
+        // everything is downloaded on its own if the archive request fails
+        archiveFails = true;
+        gets.clear();
+        fakeFolder.remoteModifier().mkdir("B");
+        fakeFolder.remoteModifier().insert("B/b1", 10);
+        fakeFolder.remoteModifier().insert("B/b2", 20);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        gets.sort();
+        QCOMPARE(gets, QStringList({ QStringLiteral("B/b1"), QStringLiteral("B/b2") }));
+    }
+
+    // the temporary files are recorded like those of a single download
+    void testBulkDownloadRecordsTmpFiles()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        fakeFolder.account()->setCapabilities(TestUtils::archiverCapabilities());
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/a%1").arg(i), 100 + i);
+        }
+
+        QObject parent;
+        bool hangs = true;
+        int downloadInfos = 0;
+        QString tmpFile;
+        int activeJobs = 0;
+        bool bulkJobActive = false;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (hangs && request.url().path() == sArchiverPath) {
+                QTimer::singleShot(0, &fakeFolder.syncEngine(), [&]() {
+                    downloadInfos = fakeFolder.syncJournal().downloadInfoCount();
+                    tmpFile = fakeFolder.syncJournal().getDownloadInfo(QStringLiteral("A/a0"))._tmpfile;
+                    const auto &activeJobList = fakeFolder.syncEngine().getPropagator()->_activeJobList;
+                    activeJobs = activeJobList.size();
+                    bulkJobActive = activeJobs == 1 && qobject_cast<PropagateBulkDownload *>(activeJobList.first());
+                    fakeFolder.syncEngine().abort();
+                });
+                return new FakeHangingReply(op, request, &parent);
+            }
+            return nullptr;
+        });
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(downloadInfos, 5);
+        QVERIFY(!tmpFile.isEmpty());
+        // the archive takes one transfer slot
+        QCOMPARE(activeJobs, 1);
+        QVERIFY(bulkJobActive);
+
+        // the aborted batch leaves nothing behind
+        QCOMPARE(fakeFolder.syncJournal().downloadInfoCount(), 0);
+        QVERIFY(!QFileInfo::exists(fakeFolder.localPath() + tmpFile));
+
+        hangs = false;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.syncJournal().downloadInfoCount(), 0);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestDownload)
@@ -12,8 +12,10 @@
 #include "common/utility.h"
 #include "folderman.h"
 #include "account.h"
+#include "accountmanager.h"
 #include "accountstate.h"
 #include "configfile.h"
+#include "folder.h"
 
 #include "testutils/testutils.h"
 
@@ -152,6 +154,72 @@ private slots:
         }
     }
 
+    void testDrivesEtagJobs()
+    {
+        AccountPtr account = TestUtils::createDummyAccount();
+        AccountStatePtr accountState = AccountManager::instance()->account(account->uuid());
+        QVERIFY(accountState);
+        FolderMan *folderman = TestUtils::folderMan();
+
+        // the entry is removed when the listing finishes
+        folderman->checkEtagsWithDrives(accountState.data(), {});
+        QVERIFY(folderman->_drivesEtagJobs.value(account->uuid()));
+        folderman->_drivesEtagJobs.value(account->uuid())->abort();
+        QTRY_VERIFY(!folderman->_drivesEtagJobs.contains(account->uuid()));
+
+        // and when the account is removed
+        folderman->checkEtagsWithDrives(accountState.data(), {});
+        QVERIFY(folderman->_drivesEtagJobs.value(account->uuid()));
+        folderman->slotRemoveFoldersForAccount(accountState);
+        QVERIFY(!folderman->_drivesEtagJobs.contains(account->uuid()));
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        auto folder = folderman->addFolder(accountState, TestUtils::createDummyFolderDefinition(account, dir.path()));
+        QVERIFY(folder);
+        QTRY_VERIFY(folder->isReady());
+        accountState->setState(AccountState::Connected);
+        QVERIFY(folder->canSync());
+        // the PROPFIND finds the etag the folder already knows, no sync is scheduled
+        folder->_lastEtag = "root";
+        const auto finishEtagJob = [&folder](bool success) {
+            QVERIFY(folder->_requestEtagJob);
+            if (success) {
+                emit folder->_requestEtagJob->etagRetreived("root", QDateTime::currentDateTimeUtc());
+            }
+            delete folder->_requestEtagJob.data();
+        };
+
+        // a changed drives etag runs the PROPFIND
+        folder->etagRetrievedFromDrives("drives1");
+        QVERIFY(folder->_requestEtagJob);
+        // it failed, the change is not hidden
+        finishEtagJob(false);
+        QVERIFY(folder->_lastDrivesEtag.isEmpty());
+        folder->etagRetrievedFromDrives("drives1");
+        QVERIFY(folder->_requestEtagJob);
+        finishEtagJob(true);
+        QCOMPARE(folder->_lastDrivesEtag, QByteArray("drives1"));
+
+        // an unchanged drives etag skips the PROPFIND
+        folder->etagRetrievedFromDrives("drives1");
+        QVERIFY(!folder->_requestEtagJob);
+
+        // a change while a PROPFIND is queued is kept for the next one
+        folder->etagRetrievedFromDrives("drives2");
+        QVERIFY(folder->_requestEtagJob);
+        folder->etagRetrievedFromDrives("drives3");
+        finishEtagJob(true);
+        QCOMPARE(folder->_lastDrivesEtag, QByteArray("drives2"));
+        folder->etagRetrievedFromDrives("drives3");
+        QVERIFY(folder->_requestEtagJob);
+        finishEtagJob(true);
+        QCOMPARE(folder->_lastDrivesEtag, QByteArray("drives3"));
+
+        folderman->removeFolder(folder);
+        accountState->setState(AccountState::Disconnected);
+    }
+
     void testFindGoodPathForNewSyncFolder()
     {
         // SETUP
@@ -0,0 +1,144 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "testutils/syncenginetestutils.h"
+#include <memorybudget.h>
+#include <syncengine.h>
+
+using namespace OCC;
+
+class TestMemoryBudget : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup()
+    {
+        MemoryBudget::instance()->setBudget(0);
+    }
+
+    void testReservation()
+    {
+        auto budget = MemoryBudget::instance();
+        const auto before = budget->usage(MemoryBudget::Component::SyncItems);
+        {
+            MemoryBudget::Reservation reservation(MemoryBudget::Component::SyncItems);
+            reservation.add(100);
+            QCOMPARE(budget->usage(MemoryBudget::Component::SyncItems), before + 100);
+
+            // never releases more than was added
+            reservation.release(150);
+            QCOMPARE(reservation.bytes(), qint64(0));
+            QCOMPARE(budget->usage(MemoryBudget::Component::SyncItems), before);
+
+            reservation.add(50);
+            auto moved = std::move(reservation);
+            QCOMPARE(reservation.bytes(), qint64(0));
+            QCOMPARE(moved.bytes(), qint64(50));
+            QCOMPARE(budget->usage(MemoryBudget::Component::SyncItems), before + 50);
+
+            budget->setBudget(budget->totalUsage());
+            QVERIFY(budget->isExhausted());
+        }
+        QCOMPARE(budget->usage(MemoryBudget::Component::SyncItems), before);
+        QVERIFY(!budget->isExhausted());
+    }
+
+    void testSyncOverBudget()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        for (int i = 0; i < 20; ++i) {
+            const auto dir = QStringLiteral("dir%1").arg(i);
+            fakeFolder.remoteModifier().mkdir(dir);
+            fakeFolder.remoteModifier().mkdir(dir + QStringLiteral("/sub"));
+            fakeFolder.remoteModifier().insert(dir + QStringLiteral("/sub/file"));
+        }
+
+        // the discovery goes on one directory at a time
+        MemoryBudget::instance()->setBudget(1);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // everything was released after the sync
+        for (int i = 0; i < static_cast<int>(MemoryBudget::Component::ComponentCount); ++i) {
+            QCOMPARE(MemoryBudget::instance()->usage(static_cast<MemoryBudget::Component>(i)), qint64(0));
+        }
+    }
+
+    void testParallelDiscoveryResumesUnderBudget()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        for (int i = 0; i < 20; ++i) {
+            const auto dir = QStringLiteral("dir%1").arg(i);
+            fakeFolder.remoteModifier().mkdir(dir);
+            fakeFolder.remoteModifier().mkdir(dir + QStringLiteral("/sub"));
+            fakeFolder.remoteModifier().insert(dir + QStringLiteral("/sub/file"));
+        }
+
+        // something else holds more than the budget
+        MemoryBudget::Reservation other(MemoryBudget::Component::DirectoryJobs);
+        other.add(2 * 1024 * 1024);
+        MemoryBudget::instance()->setBudget(1024 * 1024);
+        QVERIFY(MemoryBudget::instance()->isExhausted());
+
+        int propfinds = 0;
+        int inFlight = 0;
+        int maxInFlightOverBudget = 0;
+        int maxInFlightUnderBudget = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) != QLatin1String("PROPFIND")) {
+                return nullptr;
+            }
+            // the other reservation goes away after a few listings
+            if (++propfinds == 5) {
+                other.reset();
+            }
+            ++inFlight;
+            auto &maxInFlight = MemoryBudget::instance()->isExhausted() ? maxInFlightOverBudget : maxInFlightUnderBudget;
+            maxInFlight = std::max(maxInFlight, inFlight);
+            auto reply = new DelayedReply<FakePropfindReply>(std::chrono::milliseconds(20), fakeFolder.remoteModifier(), op, request, this);
+            connect(reply, &QNetworkReply::finished, this, [&inFlight] { --inFlight; });
+            return reply;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // over budget one directory at a time, afterwards the listings run in parallel again
+        QCOMPARE(maxInFlightOverBudget, 1);
+        QVERIFY(maxInFlightUnderBudget > 1);
+    }
+
+    void testItemsReleasedWhilePropagating()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        for (int i = 0; i < 20; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("file%1").arg(i));
+        }
+
+        // the upload sets the etag, file id and checksum of the items
+        QVector<qint64> usage;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&usage](const SyncFileItemPtr &item) {
+            if (!item->_file.isEmpty()) {
+                usage.append(MemoryBudget::instance()->usage(MemoryBudget::Component::SyncItems));
+            }
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // each item releases what it added
+        QCOMPARE(usage.size(), 20);
+        for (int i = 0; i < usage.size() - 1; ++i) {
+            QVERIFY(usage[i] > usage[i + 1]);
+        }
+        QCOMPARE(usage.last(), qint64(0));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMemoryBudget)
+#include "testmemorybudget.moc"
@@ -0,0 +1,101 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "testutils/syncenginetestutils.h"
+#include <metrics.h>
+#include <syncengine.h>
+
+using namespace OCC;
+
+class TestMetrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        Metrics::instance()->reset();
+    }
+
+    void testPrometheusText()
+    {
+        auto metrics = Metrics::instance();
+        metrics->incrementCounter(QStringLiteral("sync_runs_total"), 1, { { QStringLiteral("result"), QStringLiteral("success") } });
+        metrics->incrementCounter(QStringLiteral("sync_runs_total"), 2, { { QStringLiteral("result"), QStringLiteral("success") } });
+        metrics->setGauge(QStringLiteral("sync_propagator_active_jobs"), 3);
+        metrics->observe(QStringLiteral("sync_duration_seconds"), 0.2);
+        metrics->observe(QStringLiteral("sync_duration_seconds"), 7);
+
+        const auto text = metrics->toPrometheusText();
+        QVERIFY(text.contains("# TYPE sync_runs_total counter\n"));
+        QVERIFY(text.contains("sync_runs_total{result=\"success\"} 3\n"));
+        QVERIFY(text.contains("sync_propagator_active_jobs 3\n"));
+        QVERIFY(text.contains("# TYPE sync_duration_seconds histogram\n"));
+        QVERIFY(text.contains("sync_duration_seconds_bucket{le=\"0.1\"} 0\n"));
+        QVERIFY(text.contains("sync_duration_seconds_bucket{le=\"0.5\"} 1\n"));
+        QVERIFY(text.contains("sync_duration_seconds_bucket{le=\"10\"} 2\n"));
+        QVERIFY(text.contains("sync_duration_seconds_bucket{le=\"+Inf\"} 2\n"));
+        QVERIFY(text.contains("sync_duration_seconds_sum 7.2\n"));
+        QVERIFY(text.contains("sync_duration_seconds_count 2\n"));
+        // metrics without values are not listed
+        QVERIFY(!text.contains("sync_discovery_duration_seconds"));
+    }
+
+    void testLabelEscaping()
+    {
+        Metrics::instance()->setGauge(QStringLiteral("sync_journal_size_bytes"), 1, { { QStringLiteral("journal"), QStringLiteral("a\"b\\c") } });
+        QVERIFY(Metrics::instance()->toPrometheusText().contains("sync_journal_size_bytes{journal=\"a\\\"b\\\\c\"} 1\n"));
+    }
+
+    void testSyncUpdatesMetrics()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert(QStringLiteral("A/new"), 100);
+        QVERIFY(fakeFolder.syncOnce());
+
+        const auto text = Metrics::instance()->toPrometheusText();
+        QVERIFY(text.contains("sync_runs_total{result=\"success\"} 1\n"));
+        QVERIFY(text.contains("sync_discovery_duration_seconds_count 1\n"));
+        QVERIFY(text.contains("sync_items_total{direction=\"Up\",status=\"Success\"} 1\n"));
+        QVERIFY(text.contains("sync_transferred_bytes_total{direction=\"Up\"} 100\n"));
+        QVERIFY(text.contains("sync_discovery_listings_total{result=\"success\",source=\"remote\"}"));
+        QVERIFY(text.contains("sync_journal_size_bytes{journal="));
+    }
+
+    void testNoWakeupsWhileIdle()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"), 100);
+
+        QObject parent;
+        QPointer<QNetworkReply> download;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && getFilePathFromUrl(request.url()) == QLatin1String("A/new")) {
+                download = new FakeHangingReply(op, request, &parent);
+                return download;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.scheduleSync();
+        QTRY_VERIFY(download);
+        const auto propagator = fakeFolder.syncEngine().getPropagator();
+        QVERIFY(propagator);
+        QVERIFY(propagator->_bandwidthManager.hasActiveTimers());
+
+        // the timers stop with the last transfer
+        download->abort();
+        QVERIFY(!fakeFolder.execUntilFinished());
+        QTRY_VERIFY(!propagator->_bandwidthManager.hasTransfers());
+        QVERIFY(!propagator->_bandwidthManager.hasActiveTimers());
+        QVERIFY(!Metrics::instance()->toPrometheusText().contains("sync_timer_wakeups_total"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMetrics)
+#include "testmetrics.moc"
@@ -9,12 +9,40 @@
 
 #include "propagatedownload.h"
 #include "owncloudpropagator_p.h"
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
 
 using namespace OCC;
 namespace OCC {
 QString OWNCLOUDSYNC_EXPORT createDownloadTmpFileName(const QString &previous);
 }
 
+namespace {
+int expectedPendingJobs(const PropagatorCompositeJob &composite);
+
+/// The pending jobs found by walking the job tree, like the scheduler did before it kept count
+int expectedPendingJobs(const PropagateDirectory &directory)
+{
+    int pending = directory._firstJob && directory._firstJob->_state == PropagatorJob::NotYetStarted ? 1 : 0;
+    pending += expectedPendingJobs(directory._subJobs);
+    if (auto root = qobject_cast<const PropagateRootDirectory *>(&directory)) {
+        pending += expectedPendingJobs(root->_dirDeletionJobs);
+    }
+    return pending;
+}
+
+int expectedPendingJobs(const PropagatorCompositeJob &composite)
+{
+    int pending = composite._jobsToDo.size() + static_cast<int>(composite._tasksToDo.size() + composite._directoriesToDo.size());
+    for (auto *job : composite._runningJobs) {
+        if (auto directory = qobject_cast<PropagateDirectory *>(job)) {
+            pending += expectedPendingJobs(*directory);
+        }
+    }
+    return pending;
+}
+}
+
 class TestOwncloudPropagator : public QObject
 {
     Q_OBJECT
@@ -63,6 +91,133 @@ private slots:
         }
     }
 
+    void testPendingJobCount()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.account()->setCapabilities(TestUtils::archiverCapabilities());
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 1;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // nested directories with small new files that are fetched in archives
+        fakeFolder.remoteModifier().mkdir("D");
+        fakeFolder.remoteModifier().mkdir("D/E");
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("D/d%1").arg(i), 100 + i);
+            fakeFolder.remoteModifier().insert(QStringLiteral("D/E/e%1").arg(i), 100 + i);
+        }
+        // a task of the root, a blocking directory move and a deferred directory removal
+        fakeFolder.localModifier().insert("root");
+        fakeFolder.localModifier().rename("B", "B2");
+        fakeFolder.remoteModifier().remove("C");
+
+        // the missing entry is appended as a single download
+        const QString missingId = QString::fromUtf8(fakeFolder.remoteModifier().find("D/d2")->fileId);
+        int archiveRequests = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.url().path() == sArchiverPath) {
+                ++archiveRequests;
+                auto ids = QUrlQuery(request.url()).allQueryItemValues(QStringLiteral("id"), QUrl::FullyDecoded);
+                ids.removeAll(missingId);
+                return new FakePayloadReply(op, request, FakeArchiveReply::makeArchive(fakeFolder.remoteModifier(), ids), this);
+            }
+            return nullptr;
+        });
+
+        int checks = 0;
+        int mismatches = 0;
+        int pendingWhenFinished = -1;
+        auto check = [&] {
+            const auto propagator = fakeFolder.syncEngine().getPropagator();
+            if (!propagator || !propagator->rootJob()) {
+                return;
+            }
+            auto root = propagator->rootJob();
+            ++checks;
+            if (root->pendingJobCount() != expectedPendingJobs(*root)) {
+                qWarning() << "pending jobs" << root->pendingJobCount() << "expected" << expectedPendingJobs(*root);
+                ++mismatches;
+            }
+        };
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&] {
+            // once all jobs are appended, before anything is scheduled
+            QTimer::singleShot(0, &fakeFolder.syncEngine(), [&] {
+                check();
+                QVERIFY(fakeFolder.syncEngine().getPropagator()->rootJob()->pendingJobCount() > 0);
+                connect(fakeFolder.syncEngine().getPropagator().data(), &OwncloudPropagator::finished, this, [&] {
+                    pendingWhenFinished = fakeFolder.syncEngine().getPropagator()->rootJob()->pendingJobCount();
+                });
+            });
+        });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, check);
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(archiveRequests, 2);
+        QVERIFY(checks > 20);
+        QCOMPARE(mismatches, 0);
+        QCOMPARE(pendingWhenFinished, 0);
+    }
+
+    void testDirectoryJobsCreatedWhenScheduled()
+    {
+        FakeFolder fakeFolder { FileInfo {} };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 1;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        fakeFolder.remoteModifier().mkdir("X");
+        fakeFolder.remoteModifier().insert("X/x");
+        QVERIFY(fakeFolder.syncOnce());
+
+        for (int i = 0; i < 10; ++i) {
+            fakeFolder.remoteModifier().mkdir(QStringLiteral("D%1").arg(i));
+            fakeFolder.remoteModifier().insert(QStringLiteral("D%1/f").arg(i));
+        }
+        fakeFolder.remoteModifier().mkdir("D0/S");
+        fakeFolder.remoteModifier().insert("D0/S/s");
+        fakeFolder.remoteModifier().insert("r");
+        // removed at the very end
+        fakeFolder.remoteModifier().remove("X");
+
+        QStringList completed;
+        QStringList files;
+        int maxDirectoryJobs = 0;
+        int waitingDirectories = -1;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&](const SyncFileItemPtr &item) {
+            completed.append(item->destination());
+            if (item->_type == ItemTypeFile) {
+                files.append(item->destination());
+            }
+            const auto propagator = fakeFolder.syncEngine().getPropagator();
+            if (!propagator || !propagator->rootJob()) {
+                return;
+            }
+            const auto directoryJobs = propagator->findChildren<PropagateDirectory *>(QString(), Qt::FindDirectChildrenOnly);
+            maxDirectoryJobs = std::max<int>(maxDirectoryJobs, std::count_if(directoryJobs.cbegin(), directoryJobs.cend(), [](PropagateDirectory *job) {
+                return job->_state != PropagatorJob::Finished;
+            }));
+            if (waitingDirectories < 0) {
+                waitingDirectories = static_cast<int>(propagator->rootJob()->_subJobs._directoriesToDo.size());
+            }
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // only the directories on the current path are jobs: the root, the removal of X, D0 and D0/S
+        QCOMPARE(waitingDirectories, 9);
+        QVERIFY(maxDirectoryJobs <= 4);
+
+        // subdirectories before the files of a directory, in order, the removal last
+        QStringList expectedFiles { QStringLiteral("D0/S/s") };
+        for (int i = 0; i < 10; ++i) {
+            expectedFiles.append(QStringLiteral("D%1/f").arg(i));
+        }
+        expectedFiles.append(QStringLiteral("r"));
+        QCOMPARE(files, expectedFiles);
+        QCOMPARE(completed.last(), QStringLiteral("X"));
+    }
+
     void testParseEtag()
     {
         typedef QPair<const char*, const char*> Test;
@@ -78,5 +233,5 @@ private slots:
     }
 };
 
-QTEST_APPLESS_MAIN(TestOwncloudPropagator)
+QTEST_GUILESS_MAIN(TestOwncloudPropagator)
 #include "testowncloudpropagator.moc"
@@ -238,6 +238,52 @@ private slots:
         QCOMPARE(finishedSpy.first().first().toBool(), false);
     }
 
+    /** In upload only mode the remote folder is not listed and the content
+     * checksums computed during the discovery are sent with the uploads. */
+    void testUploadOnly()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._uploadOnly = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        int nListings = 0;
+        QStringList checksums;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND" && request.rawHeader("Depth") == "1") {
+                ++nListings;
+            } else if (op == QNetworkAccessManager::PutOperation) {
+                checksums.append(QString::fromLatin1(request.rawHeader("OC-Checksum")));
+            }
+            return nullptr;
+        });
+
+        // the checksums are known before the propagation starts
+        QStringList discoveredChecksums;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&](const SyncFileItemSet &items) {
+            for (const auto &item : items) {
+                if (item->_type == ItemTypeFile) {
+                    discoveredChecksums.append(QString::fromLatin1(item->_checksumHeader));
+                }
+            }
+        });
+
+        fakeFolder.localModifier().mkdir("A");
+        fakeFolder.localModifier().insert("A/a1");
+        fakeFolder.localModifier().insert("b", 32);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(nListings, 0);
+        QCOMPARE(discoveredChecksums.size(), 2);
+        for (const auto &checksum : discoveredChecksums) {
+            QVERIFY(checksum.startsWith(QLatin1String("SHA1:")));
+        }
+        // the upload sends the checksums of the discovery
+        discoveredChecksums.sort();
+        checksums.sort();
+        QCOMPARE(checksums, discoveredChecksums);
+    }
+
     /** Verify that an incompletely propagated directory doesn't have the server's
      * etag stored in the database yet. */
     void testDirEtagAfterIncompleteSync() {
@@ -723,6 +769,33 @@ private slots:
         QCOMPARE(nPUT, 3);
     }
 
+    void testAbortWhileRecording()
+    {
+        QTemporaryDir recorderDir;
+        qputenv("OWNCLOUD_SYNC_RECORDER_DIR", recorderDir.path().toUtf8());
+        auto cleanup = qScopeGuard([] { qunsetenv("OWNCLOUD_SYNC_RECORDER_DIR"); });
+
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+
+        QObject parent;
+        QPointer<QNetworkReply> pendingListing;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND" && getFilePathFromUrl(request.url()) == QLatin1String("A")) {
+                pendingListing = new FakeHangingReply(op, request, &parent);
+                QTimer::singleShot(0, &fakeFolder.syncEngine(), [&]() { fakeFolder.syncEngine().abort(); });
+                return pendingListing;
+            }
+            return nullptr;
+        });
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(QDir(recorderDir.path()).entryList(QDir::Files).size(), 1);
+
+        // the listing finishes after the recorder was saved and deleted
+        QVERIFY(pendingListing);
+        pendingListing->abort();
+        QCoreApplication::processEvents();
+    }
+
 #ifndef Q_OS_WIN
     void testPropagatePermissions()
     {
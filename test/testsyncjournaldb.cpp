@@ -192,6 +192,72 @@ private slots:
         QVERIFY(!_db.conflictRecord(record.path).isValid());
     }
 
+    void testChecksumCache()
+    {
+        _db.takeChecksumCacheStatistics();
+
+        ChecksumCacheKey key;
+        key.inode = 42;
+        key.size = 100;
+        key.modtime = 1234000;
+        key.ctime = 1234500;
+        QVERIFY(_db.getCachedChecksum(key, "SHA1").isNull());
+
+        _db.setCachedChecksum(key, "SHA1", "abcdef");
+        QCOMPARE(_db.getCachedChecksum(key, "SHA1"), QByteArray("abcdef"));
+        QVERIFY(_db.getCachedChecksum(key, "MD5").isNull());
+
+        // any change of the file invalidates the entry
+        auto changed = key;
+        changed.size = 101;
+        QVERIFY(_db.getCachedChecksum(changed, "SHA1").isNull());
+        changed = key;
+        changed.modtime += 1;
+        QVERIFY(_db.getCachedChecksum(changed, "SHA1").isNull());
+        changed = key;
+        changed.ctime += 1;
+        QVERIFY(_db.getCachedChecksum(changed, "SHA1").isNull());
+
+        // a new checksum for the same inode replaces the old one
+        _db.setCachedChecksum(changed, "SHA1", "123456");
+        QVERIFY(_db.getCachedChecksum(key, "SHA1").isNull());
+        QCOMPARE(_db.getCachedChecksum(changed, "SHA1"), QByteArray("123456"));
+
+        const auto statistics = _db.takeChecksumCacheStatistics();
+        QCOMPARE(statistics.hits, qint64(2));
+        QCOMPARE(statistics.misses, qint64(6));
+        QCOMPARE(_db.takeChecksumCacheStatistics().hits, qint64(0));
+
+        // recently used entries are kept
+        _db.deleteStaleChecksumCacheEntries();
+        QCOMPARE(_db.getCachedChecksum(changed, "SHA1"), QByteArray("123456"));
+    }
+
+    void testErrorBlacklist()
+    {
+        SyncJournalErrorBlacklistRecord record;
+        record._file = QStringLiteral("blacklisted/file");
+        record._errorString = QStringLiteral("error");
+        record._lastTryEtag = "etag";
+        record._lastTryTime = 1;
+        record._ignoreDuration = 10;
+        record._errorCategory = SyncJournalErrorBlacklistRecord::Category::Normal;
+        _db.setErrorBlacklistEntry(record);
+        QCOMPARE(_db.errorBlacklistEntry(record._file)._errorString, record._errorString);
+        QVERIFY(!_db.errorBlacklistEntry(QStringLiteral("blacklisted")).isValid());
+
+        // the index is rebuilt when the db is reopened
+        _db.close();
+        QVERIFY(_db.errorBlacklistEntry(record._file).isValid());
+
+        _db.deleteStaleErrorBlacklistEntries({});
+        QVERIFY(!_db.errorBlacklistEntry(record._file).isValid());
+
+        _db.setErrorBlacklistEntry(record);
+        QCOMPARE(_db.wipeErrorBlacklist(), 1);
+        QVERIFY(!_db.errorBlacklistEntry(record._file).isValid());
+    }
+
     void testAvoidReadFromDbOnNextSync()
     {
         auto invalidEtag = QByteArray("_invalid_");
@@ -312,6 +378,113 @@ private slots:
         QVERIFY(checkElements());
     }
 
+    void testMoveFileRecordsBelow()
+    {
+        auto makeEntry = [&](const QByteArray &path, const QByteArray &fileId) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._fileId = fileId;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            _db.setFileRecord(record);
+        };
+        auto fileId = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            _db.getFileRecord(path, &record);
+            return record.isValid() ? record._fileId : QByteArray();
+        };
+
+        makeEntry("movefrom", "dir");
+        makeEntry("movefrom/file", "file");
+        makeEntry("movefrom/sub", "sub");
+        makeEntry("movefrom/sub/file", "subfile");
+        makeEntry("movefrom_other/file", "other");
+        makeEntry("movefrom_other", "otherdir");
+        _db.internalPinStates().setForPath("movefrom", PinState::OnlineOnly);
+        _db.internalPinStates().setForPath("movefrom/sub", PinState::AlwaysLocal);
+
+        QVERIFY(_db.moveFileRecordsBelow(QStringLiteral("movefrom"), QStringLiteral("moved/to")));
+
+        // the records are found with their new path
+        QCOMPARE(fileId("moved/to/file"), QByteArray("file"));
+        QCOMPARE(fileId("moved/to/sub"), QByteArray("sub"));
+        QCOMPARE(fileId("moved/to/sub/file"), QByteArray("subfile"));
+        QVERIFY(fileId("movefrom/file").isEmpty());
+        QVERIFY(fileId("movefrom/sub/file").isEmpty());
+        QCOMPARE(*_db.internalPinStates().rawForPath("moved/to/sub"), PinState::AlwaysLocal);
+        QCOMPARE(*_db.internalPinStates().rawForPath("movefrom/sub"), PinState::Inherited);
+
+        // the directory itself and its siblings are left alone
+        QCOMPARE(fileId("movefrom"), QByteArray("dir"));
+        QVERIFY(fileId("moved/to").isEmpty());
+        QCOMPARE(*_db.internalPinStates().rawForPath("movefrom"), PinState::OnlineOnly);
+        QCOMPARE(fileId("movefrom_other"), QByteArray("otherdir"));
+        QCOMPARE(fileId("movefrom_other/file"), QByteArray("other"));
+
+        // records already written at the destination are kept, the old ones are dropped
+        makeEntry("back/file", "new");
+        QVERIFY(_db.moveFileRecordsBelow(QStringLiteral("moved/to"), QStringLiteral("back")));
+        QCOMPARE(fileId("back/file"), QByteArray("new"));
+        QCOMPARE(fileId("back/sub/file"), QByteArray("subfile"));
+        QVERIFY(fileId("moved/to/file").isEmpty());
+
+        _db.deleteFileRecord(QStringLiteral("movefrom"), true);
+        _db.deleteFileRecord(QStringLiteral("movefrom_other"), true);
+        _db.deleteFileRecord(QStringLiteral("back"), true);
+        _db.internalPinStates().wipeForPathAndBelow("");
+    }
+
+    void testHydrationCounts()
+    {
+        auto makeEntry = [&](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            _db.setFileRecord(record);
+        };
+        auto check = [&](const QByteArray &path, bool hydrated, bool dehydrated) {
+            const auto result = _db.hasHydratedOrDehydratedFiles(path);
+            return result && result->hasHydrated == hydrated && result->hasDehydrated == dehydrated;
+        };
+
+        makeEntry("hydration", ItemTypeDirectory);
+        makeEntry("hydration/a", ItemTypeDirectory);
+        makeEntry("hydration/a/file", ItemTypeFile);
+        makeEntry("hydration/b", ItemTypeDirectory);
+        makeEntry("hydration/b/sub", ItemTypeDirectory);
+        makeEntry("hydration/b/sub/virtual", ItemTypeVirtualFile);
+        makeEntry("hydration/empty", ItemTypeDirectory);
+
+        // the first call loads the counts from the db
+        QVERIFY(check("hydration", true, true));
+        QVERIFY(check("hydration/a", true, false));
+        QVERIFY(check("hydration/a/file", true, false));
+        QVERIFY(check("hydration/b", false, true));
+        QVERIFY(check("hydration/b/sub/virtual", false, true));
+        QVERIFY(check("hydration/empty", false, false));
+        QVERIFY(check("hydration/missing", false, false));
+
+        // they are updated with the records
+        makeEntry("hydration/b/sub/virtual", ItemTypeFile);
+        QVERIFY(check("hydration/b", true, false));
+        makeEntry("hydration/a/file", ItemTypeVirtualFileDownload);
+        QVERIFY(check("hydration", false, true));
+        makeEntry("hydration/empty/file", ItemTypeFile);
+        QVERIFY(check("hydration/empty", true, false));
+
+        _db.deleteFileRecord("hydration/a/file");
+        QVERIFY(check("hydration/a", false, false));
+        QVERIFY(check("hydration", true, false));
+
+        _db.deleteFileRecord("hydration/b", true);
+        QVERIFY(check("hydration/b", false, false));
+        QVERIFY(check("hydration/b/sub", false, false));
+        QVERIFY(check("hydration", true, false));
+
+        _db.deleteFileRecord("hydration/empty", true);
+        QVERIFY(check("hydration", false, false));
+    }
+
     void testPinState()
     {
         auto make = [&](const QByteArray &path, PinState state) {
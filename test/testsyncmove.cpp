@@ -611,6 +611,35 @@ private slots:
         QCOMPARE(counter.nDELETE, 0);
     }
 
+    // The records of the unchanged files below a renamed directory are moved without items
+    void testRenameDirectoryMovesRecords()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        auto &local = fakeFolder.localModifier();
+        auto &remote = fakeFolder.remoteModifier();
+
+        local.rename("A", "AM");
+        remote.rename("B", "BM");
+        remote.rename("S", "SM");
+        remote.appendByte("SM/s1");
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(printDbData(fakeFolder.dbState()), printDbData(fakeFolder.currentRemoteState()));
+        QVERIFY(itemSuccessfulMove(completeSpy, "AM"));
+        QVERIFY(itemSuccessfulMove(completeSpy, "BM"));
+        QVERIFY(itemSuccessfulMove(completeSpy, "SM"));
+        QVERIFY(completeSpy.findItem("AM/a1").isNull());
+        QVERIFY(completeSpy.findItem("BM/b2").isNull());
+        QVERIFY(itemSuccessful(completeSpy, "SM/s1", CSYNC_INSTRUCTION_SYNC));
+
+        // nothing is left to do
+        completeSpy.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(completeSpy.isEmpty());
+    }
+
     // Check interaction of moves with file type changes
     void testMoveAndTypeChange()
     {
@@ -0,0 +1,118 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "testutils/syncenginetestutils.h"
+#include "testutils/syncreplay.h"
+#include <common/utility.h>
+#include <syncengine.h>
+
+using namespace OCC;
+
+namespace {
+// the anonymized names can't be compared, the depth, type and size of each entry can
+QStringList treeShape(const FileInfo &dir, int depth = 0)
+{
+    QStringList out;
+    for (const auto &child : dir.children) {
+        out.append(QStringLiteral("%1:%2:%3").arg(QString::number(depth), child.isDir ? QStringLiteral("d") : QStringLiteral("f"), QString::number(child.isDir ? 0 : child.fileSize)));
+        out.append(treeShape(child, depth + 1));
+    }
+    out.sort();
+    return out;
+}
+
+QString itemKey(int instruction, const QString &direction)
+{
+    return QStringLiteral("%1:%2").arg(QString::number(instruction), direction);
+}
+}
+
+class TestSyncRecorder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRecordReplayRoundTrip()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/secretname"), 64);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("D/d1"), 12);
+        fakeFolder.localModifier().insert(QStringLiteral("B/localfile"), 33);
+        fakeFolder.localModifier().appendByte(QStringLiteral("S/s1"));
+        fakeFolder.remoteModifier().remove(QStringLiteral("C/c1"));
+        const auto remoteBefore = fakeFolder.currentRemoteState();
+        const auto localBefore = fakeFolder.currentLocalState();
+
+        // only record this sync, not the initial one of the FakeFolder
+        QTemporaryDir recorderDir;
+        qputenv("OWNCLOUD_SYNC_RECORDER_DIR", recorderDir.path().toUtf8());
+        auto cleanup = qScopeGuard([] { qunsetenv("OWNCLOUD_SYNC_RECORDER_DIR"); });
+        QStringList recordedItems;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&](const SyncFileItemPtr &item) {
+            recordedItems.append(itemKey(item->_instruction, Utility::enumToString(item->_direction)));
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        qunsetenv("OWNCLOUD_SYNC_RECORDER_DIR");
+
+        const auto traces = QDir(recorderDir.path()).entryInfoList(QDir::Files);
+        QCOMPARE(traces.size(), 1);
+        QVERIFY(traces.first().fileName().endsWith(QLatin1String(".jsonl")));
+
+        // every record is a line of its own and nothing is written in plain text
+        QFile traceFile(traces.first().absoluteFilePath());
+        QVERIFY(traceFile.open(QIODevice::ReadOnly));
+        const auto content = traceFile.readAll();
+        QVERIFY(!content.contains("secretname"));
+        QVERIFY(!content.contains("localfile"));
+        QSet<QString> kinds;
+        for (const auto &line : content.split('\n')) {
+            if (line.isEmpty()) {
+                continue;
+            }
+            const auto doc = QJsonDocument::fromJson(line);
+            QVERIFY(doc.isObject());
+            kinds.insert(doc.object().value(QStringLiteral("kind")).toString());
+        }
+        QCOMPARE(kinds,
+            QSet<QString>({ QStringLiteral("header"), QStringLiteral("journal"), QStringLiteral("remoteListing"), QStringLiteral("localListing"),
+                QStringLiteral("item"), QStringLiteral("phase") }));
+
+        const auto trace = SyncTrace::load(traceFile.fileName());
+        QVERIFY(trace);
+        QCOMPARE(trace->items.size(), recordedItems.size());
+        QCOMPARE(trace->phases.size(), 3);
+
+        // the replay starts from what the recorded sync saw
+        auto replay = createReplayFolder(*trace);
+        QCOMPARE(treeShape(replay->currentRemoteState()), treeShape(remoteBefore));
+        QCOMPARE(treeShape(replay->currentLocalState()), treeShape(localBefore));
+
+        QStringList replayedItems;
+        connect(&replay->syncEngine(), &SyncEngine::itemCompleted, this, [&](const SyncFileItemPtr &item) {
+            replayedItems.append(itemKey(item->_instruction, Utility::enumToString(item->_direction)));
+        });
+        QVERIFY(replay->syncOnce());
+        QCOMPARE(replay->currentLocalState(), replay->currentRemoteState());
+
+        QStringList tracedItems;
+        for (const auto &v : trace->items) {
+            const auto item = v.toObject();
+            tracedItems.append(itemKey(item.value(QStringLiteral("instruction")).toInt(), item.value(QStringLiteral("direction")).toString()));
+        }
+        recordedItems.sort();
+        replayedItems.sort();
+        tracedItems.sort();
+        QCOMPARE(tracedItems, recordedItems);
+        QCOMPARE(replayedItems, recordedItems);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncRecorder)
+#include "testsyncrecorder.moc"
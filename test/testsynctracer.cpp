@@ -0,0 +1,144 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <synctracer.h>
+
+using namespace OCC;
+
+namespace {
+QString expectedHash(const QString &value)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(value.toUtf8(), QCryptographicHash::Sha1).toHex().left(16));
+}
+
+qint64 currentThread()
+{
+    return static_cast<qint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+}
+}
+
+class TestSyncTracer : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir;
+
+    // the trace is removed after reading, a second flush in the same millisecond would get the same name
+    QJsonObject flushAndRead()
+    {
+        if (!SyncTracer::instance()->flush()) {
+            return {};
+        }
+        const auto files = QDir(_dir.path()).entryInfoList(QDir::Files);
+        if (files.size() != 1) {
+            return {};
+        }
+        QFile file(files.first().absoluteFilePath());
+        if (!file.open(QIODevice::ReadOnly)) {
+            return {};
+        }
+        const auto trace = QJsonDocument::fromJson(file.readAll()).object();
+        file.remove();
+        return trace;
+    }
+
+private slots:
+    void init()
+    {
+        auto tracer = SyncTracer::instance();
+        tracer->setOutputDirectory(_dir.path());
+        tracer->setEnabled(true);
+    }
+
+    void cleanup()
+    {
+        auto tracer = SyncTracer::instance();
+        tracer->setEnabled(false);
+        tracer->setMaxSpans(1000000);
+    }
+
+    void testEvents()
+    {
+        auto tracer = SyncTracer::instance();
+        {
+            auto span = tracer->begin("propagation", QStringLiteral("PropagateDownloadFile"), QStringLiteral("/home/secret/folder"), QStringLiteral("A/private.txt"));
+            span.setBytes(42);
+        }
+        qint64 workerThread = 0;
+        std::unique_ptr<QThread> worker(QThread::create([&workerThread, tracer] {
+            workerThread = currentThread();
+            auto span = tracer->beginOnThread("checksum", QStringLiteral("ContentChecksum"), QStringLiteral("/home/secret/folder"), QStringLiteral("A/private.txt"));
+        }));
+        worker->start();
+        QVERIFY(worker->wait());
+
+        const auto trace = flushAndRead();
+        const auto events = trace.value(QStringLiteral("traceEvents")).toArray();
+        QCOMPARE(events.size(), 3);
+
+        // the job: an async begin and end pair
+        const auto begin = events.at(0).toObject();
+        const auto end = events.at(1).toObject();
+        QCOMPARE(begin.value(QStringLiteral("ph")).toString(), QStringLiteral("b"));
+        QCOMPARE(end.value(QStringLiteral("ph")).toString(), QStringLiteral("e"));
+        QCOMPARE(begin.value(QStringLiteral("name")).toString(), QStringLiteral("PropagateDownloadFile"));
+        QCOMPARE(begin.value(QStringLiteral("cat")).toString(), QStringLiteral("propagation"));
+        QCOMPARE(begin.value(QStringLiteral("id")), end.value(QStringLiteral("id")));
+        QVERIFY(end.value(QStringLiteral("ts")).toDouble() >= begin.value(QStringLiteral("ts")).toDouble());
+        QCOMPARE(begin.value(QStringLiteral("tid")).toVariant().toLongLong(), currentThread());
+        const auto args = begin.value(QStringLiteral("args")).toObject();
+        QCOMPARE(args.value(QStringLiteral("bytes")).toInt(), 42);
+
+        // folders and paths are hashed
+        QCOMPARE(args.value(QStringLiteral("folder")).toString(), expectedHash(QStringLiteral("/home/secret/folder")));
+        QCOMPARE(args.value(QStringLiteral("path")).toString(), expectedHash(QStringLiteral("A/private.txt")));
+        const auto json = QJsonDocument(trace).toJson();
+        QVERIFY(!json.contains("secret"));
+        QVERIFY(!json.contains("private"));
+
+        // the work on the worker thread: a complete event on its track
+        const auto onThread = events.at(2).toObject();
+        QCOMPARE(onThread.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+        QCOMPARE(onThread.value(QStringLiteral("name")).toString(), QStringLiteral("ContentChecksum"));
+        QVERIFY(onThread.contains(QStringLiteral("dur")));
+        QCOMPARE(onThread.value(QStringLiteral("tid")).toVariant().toLongLong(), workerThread);
+        QVERIFY(workerThread != currentThread());
+
+        QCOMPARE(trace.value(QStringLiteral("otherData")).toObject().value(QStringLiteral("droppedSpans")).toString(), QStringLiteral("0"));
+    }
+
+    void testDroppedSpans()
+    {
+        auto tracer = SyncTracer::instance();
+        tracer->setMaxSpans(3);
+        for (int i = 0; i < 5; ++i) {
+            tracer->begin("discovery", QStringLiteral("ProcessDirectoryJob")).end();
+        }
+        auto trace = flushAndRead();
+        QCOMPARE(trace.value(QStringLiteral("traceEvents")).toArray().size(), 6);
+        QCOMPARE(trace.value(QStringLiteral("otherData")).toObject().value(QStringLiteral("droppedSpans")).toString(), QStringLiteral("2"));
+
+        // the limit applies per flush
+        tracer->begin("discovery", QStringLiteral("ProcessDirectoryJob")).end();
+        trace = flushAndRead();
+        QCOMPARE(trace.value(QStringLiteral("traceEvents")).toArray().size(), 2);
+        QCOMPARE(trace.value(QStringLiteral("otherData")).toObject().value(QStringLiteral("droppedSpans")).toString(), QStringLiteral("0"));
+    }
+
+    void testDisabled()
+    {
+        auto tracer = SyncTracer::instance();
+        tracer->setEnabled(false);
+        auto span = tracer->begin("discovery", QStringLiteral("ProcessDirectoryJob"));
+        QVERIFY(!span.isActive());
+        QVERIFY(!tracer->beginOnThread("discovery", QStringLiteral("LocalDirectoryListing")).isActive());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncTracer)
+#include "testsynctracer.moc"
@@ -9,6 +9,7 @@
 #include "testutils/syncenginetestutils.h"
 #include "common/vfs.h"
 #include "config.h"
+#include <propagatedownload.h>
 #include <syncengine.h>
 
 using namespace OCC;
@@ -977,6 +978,37 @@ private slots:
         QVERIFY(fakeFolder.currentLocalState().find("unspec/file1" DVSUFFIX));
     }
 
+    // The placeholders of many new files are created in batches
+    void testBulkPlaceholders()
+    {
+        FakeFolder fakeFolder{ FileInfo() };
+        setupVfs(fakeFolder);
+        ItemCompletedSpy completeSpy(fakeFolder);
+
+        const int count = PropagateVirtualFiles::MaxBatchSize + 10;
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < count; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/f%1").arg(i), 64);
+        }
+        fakeFolder.remoteModifier().insert("A/zz", 64);
+        fakeFolder.remoteModifier().mkdir("B");
+        fakeFolder.remoteModifier().insert("B/b1", 64);
+        QVERIFY(fakeFolder.syncOnce());
+
+        for (const auto &path : { QStringLiteral("A/f0"), QStringLiteral("A/f%1").arg(count - 1), QStringLiteral("A/zz"), QStringLiteral("B/b1") }) {
+            QVERIFY(!fakeFolder.currentLocalState().find(path));
+            QVERIFY(fakeFolder.currentLocalState().find(path + QStringLiteral(DVSUFFIX)));
+            QCOMPARE(itemInstruction(completeSpy, path + QStringLiteral(DVSUFFIX)), CSYNC_INSTRUCTION_NEW);
+            QCOMPARE(dbRecord(fakeFolder, path + QStringLiteral(DVSUFFIX))._type, ItemTypeVirtualFile);
+        }
+        QCOMPARE(completeSpy.count(), count + 4);
+
+        // nothing is left to do
+        completeSpy.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(completeSpy.isEmpty());
+    }
+
     // Check what happens if vfs-suffixed files exist on the server or in the db
     void testExtraFilesLocalDehydrated()
     {
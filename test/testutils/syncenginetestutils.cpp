@@ -214,6 +214,7 @@ void FileInfo::setModTime(const QString &relativePath, const QDateTime &modTime)
 
 FileInfo *FileInfo::find(PathComponents pathComponents, const bool invalidateEtags)
 {
+    materialize();
     if (pathComponents.isEmpty()) {
         if (invalidateEtags) {
             etag = generateEtag();
@@ -233,6 +234,26 @@ FileInfo *FileInfo::find(PathComponents pathComponents, const bool invalidateEta
     return nullptr;
 }
 
+std::optional<FileInfo> FileInfo::lookup(PathComponents pathComponents) const
+{
+    if (pathComponents.isEmpty()) {
+        return *this;
+    }
+    const QString childName = pathComponents.pathRoot();
+    if (_generator) {
+        const int index = generatedChildIndex(childName);
+        if (index < 0) {
+            return {};
+        }
+        return generatedChild(index).lookup(std::move(pathComponents).subComponents());
+    }
+    auto it = children.constFind(childName);
+    if (it == children.cend()) {
+        return {};
+    }
+    return it->lookup(std::move(pathComponents).subComponents());
+}
+
 FileInfo *FileInfo::createDir(const QString &relativePath)
 {
     const PathComponents pathComponents { relativePath };
@@ -258,6 +279,14 @@ FileInfo *FileInfo::create(const QString &relativePath, qint64 size, char conten
 
 bool FileInfo::equals(const FileInfo &other, CompareWhat compareWhat) const
 {
+    if (_generator || other._generator) {
+        auto a = *this;
+        auto b = other;
+        a.materialize();
+        b.materialize();
+        return a.equals(b, compareWhat);
+    }
+
     // Only check the content and contentSize if both files are hydrated:
     if (!isDehydratedPlaceholder && !other.isDehydratedPlaceholder) {
         if (contentSize != other.contentSize || contentChar != other.contentChar) {
@@ -297,6 +326,103 @@ bool FileInfo::equals(const FileInfo &other, CompareWhat compareWhat) const
     return true;
 }
 
+qint64 FileInfoGenerator::fileCount() const
+{
+    qint64 dirs = 0;
+    qint64 dirsOnLevel = 1;
+    for (int level = 0; level <= depth; ++level) {
+        dirs += dirsOnLevel;
+        dirsOnLevel *= dirsPerDir;
+    }
+    return dirs * filesPerDir;
+}
+
+FileInfo FileInfo::fromGenerator(const QString &name, const FileInfoGenerator &generator)
+{
+    FileInfo fi { name };
+    fi._generator = std::make_shared<const FileInfoGenerator>(generator);
+    fi._generatorKey = generator.seed;
+    fi.setLastModifiedFromSecondsUTC(generator.lastModified);
+    return fi;
+}
+
+void FileInfo::materialize()
+{
+    if (!_generator) {
+        return;
+    }
+    const int count = generatedChildCount();
+    for (int i = 0; i < count; ++i) {
+        auto child = generatedChild(i);
+        children.insert(child.name, std::move(child));
+    }
+    _generator.reset();
+}
+
+void FileInfo::forEachChild(const std::function<void(const FileInfo &)> &f) const
+{
+    if (_generator) {
+        const int count = generatedChildCount();
+        for (int i = 0; i < count; ++i) {
+            f(generatedChild(i));
+        }
+    } else {
+        for (const auto &child : children) {
+            f(child);
+        }
+    }
+}
+
+int FileInfo::generatedChildCount() const
+{
+    return _generator->filesPerDir + (_generatorLevel < _generator->depth ? _generator->dirsPerDir : 0);
+}
+
+int FileInfo::generatedChildIndex(const QString &childName) const
+{
+    // the inverse of the names used in generatedChild()
+    const auto parse = [&childName](QLatin1String prefix, int max) {
+        if (!childName.startsWith(prefix)) {
+            return -1;
+        }
+        bool ok;
+        const int n = childName.midRef(prefix.size()).toInt(&ok);
+        if (!ok || n < 1 || n > max || childName != prefix + QString::number(n)) {
+            return -1;
+        }
+        return n - 1;
+    };
+    const int file = parse(QLatin1String("file"), _generator->filesPerDir);
+    if (file >= 0) {
+        return file;
+    }
+    const int dir = parse(QLatin1String("dir"), generatedChildCount() - _generator->filesPerDir);
+    return dir >= 0 ? _generator->filesPerDir + dir : -1;
+}
+
+FileInfo FileInfo::generatedChild(int index) const
+{
+    Q_ASSERT(_generator && index < generatedChildCount());
+    const bool isChildDir = index >= _generator->filesPerDir;
+    FileInfo child { isChildDir ? QStringLiteral("dir%1").arg(index - _generator->filesPerDir + 1) : QStringLiteral("file%1").arg(index + 1) };
+    child.parentPath = path();
+    // derived from the position in the generated tree rather than the path, so renames keep the ids
+    child._generatorKey = qHash(qMakePair(_generatorKey, index), _generator->seed);
+    child.etag = QByteArray::number(child._generatorKey, 16);
+    child.fileId = QByteArray::number(qHash(child._generatorKey, ~_generator->seed), 16);
+    child.setLastModifiedFromSecondsUTC(_generator->lastModified);
+    if (isChildDir) {
+        child._generator = _generator;
+        child._generatorLevel = _generatorLevel + 1;
+    } else {
+        child.isDir = false;
+        child.fileSize = _generator->fileSize;
+        child.contentSize = _generator->fileSize;
+        child.contentChar = static_cast<char>('a' + child._generatorKey % 26);
+    }
+    return child;
+}
+
 QString FileInfo::path() const
 {
     return (parentPath.isEmpty() ? QString() : (parentPath + QLatin1Char('/'))) + name;
@@ -336,7 +462,7 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
 
     QString fileName = getFilePathFromUrl(request.url());
     Q_ASSERT(!fileName.isNull()); // for root, it should be empty
-    const FileInfo *fileInfo = remoteRootFileInfo.find(fileName);
+    const auto fileInfo = remoteRootFileInfo.lookup(fileName);
     if (!fileInfo) {
         QMetaObject::invokeMethod(this, "respond404", Qt::QueuedConnection);
         return;
@@ -387,9 +513,7 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
 
     const int depth = request.rawHeader(QByteArrayLiteral("Depth")).toInt();
     if (depth > 0) {
-        for (const FileInfo &childFileInfo : fileInfo->children) {
-            writeFileResponse(childFileInfo);
-        }
+        fileInfo->forEachChild(writeFileResponse);
     }
     xml.writeEndElement(); // multistatus
     xml.writeEndDocument();
@@ -550,19 +674,15 @@ void FakeMoveReply::respond()
 
 FakeGetReply::FakeGetReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
     : FakeReply { parent }
+    , remoteRootFileInfo(remoteRootFileInfo)
+    , fileName(getFilePathFromUrl(request.url()))
 {
     setRequest(request);
     setUrl(request.url());
     setOperation(op);
     open(QIODevice::ReadOnly);
 
-    QString fileName = getFilePathFromUrl(request.url());
     Q_ASSERT(!fileName.isEmpty());
-    fileInfo = remoteRootFileInfo.find(fileName);
-    if (!fileInfo) {
-        qDebug() << "meh;";
-    }
-    Q_ASSERT_X(fileInfo, Q_FUNC_INFO, "Could not find file on the remote");
     QMetaObject::invokeMethod(this, &FakeGetReply::respond, Qt::QueuedConnection);
 }
 
@@ -574,6 +694,11 @@ void FakeGetReply::respond()
         emit finished();
         return;
     }
+    const auto fileInfo = remoteRootFileInfo.lookup(fileName);
+    if (!fileInfo) {
+        qDebug() << "meh;";
+    }
+    Q_ASSERT_X(fileInfo, Q_FUNC_INFO, "Could not find file on the remote");
     payload = fileInfo->contentChar;
     size = fileInfo->contentSize;
     setHeader(QNetworkRequest::ContentLengthHeader, size);
@@ -812,6 +937,86 @@ qint64 FakePayloadReply::bytesAvailable() const
     return _body.size();
 }
 
+namespace {
+void appendTarHeader(QByteArray &archive, const QByteArray &name, char type, qint64 size, qint64 mtime)
+{
+    QByteArray header(512, '\0');
+    Q_ASSERT(name.size() < 100);
+    header.replace(0, name.size(), name);
+    const auto writeOctal = [&header](int offset, int length, qint64 value) {
+        const QByteArray number = QByteArray::number(value, 8).rightJustified(length - 1, '0');
+        header.replace(offset, number.size(), number);
+    };
+    writeOctal(100, 8, 0644);
+    writeOctal(108, 8, 0);
+    writeOctal(116, 8, 0);
+    writeOctal(124, 12, size);
+    writeOctal(136, 12, mtime);
+    header[156] = type;
+    header.replace(257, 8, QByteArray("ustar\0" "00", 8));
+
+    // the checksum is computed with its own field taken as spaces
+    header.replace(148, 8, QByteArray(8, ' '));
+    int sum = 0;
+    for (const char c : qAsConst(header)) {
+        sum += static_cast<unsigned char>(c);
+    }
+    header.replace(148, 8, QByteArray::number(sum, 8).rightJustified(6, '0') + QByteArray("\0 ", 2));
+    archive += header;
+}
+
+void appendTarData(QByteArray &archive, const QByteArray &data)
+{
+    archive += data;
+    archive += QByteArray((512 - data.size() % 512) % 512, '\0');
+}
+}
+
+FakeArchiveReply::FakeArchiveReply(const FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+    : FakePayloadReply(op, request, makeArchive(remoteRootFileInfo, QUrlQuery(request.url()).allQueryItemValues(QStringLiteral("id"), QUrl::FullyDecoded)), parent)
+{
+}
+
+QByteArray FakeArchiveReply::makeArchive(const FileInfo &remoteRootFileInfo, const QStringList &fileIds)
+{
+    QHash<QByteArray, FileInfo> files;
+    std::function<void(const FileInfo &)> collect = [&](const FileInfo &dir) {
+        dir.forEachChild([&](const FileInfo &child) {
+            if (child.isDir) {
+                collect(child);
+            } else if (fileIds.contains(QString::fromUtf8(child.fileId))) {
+                files.insert(child.fileId, child);
+            }
+        });
+    };
+    collect(remoteRootFileInfo);
+
+    QByteArray archive;
+    for (const auto &id : fileIds) {
+        const auto it = files.constFind(id.toUtf8());
+        if (it == files.cend()) {
+            continue;
+        }
+        const QByteArray name = it->name.toUtf8();
+        if (name.size() >= 100) {
+            // pax header with the long name, "<length> path=<name>\n" where the length includes itself
+            const QByteArray record = " path=" + name + '\n';
+            int length = record.size();
+            while (QByteArray::number(length).size() + record.size() != length) {
+                length = QByteArray::number(length).size() + record.size();
+            }
+            const QByteArray pax = QByteArray::number(length) + record;
+            appendTarHeader(archive, QByteArrayLiteral("PaxHeader"), 'x', pax.size(), it->lastModifiedInSecondsUTC());
+            appendTarData(archive, pax);
+        }
+        appendTarHeader(archive, name.left(99), '0', it->contentSize, it->lastModifiedInSecondsUTC());
+        appendTarData(archive, QByteArray(it->contentSize, it->contentChar));
+    }
+    // the end of the archive
+    archive += QByteArray(1024, '\0');
+    return archive;
+}
+
 FakeErrorReply::FakeErrorReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent, int httpErrorCode, const QByteArray &body)
     : FakeReply { parent }
     , _body(body)
@@ -887,6 +1092,9 @@ QNetworkReply *FakeQNAM::createRequest(QNetworkAccessManager::Operation op, cons
             reply = _reply;
         }
     }
+    if (!reply && newRequest.url().path() == sArchiverPath) {
+        reply = new FakeArchiveReply { _remoteRootFileInfo, op, newRequest, this };
+    }
     if (!reply) {
         const QString fileName = getFilePathFromUrl(newRequest.url());
         Q_ASSERT(!fileName.isNull());
@@ -1058,7 +1266,7 @@ bool FakeFolder::isDehydratedPlaceholder(const QString &filePath)
 
 void FakeFolder::toDisk(QDir &dir, const FileInfo &templateFi)
 {
-    for (const auto &child : templateFi.children) {
+    templateFi.forEachChild([&dir](const FileInfo &child) {
         if (child.isDir) {
             QDir subDir(dir);
             dir.mkdir(child.name);
@@ -1071,7 +1279,7 @@ void FakeFolder::toDisk(QDir &dir, const FileInfo &templateFi)
             file.close();
             OCC::FileSystem::setModTime(file.fileName(), child.lastModifiedInSecondsUTC());
         }
-    }
+    });
 }
 
 void FakeFolder::fromDisk(QDir &dir, FileInfo &templateFi)
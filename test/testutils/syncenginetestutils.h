@@ -26,6 +26,9 @@
 #include <QTimer>
 
 #include <chrono>
+#include <memory>
+#include <optional>
+
 /*
  * TODO: In theory we should use QVERIFY instead of Q_ASSERT for testing, but this
  * only works when directly called from a QTest :-(
@@ -35,6 +38,8 @@
 static const QUrl sRootUrl = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/webdav/");
 static const QUrl sRootUrl2 = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/dav/files/admin/");
 static const QUrl sUploadUrl = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/dav/uploads/admin/");
+// the path of the archiver announced by archiverCapabilities()
+static const QString sArchiverPath = QStringLiteral("/archiver");
 
 inline QString getFilePathFromUrl(const QUrl &url)
 {
@@ -117,12 +122,50 @@ static inline qint64 defaultLastModified()
     return timeInSeconds;
 }
 
+/**
+ * Parameters of a generated directory tree, see FileInfo::fromGenerator()
+ *
+ * Level 0 is the generated directory itself, directories down to level depth
+ * get dirsPerDir sub directories. Every directory contains filesPerDir files.
+ */
+struct FileInfoGenerator
+{
+    int filesPerDir = 10;
+    int dirsPerDir = 8;
+    int depth = 4;
+    qint64 fileSize = 64;
+    uint seed = 0;
+    qint64 lastModified = defaultLastModified();
+
+    /// The number of files in the whole tree
+    qint64 fileCount() const;
+};
+
 /// FIXME: we should make it explicit in the construtor if we're talking about a hydrated or a dehydrated file!
 class FileInfo : public FileModifier
 {
 public:
     static FileInfo A12_B12_C12_S12();
 
+    /**
+     * A directory whose content is generated on demand
+     *
+     * Listings and lookups create the entries on the fly, only directories that
+     * get modified store their children. Etags, file ids and the content are
+     * derived from the seed so they stay stable between requests. This keeps
+     * trees with millions of files cheap as long as they are mostly read.
+     */
+    static FileInfo fromGenerator(const QString &name, const FileInfoGenerator &generator);
+
+    /// Whether the children of this directory are generated on demand
+    bool isGenerated() const { return _generator != nullptr; }
+
+    /// Store the generated children, their own children stay generated
+    void materialize();
+
+    /// Calls @a f for all children, generated children are not stored
+    void forEachChild(const std::function<void(const FileInfo &)> &f) const;
+
     FileInfo() = default;
     FileInfo(const QString &name)
         : name { name }
@@ -163,9 +206,12 @@ public:
 
     void setModTime(const QString &relativePath, const QDateTime &modTime) override;
 
-    /// Return a pointer to the FileInfo, or a nullptr if it doesn't exist
+    /// Return a pointer to the FileInfo, or a nullptr if it doesn't exist. Materializes generated directories on the path.
     FileInfo *find(PathComponents pathComponents, const bool invalidateEtags = false);
 
+    /// Like find() but returns a copy and leaves generated directories untouched
+    std::optional<FileInfo> lookup(PathComponents pathComponents) const;
+
     FileInfo *createDir(const QString &relativePath);
 
     FileInfo *create(const QString &relativePath, qint64 size, char contentChar);
@@ -239,6 +285,14 @@ public:
 
     FileInfo *findInvalidatingEtags(PathComponents pathComponents);
 
+    int generatedChildCount() const;
+    int generatedChildIndex(const QString &childName) const;
+    FileInfo generatedChild(int index) const;
+
+    std::shared_ptr<const FileInfoGenerator> _generator;
+    int _generatorLevel = 0;
+    uint _generatorKey = 0;
+
     friend inline QDebug operator<<(QDebug dbg, const FileInfo &fi)
     {
         return dbg.nospace().noquote()
@@ -273,7 +327,7 @@ public:
 
     FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
 
-    Q_INVOKABLE void respond();
+    Q_INVOKABLE virtual void respond();
 
     Q_INVOKABLE void respond404();
 
@@ -341,7 +395,9 @@ class FakeGetReply : public FakeReply
 {
     Q_OBJECT
 public:
-    const FileInfo *fileInfo;
+    // looked up when the reply responds, so changes to the remote made in the meantime are served
+    FileInfo &remoteRootFileInfo;
+    QString fileName;
     char payload;
     int size;
     bool aborted = false;
@@ -411,6 +467,16 @@ public:
     QByteArray _body;
 };
 
+/// Answers like the archiver with a tar archive of the files with the requested ids, ids that are not found are left out
+class FakeArchiveReply : public FakePayloadReply
+{
+    Q_OBJECT
+public:
+    FakeArchiveReply(const FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
+
+    static QByteArray makeArchive(const FileInfo &remoteRootFileInfo, const QStringList &fileIds);
+};
+
 
 class FakeErrorReply : public FakeReply
 {
@@ -0,0 +1,228 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+#include "syncreplay.h"
+
+#include <QFile>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+using namespace OCC;
+
+namespace {
+
+FileInfo &dirAt(FileInfo &root, const QString &path)
+{
+    FileInfo *dir = &root;
+    if (path.isEmpty()) {
+        return *dir;
+    }
+    for (const auto &name : path.split(QLatin1Char('/'))) {
+        auto &child = dir->children[name];
+        child.name = name;
+        child.isDir = true;
+        dir = &child;
+    }
+    return *dir;
+}
+
+FileInfo &setEntry(FileInfo &dir, const QString &name, bool isDir, qint64 size, qint64 modtime)
+{
+    auto &fi = dir.children[name];
+    fi.name = name;
+    fi.isDir = isDir;
+    if (!isDir) {
+        fi.children.clear();
+        fi.fileSize = size;
+        fi.contentSize = size;
+    }
+    fi.setLastModifiedFromSecondsUTC(modtime);
+    return fi;
+}
+
+// sort by depth so that the parents are created before their children
+QVector<QJsonObject> sortedByDepth(const QJsonArray &array)
+{
+    QVector<QJsonObject> out;
+    out.reserve(array.size());
+    for (const auto &v : array) {
+        out.append(v.toObject());
+    }
+    std::stable_sort(out.begin(), out.end(), [](const QJsonObject &a, const QJsonObject &b) {
+        const auto pathA = a.value(QStringLiteral("path")).toString();
+        const auto pathB = b.value(QStringLiteral("path")).toString();
+        return (pathA.isEmpty() ? 0 : pathA.count(QLatin1Char('/')) + 1) < (pathB.isEmpty() ? 0 : pathB.count(QLatin1Char('/')) + 1);
+    });
+    return out;
+}
+
+FileInfo journalTree(const QJsonArray &journal)
+{
+    FileInfo root;
+    for (const auto &rec : sortedByDepth(journal)) {
+        const auto path = rec.value(QStringLiteral("path")).toString();
+        const auto type = static_cast<ItemType>(rec.value(QStringLiteral("type")).toInt());
+        if (type != ItemTypeFile && type != ItemTypeDirectory) {
+            continue;
+        }
+        const PathComponents components(path);
+        auto &fi = setEntry(dirAt(root, components.parentDirComponents().join(QLatin1Char('/'))), components.fileName(),
+            type == ItemTypeDirectory, rec.value(QStringLiteral("size")).toVariant().toLongLong(),
+            rec.value(QStringLiteral("modtime")).toVariant().toLongLong());
+        fi.etag = rec.value(QStringLiteral("etag")).toString().toUtf8();
+        fi.fileId = rec.value(QStringLiteral("fileId")).toString().toUtf8();
+    }
+    root.fixupParentPathRecursively();
+    return root;
+}
+
+/// Replace the content of every listed directory in @a tree with the listing
+void applyListings(FileInfo &tree, const QJsonArray &listings, bool remote)
+{
+    for (const auto &listing : sortedByDepth(listings)) {
+        if (remote && listing.value(QStringLiteral("httpCode")).toInt() != 207) {
+            continue;
+        }
+        auto &dir = dirAt(tree, listing.value(QStringLiteral("path")).toString());
+        QSet<QString> seen;
+        for (const auto &v : listing.value(QStringLiteral("entries")).toArray()) {
+            const auto entry = v.toObject();
+            const auto name = entry.value(QStringLiteral("name")).toString();
+            bool isDir;
+            if (remote) {
+                isDir = entry.value(QStringLiteral("isDirectory")).toBool();
+            } else {
+                const auto type = static_cast<ItemType>(entry.value(QStringLiteral("type")).toInt());
+                if (type != ItemTypeFile && type != ItemTypeDirectory) {
+                    continue;
+                }
+                isDir = type == ItemTypeDirectory;
+            }
+            auto &fi = setEntry(dir, name, isDir, entry.value(QStringLiteral("size")).toVariant().toLongLong(),
+                entry.value(QStringLiteral("modtime")).toVariant().toLongLong());
+            if (remote) {
+                fi.etag = entry.value(QStringLiteral("etag")).toString().toUtf8();
+                fi.fileId = entry.value(QStringLiteral("fileId")).toString().toUtf8();
+                fi.permissions = RemotePermissions::fromDbValue(entry.value(QStringLiteral("remotePerm")).toString().toUtf8());
+            }
+            seen.insert(name);
+        }
+        for (auto it = dir.children.begin(); it != dir.children.end();) {
+            if (!seen.contains(it.key())) {
+                it = dir.children.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    tree.fixupParentPathRecursively();
+}
+
+/// Modify the files on disk to match @a target, unchanged files are kept to preserve their inode
+void applyToDisk(FileModifier &modifier, const FileInfo &current, const FileInfo &target, const QString &path)
+{
+    const auto childPath = [&path](const QString &name) { return path.isEmpty() ? name : path + QLatin1Char('/') + name; };
+    for (const auto &cur : current.children) {
+        const auto it = target.children.constFind(cur.name);
+        if (it == target.children.cend() || it->isDir != cur.isDir) {
+            modifier.remove(childPath(cur.name));
+        }
+    }
+    for (const auto &t : target.children) {
+        const auto it = current.children.constFind(t.name);
+        const bool exists = it != current.children.cend() && it->isDir == t.isDir;
+        if (t.isDir) {
+            if (!exists) {
+                modifier.mkdir(childPath(t.name));
+            }
+            applyToDisk(modifier, exists ? *it : FileInfo {}, t, childPath(t.name));
+            continue;
+        }
+        if (exists && it->contentSize != t.contentSize) {
+            modifier.remove(childPath(t.name));
+        }
+        if (!exists || it->contentSize != t.contentSize) {
+            modifier.insert(childPath(t.name), t.contentSize);
+        }
+        if (!exists || it->contentSize != t.contentSize || it->lastModifiedInSecondsUTC() != t.lastModifiedInSecondsUTC()) {
+            modifier.setModTime(childPath(t.name), t.lastModifiedInUtc());
+        }
+    }
+}
+}
+
+
+std::optional<SyncTrace> SyncTrace::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << path << file.errorString();
+        return {};
+    }
+    SyncTrace trace;
+    while (!file.atEnd()) {
+        const auto line = file.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        const auto doc = QJsonDocument::fromJson(line);
+        if (!doc.isObject()) {
+            qWarning() << "Invalid line in" << path << line;
+            return {};
+        }
+        auto record = doc.object();
+        const auto kind = record.take(QStringLiteral("kind")).toString();
+        if (kind == QLatin1String("journal")) {
+            trace.journal.append(record);
+        } else if (kind == QLatin1String("remoteListing")) {
+            trace.remoteListings.append(record);
+        } else if (kind == QLatin1String("localListing")) {
+            trace.localListings.append(record);
+        } else if (kind == QLatin1String("item")) {
+            trace.items.append(record);
+        } else if (kind == QLatin1String("phase")) {
+            trace.phases.insert(record.value(QStringLiteral("name")).toString(), record.value(QStringLiteral("durationMs")));
+        }
+    }
+    return trace;
+}
+
+std::unique_ptr<FakeFolder> createReplayFolder(const SyncTrace &trace)
+{
+    const auto base = journalTree(trace.journal);
+    auto fakeFolder = std::make_unique<FakeFolder>(base);
+
+    auto localTarget = base;
+    applyListings(localTarget, trace.localListings, false);
+    applyToDisk(fakeFolder->localModifier(), fakeFolder->currentLocalState(), localTarget, QString());
+
+    auto remoteTarget = base;
+    applyListings(remoteTarget, trace.remoteListings, true);
+    fakeFolder->remoteModifier() = remoteTarget;
+
+    QHash<QString, QPair<std::chrono::milliseconds, int>> propfinds;
+    for (const auto &v : trace.remoteListings) {
+        const auto listing = v.toObject();
+        propfinds.insert(listing.value(QStringLiteral("path")).toString(),
+            { std::chrono::milliseconds(listing.value(QStringLiteral("durationMs")).toVariant().toLongLong()), listing.value(QStringLiteral("httpCode")).toInt() });
+    }
+    auto *folder = fakeFolder.get();
+    fakeFolder->setServerOverride([folder, propfinds](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+        if (request.attribute(QNetworkRequest::CustomVerbAttribute) != QLatin1String("PROPFIND")) {
+            return nullptr;
+        }
+        const auto it = propfinds.constFind(getFilePathFromUrl(request.url()));
+        if (it == propfinds.cend()) {
+            return nullptr;
+        }
+        if (it->second != 207) {
+            return new FakeErrorReply(op, request, &folder->syncEngine(), it->second);
+        }
+        return new DelayedReply<FakePropfindReply>(it->first, folder->remoteModifier(), op, request, &folder->syncEngine());
+    });
+    return fakeFolder;
+}
@@ -0,0 +1,41 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+#pragma once
+
+#include "syncenginetestutils.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include <memory>
+#include <optional>
+
+/**
+ * A trace written by OCC::SyncRecorder (OWNCLOUD_SYNC_RECORDER_DIR)
+ *
+ * The json lines of the trace are grouped by their kind.
+ */
+struct SyncTrace
+{
+    QJsonArray journal;
+    QJsonArray remoteListings;
+    QJsonArray localListings;
+    QJsonArray items;
+    QJsonObject phases;
+
+    /// Returns std::nullopt if the file can't be read or a line is not a json object
+    static std::optional<SyncTrace> load(const QString &path);
+};
+
+/**
+ * Creates a FakeFolder whose next sync replays @a trace
+ *
+ * The journal of the trace is turned into the initial state of the folder,
+ * afterwards the recorded local and remote listings are applied. PROPFIND
+ * replies are delayed by the time the listing took in the recorded sync.
+ */
+std::unique_ptr<FakeFolder> createReplayFolder(const SyncTrace &trace);
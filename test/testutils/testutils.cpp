@@ -1,4 +1,5 @@
 #include "testutils.h"
+#include "syncenginetestutils.h"
 
 #include "creds/httpcredentials.h"
 #include "gui/accountmanager.h"
@@ -92,5 +93,21 @@ namespace TestUtils {
             { "checksums", QVariantMap { { "preferredUploadType", "SHA1" }, { "supportedTypes", QVariantList { "SHA1", "MD5" } } } }
         };
     }
+
+    const QVariantMap archiverCapabilities()
+    {
+        auto cap = testCapabilities();
+        cap.insert(QStringLiteral("files"),
+            QVariantMap { { QStringLiteral("archivers"),
+                QVariantList { QVariantMap {
+                    { QStringLiteral("enabled"), true },
+                    { QStringLiteral("version"), QStringLiteral("2.0.0") },
+                    { QStringLiteral("formats"), QStringList { QStringLiteral("tar"), QStringLiteral("zip") } },
+                    { QStringLiteral("archiver_url"), sArchiverPath },
+                    { QStringLiteral("max_num_files"), QStringLiteral("10000") },
+                    { QStringLiteral("max_size"), QStringLiteral("1073741824") },
+                } } } });
+        return cap;
+    }
 }
 }
@@ -17,5 +17,7 @@ namespace TestUtils {
 
 
     const QVariantMap testCapabilities();
+    /// testCapabilities() with the archiver the bulk download uses
+    const QVariantMap archiverCapabilities();
 }
 }
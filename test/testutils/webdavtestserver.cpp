@@ -0,0 +1,253 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "webdavtestserver.h"
+
+#include "accessmanager.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+using namespace std::chrono_literals;
+
+namespace {
+// the bandwidth limit is applied in slices of this length
+constexpr auto BandwidthTick = 100ms;
+
+class LoopbackAccessManager : public OCC::AccessManager
+{
+public:
+    LoopbackAccessManager(quint16 port)
+        : _port(port)
+    {
+    }
+
+protected:
+    QNetworkReply *createRequest(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) override
+    {
+        auto url = request.url();
+        url.setScheme(QStringLiteral("http"));
+        url.setHost(QStringLiteral("127.0.0.1"));
+        url.setPort(_port);
+        auto newRequest = request;
+        newRequest.setUrl(url);
+        return OCC::AccessManager::createRequest(op, newRequest, outgoingData);
+    }
+
+private:
+    quint16 _port;
+};
+}
+
+/// One client connection, requests are answered in order (HTTP/1.1 without pipelining)
+class WebDavTestConnection : public QObject
+{
+public:
+    WebDavTestConnection(WebDavTestServer *server, QTcpSocket *socket)
+        : QObject(server)
+        , _server(server)
+        , _socket(socket)
+        , _bandwidthLimit(server->bandwidthLimit())
+    {
+        _socket->setParent(this);
+        connect(_socket, &QTcpSocket::readyRead, this, [this] {
+            if (_bandwidthLimit <= 0) {
+                receive(_socket->bytesAvailable());
+            }
+        });
+        connect(_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+
+        _tick.setInterval(BandwidthTick);
+        connect(&_tick, &QTimer::timeout, this, [this] {
+            const qint64 budget = _bandwidthLimit * BandwidthTick.count() / 1000;
+            receive(std::min(budget, _socket->bytesAvailable()));
+            send(budget);
+        });
+        if (_bandwidthLimit > 0) {
+            // let tcp flow control slow down the client
+            _socket->setReadBufferSize(std::max<qint64>(_bandwidthLimit * BandwidthTick.count() / 1000, 4096));
+            _tick.start();
+        }
+    }
+
+private:
+    void receive(qint64 size)
+    {
+        if (size <= 0) {
+            return;
+        }
+        const auto data = _socket->read(size);
+        _server->_bytesReceived += data.size();
+        _in.append(data);
+        parse();
+    }
+
+    void send(qint64 budget)
+    {
+        if (_out.isEmpty()) {
+            return;
+        }
+        const qint64 size = budget > 0 ? std::min<qint64>(budget, _out.size()) : _out.size();
+        _socket->write(_out.constData(), size);
+        _server->_bytesSent += size;
+        _out.remove(0, size);
+        if (_out.isEmpty() && _closeAfterResponse) {
+            _socket->disconnectFromHost();
+        }
+    }
+
+    void parse()
+    {
+        if (_state == ReadingHeader) {
+            const int end = _in.indexOf("\r\n\r\n");
+            if (end < 0) {
+                return;
+            }
+            const auto lines = _in.left(end).split('\n');
+            _in.remove(0, end + 4);
+
+            const auto requestLine = lines.first().trimmed().split(' ');
+            _request = QNetworkRequest();
+            _verb = requestLine.value(0);
+            // the target is an absolute path, use the host the client used so the fake replies see the same urls
+            _request.setUrl(QUrl::fromEncoded("http://localhost" + requestLine.value(1)));
+            _contentLength = 0;
+            _closeAfterResponse = requestLine.value(2) == "HTTP/1.0";
+            for (int i = 1; i < lines.size(); ++i) {
+                const auto line = lines.at(i).trimmed();
+                const int colon = line.indexOf(':');
+                if (colon <= 0) {
+                    continue;
+                }
+                const auto name = line.left(colon).trimmed();
+                const auto value = line.mid(colon + 1).trimmed();
+                if (qstricmp(name.constData(), "Content-Length") == 0) {
+                    _contentLength = value.toLongLong();
+                } else if (qstricmp(name.constData(), "Connection") == 0 && value.toLower() == "close") {
+                    _closeAfterResponse = true;
+                }
+                _request.setRawHeader(name, value);
+            }
+            _state = ReadingBody;
+        }
+        if (_state == ReadingBody) {
+            if (_in.size() < _contentLength) {
+                return;
+            }
+            const auto body = _in.left(_contentLength);
+            _in.remove(0, _contentLength);
+            _state = Processing;
+            QTimer::singleShot(_server->latency(), this, [this, body] { dispatch(body); });
+        }
+    }
+
+    void dispatch(const QByteArray &body)
+    {
+        ++_server->_requestCount;
+        auto *backend = _server->_backend.get();
+        QNetworkReply *reply = nullptr;
+        if (_verb == "GET") {
+            reply = backend->get(_request);
+        } else if (_verb == "PUT") {
+            reply = backend->put(_request, body);
+        } else if (_verb == "DELETE") {
+            reply = backend->deleteResource(_request);
+        } else if (_verb == "PROPFIND" || _verb == "MKCOL" || _verb == "MOVE") {
+            reply = backend->sendCustomRequest(_request, _verb, body);
+        } else {
+            respond(405, "Method Not Allowed", {}, QByteArray());
+            return;
+        }
+        connect(reply, &QNetworkReply::finished, this, [this, reply] {
+            int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (code == 0) {
+                code = reply->error() == QNetworkReply::NoError ? 200 : 500;
+            }
+            const auto reason = reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray();
+            respond(code, reason.isEmpty() ? QByteArrayLiteral("OK") : reason, reply->rawHeaderPairs(), reply->readAll());
+            reply->deleteLater();
+        });
+    }
+
+    void respond(int code, const QByteArray &reason, const QList<QNetworkReply::RawHeaderPair> &headers, const QByteArray &body)
+    {
+        QByteArray response = "HTTP/1.1 " + QByteArray::number(code) + ' ' + reason + "\r\n";
+        for (const auto &header : headers) {
+            if (qstricmp(header.first.constData(), "Content-Length") == 0 || qstricmp(header.first.constData(), "Transfer-Encoding") == 0) {
+                continue;
+            }
+            response += header.first + ": " + header.second + "\r\n";
+        }
+        response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+        if (_closeAfterResponse) {
+            response += "Connection: close\r\n";
+        }
+        response += "\r\n";
+        _out += response + body;
+        if (_bandwidthLimit <= 0) {
+            send(0);
+        }
+
+        _state = ReadingHeader;
+        if (!_closeAfterResponse) {
+            // handle requests that arrived while we were busy
+            if (_bandwidthLimit <= 0) {
+                const auto data = _socket->readAll();
+                _server->_bytesReceived += data.size();
+                _in += data;
+            }
+            parse();
+        }
+    }
+
+    enum State {
+        ReadingHeader,
+        ReadingBody,
+        Processing
+    };
+
+    WebDavTestServer *_server;
+    QTcpSocket *_socket;
+    const qint64 _bandwidthLimit;
+    QTimer _tick;
+    QByteArray _in;
+    QByteArray _out;
+    State _state = ReadingHeader;
+
+    QByteArray _verb;
+    QNetworkRequest _request;
+    qint64 _contentLength = 0;
+    bool _closeAfterResponse = false;
+};
+
+WebDavTestServer::WebDavTestServer(const FileInfo &remoteRoot, QObject *parent)
+    : QTcpServer(parent)
+    , _backend(new FakeQNAM(remoteRoot))
+{
+}
+
+bool WebDavTestServer::listen()
+{
+    return QTcpServer::listen(QHostAddress::LocalHost);
+}
+
+QNetworkAccessManager *WebDavTestServer::createAccessManager()
+{
+    Q_ASSERT(isListening());
+    return new LoopbackAccessManager(serverPort());
+}
+
+void WebDavTestServer::incomingConnection(qintptr socketDescriptor)
+{
+    auto socket = new QTcpSocket;
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qWarning() << "Could not accept connection" << socket->errorString();
+        delete socket;
+        return;
+    }
+    new WebDavTestConnection(this, socket);
+}
@@ -0,0 +1,75 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+#pragma once
+
+#include "syncenginetestutils.h"
+
+#include <QTcpServer>
+
+#include <chrono>
+#include <memory>
+
+/**
+ * A WebDAV server on the loopback interface
+ *
+ * Unlike FakeQNAM the client talks to this server through the real Qt network
+ * stack, so http parsing, the connection handling and the bandwidth manager are
+ * part of what gets measured.
+ *
+ * The requests are answered by a FakeQNAM, the server supports everything
+ * the fake replies support: PROPFIND, GET, PUT, MKCOL, MOVE, DELETE and the
+ * chunking NG upload endpoint. TLS and TUS are not supported.
+ */
+class WebDavTestServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit WebDavTestServer(const FileInfo &remoteRoot, QObject *parent = nullptr);
+
+    /// Listen on a random port of the loopback interface
+    bool listen();
+
+    /**
+     * A network access manager sending all requests to this server
+     *
+     * Use it with FakeCredentials, the requests keep their path so the account
+     * url and the dav paths of FakeFolder still apply.
+     */
+    QNetworkAccessManager *createAccessManager();
+
+    FileInfo &remoteModifier() { return _backend->currentRemoteState(); }
+    FileInfo &uploadState() { return _backend->uploadState(); }
+
+    /// Paths that fail with the given http error code, see FakeQNAM::errorPaths()
+    QHash<QString, int> &errorPaths() { return _backend->errorPaths(); }
+    void setOverride(const FakeQNAM::Override &override) { _backend->setOverride(override); }
+
+    /// Delay before a request is answered
+    void setLatency(std::chrono::milliseconds latency) { _latency = latency; }
+    std::chrono::milliseconds latency() const { return _latency; }
+
+    /// Bytes per second and connection in each direction, 0 means unlimited. Applies to new connections.
+    void setBandwidthLimit(qint64 bytesPerSecond) { _bandwidthLimit = bytesPerSecond; }
+    qint64 bandwidthLimit() const { return _bandwidthLimit; }
+
+    qint64 bytesReceived() const { return _bytesReceived; }
+    qint64 bytesSent() const { return _bytesSent; }
+    int requestCount() const { return _requestCount; }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    friend class WebDavTestConnection;
+
+    std::unique_ptr<FakeQNAM> _backend;
+    std::chrono::milliseconds _latency { 0 };
+    qint64 _bandwidthLimit = 0;
+    qint64 _bytesReceived = 0;
+    qint64 _bytesSent = 0;
+    int _requestCount = 0;
+};
@@ -0,0 +1,111 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "testutils/webdavtestserver.h"
+
+using namespace OCC;
+
+namespace {
+QUrl davUrl(const QString &path)
+{
+    return QUrl(sRootUrl2.toString() + path);
+}
+
+// the reply is owned by the access manager
+bool waitForFinished(QNetworkReply *reply)
+{
+    QSignalSpy spy(reply, &QNetworkReply::finished);
+    return reply->isFinished() || spy.wait();
+}
+
+int statusCode(QNetworkReply *reply)
+{
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+}
+}
+
+class TestWebDavTestServer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRoundTrips()
+    {
+        WebDavTestServer server { FileInfo::A12_B12_C12_S12() };
+        QVERIFY(server.listen());
+        std::unique_ptr<QNetworkAccessManager> qnam(server.createAccessManager());
+
+        // PROPFIND
+        QNetworkRequest propfind(davUrl(QStringLiteral("A")));
+        propfind.setRawHeader("Depth", "1");
+        auto reply = qnam->sendCustomRequest(propfind, "PROPFIND",
+            QByteArrayLiteral("<?xml version=\"1.0\"?><d:propfind xmlns:d=\"DAV:\"><d:prop><d:getetag/></d:prop></d:propfind>"));
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(statusCode(reply), 207);
+        const auto listing = reply->readAll();
+        QVERIFY(listing.contains("/A/a1"));
+        QVERIFY(listing.contains("/A/a2"));
+        QVERIFY(!listing.contains("/B/b1"));
+
+        // GET
+        const auto a1 = *server.remoteModifier().find(QStringLiteral("A/a1"));
+        reply = qnam->get(QNetworkRequest(davUrl(QStringLiteral("A/a1"))));
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(statusCode(reply), 200);
+        QCOMPARE(reply->readAll(), QByteArray(static_cast<int>(a1.contentSize), a1.contentChar));
+
+        // PUT, and read it back
+        const QByteArray payload(1000, 'N');
+        reply = qnam->put(QNetworkRequest(davUrl(QStringLiteral("A/new"))), payload);
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(statusCode(reply), 200);
+        const auto *created = server.remoteModifier().find(QStringLiteral("A/new"));
+        QVERIFY(created);
+        QCOMPARE(created->contentSize, static_cast<qint64>(payload.size()));
+        QCOMPARE(created->contentChar, 'N');
+        reply = qnam->get(QNetworkRequest(davUrl(QStringLiteral("A/new"))));
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(reply->readAll(), payload);
+
+        // MOVE
+        QNetworkRequest move(davUrl(QStringLiteral("A/new")));
+        move.setRawHeader("Destination", davUrl(QStringLiteral("B/moved")).toEncoded());
+        reply = qnam->sendCustomRequest(move, "MOVE");
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(statusCode(reply), 201);
+        QVERIFY(!server.remoteModifier().find(QStringLiteral("A/new")));
+        const auto *moved = server.remoteModifier().find(QStringLiteral("B/moved"));
+        QVERIFY(moved);
+        QCOMPARE(moved->contentSize, static_cast<qint64>(payload.size()));
+
+        // the moved file is served from its new location
+        reply = qnam->get(QNetworkRequest(davUrl(QStringLiteral("B/moved"))));
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(statusCode(reply), 200);
+        QCOMPARE(reply->readAll(), payload);
+
+        QCOMPARE(server.requestCount(), 6);
+        QVERIFY(server.bytesReceived() > payload.size());
+        QVERIFY(server.bytesSent() > 2 * payload.size() + a1.contentSize);
+    }
+
+    void testErrorPath()
+    {
+        WebDavTestServer server { FileInfo::A12_B12_C12_S12() };
+        QVERIFY(server.listen());
+        std::unique_ptr<QNetworkAccessManager> qnam(server.createAccessManager());
+        server.errorPaths().insert(QStringLiteral("A/a1"), 403);
+
+        auto reply = qnam->get(QNetworkRequest(davUrl(QStringLiteral("A/a1"))));
+        QVERIFY(waitForFinished(reply));
+        QCOMPARE(statusCode(reply), 403);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestWebDavTestServer)
+#include "testwebdavtestserver.moc"